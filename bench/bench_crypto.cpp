@@ -0,0 +1,128 @@
+// Per-batch push cost before the upload: AES-GCM over the serialized batch,
+// RSA wrapping of the session key, and writing the encrypted envelope file.
+// The seal cases run encrypt + envelope + CID the way the reader used to
+// (vectors, nlohmann::json, base64 strings, re-reading the file for the CID)
+// and from a BatchArena, counting C++ heap allocations per batch and the
+// resident set after each case.
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <vector>
+#include "batch_arena.hpp"
+#include "cid.hpp"
+#include "log_utils.hpp"
+#include "bench_harness.hpp"
+
+std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(size_t n) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+// Out of line so GCC does not pair the inlined free() with operator new.
+[[gnu::noinline]] void release(void* p) noexcept { std::free(p); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+
+double rss_mb() {
+    long pages = 0, resident = 0;
+    if (FILE* f = fopen("/proc/self/statm", "r")) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1 << 20);
+}
+
+// The reader's seal path before the arena.
+cid::Cid legacy_seal(const std::string& payload, const std::vector<uint8_t>& key,
+                     const std::vector<uint8_t>& wrapped, const std::string& path) {
+    std::vector<uint8_t> iv, tag;
+    std::vector<uint8_t> ciphertext = aes_gcm_encrypt(payload, key, iv, tag);
+    json j;
+    j["d"] = base64_encode(ciphertext);
+    j["k"] = base64_encode(wrapped);
+    j["n"] = base64_encode(iv);
+    j["t"] = base64_encode(tag);
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << j.dump(0);
+    }
+    return cid::file_dag(cid::read_file_bytes(path), 0);
+}
+
+cid::Cid arena_seal(BatchArena& arena, const std::string& payload, const std::vector<uint8_t>& key,
+                    const std::vector<uint8_t>& wrapped, const std::string& path) {
+    cid::Cid root;
+    {
+        uint8_t iv[AES_GCM_IV_SIZE], tag[AES_GCM_TAG_SIZE];
+        std::pmr::vector<uint8_t> ciphertext(payload.size(), arena.resource());
+        aes_gcm_encrypt_into(payload, key.data(), iv, tag, ciphertext.data());
+        std::pmr::string envelope(arena.resource());
+        format_encrypted_envelope(envelope, ciphertext.data(), ciphertext.size(), iv, sizeof(iv), tag, sizeof(tag),
+                                  wrapped.data(), wrapped.size());
+        write_file_bytes(path, envelope);
+        root = cid::file_root(envelope, 0, arena.resource());
+    }
+    arena.reset();
+    return root;
+}
+
+int main(int argc, char** argv) {
+    bench::Suite suite("crypto", argc, argv);
+    Config::initialize_config();
+
+    const std::string pubkey = Config::encryption.public_key_path;
+    const std::string envelope = "/tmp/rt-sysagent-bench-envelope.json.enc";
+    std::vector<uint8_t> key = generate_random_bytes(32);
+    std::vector<uint8_t> iv, tag;
+
+    // Roughly one LOG_THRESHOLD batch, then a larger one.
+    for (size_t size : {16u * 1024, 256u * 1024}) {
+        std::string payload(size, 'x');
+        auto* r = suite.run("aes_gcm_encrypt/" + std::to_string(size / 1024) + "KiB", 200, [&](size_t) {
+            bench::do_not_optimize(aes_gcm_encrypt(payload, key, iv, tag).size());
+        });
+        if (r) suite.counter(r, "MB_per_sec", size / r->percentile(50) * 1e3);
+    }
+
+    FILE* f = fopen(pubkey.c_str(), "rb");
+    if (f) {
+        fclose(f);
+        suite.run("rsa_encrypt_key", 200, [&](size_t) { bench::do_not_optimize(rsa_encrypt_key(key, pubkey).size()); });
+    } else {
+        fprintf(stderr, "skipping rsa_encrypt_key: %s not found\n", pubkey.c_str());
+    }
+
+    std::vector<uint8_t> ciphertext = aes_gcm_encrypt(std::string(16 * 1024, 'x'), key, iv, tag);
+    std::vector<uint8_t> wrapped(256, 0x5a);
+    suite.run("write_minimal_encrypted_json/16KiB", 500, [&](size_t) {
+        write_minimal_encrypted_json(envelope, ciphertext, iv, tag, wrapped);
+    });
+
+    BatchArena arena;
+    for (size_t size : {16u * 1024, 256u * 1024}) {
+        std::string payload(size, 'x');
+        const std::string kib = std::to_string(size / 1024) + "KiB";
+        for (bool use_arena : {false, true}) {
+            uint64_t allocs = g_allocations.load();
+            size_t batches = 0;
+            auto* r = suite.run(std::string(use_arena ? "seal/arena/" : "seal/legacy/") + kib, 200, [&](size_t) {
+                ++batches;
+                auto root = use_arena ? arena_seal(arena, payload, key, wrapped, envelope)
+                                      : legacy_seal(payload, key, wrapped, envelope);
+                bench::do_not_optimize(root.digest[0]);
+            });
+            if (r) {
+                suite.counter(r, "allocs_per_batch", static_cast<double>(g_allocations.load() - allocs) / batches);
+                suite.counter(r, "rss_MB", rss_mb());
+            }
+        }
+    }
+    std::remove(envelope.c_str());
+
+    return suite.finish();
+}
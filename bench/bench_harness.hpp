@@ -0,0 +1,181 @@
+#pragma once
+
+// Minimal benchmark harness shared by everything under bench/.
+//
+// Each case is warmed up, then timed for a number of repetitions; the report
+// gives per-operation percentiles across repetitions. Pass --json (stdout) or
+// --json=<path> for machine-readable output, --reps=N / --warmup=N to change
+// the repetition counts and --filter=<substr> to run a subset.
+//
+//     bench::Suite suite("timestamp", argc, argv);
+//     suite.run("cached", 100'000, [&](size_t i) { ... });
+//     return suite.finish();
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "json_writer.hpp"
+#include "timestamp.hpp"
+
+namespace bench {
+
+// Keeps the compiler from discarding a computed value.
+template<typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+    std::string name;
+    size_t ops_per_rep = 0;
+    std::vector<double> ns_per_op;   // one sample per repetition, sorted
+    std::vector<std::pair<std::string, double>> counters;
+
+    double percentile(double p) const {
+        if (ns_per_op.empty()) return 0;
+        size_t idx = static_cast<size_t>(p / 100.0 * (ns_per_op.size() - 1) + 0.5);
+        return ns_per_op[std::min(idx, ns_per_op.size() - 1)];
+    }
+    double mean() const {
+        double sum = 0;
+        for (double v : ns_per_op) sum += v;
+        return ns_per_op.empty() ? 0 : sum / ns_per_op.size();
+    }
+};
+
+class Suite {
+public:
+    Suite(const char* name, int argc, char** argv, int reps = 20, int warmup = 2)
+        : name_(name), reps_(reps), warmup_(warmup) {
+        for (int i = 1; i < argc; ++i) {
+            const char* a = argv[i];
+            if (strcmp(a, "--json") == 0) json_ = true;
+            else if (strncmp(a, "--json=", 7) == 0) { json_ = true; json_path_ = a + 7; }
+            else if (strncmp(a, "--reps=", 7) == 0) reps_ = std::max(1, atoi(a + 7));
+            else if (strncmp(a, "--warmup=", 9) == 0) warmup_ = std::max(0, atoi(a + 9));
+            else if (strncmp(a, "--filter=", 9) == 0) filter_ = a + 9;
+            else if (strcmp(a, "--quick") == 0) { reps_ = 3; warmup_ = 1; }
+        }
+        if (!json_) {
+            printf("== %s ==\n", name_.c_str());
+            printf("%-34s %12s %12s %12s %12s %14s\n", "case", "p50 ns/op", "p90", "p99", "max", "ops/s");
+        }
+    }
+
+    int reps() const { return reps_; }
+
+    // Times `ops` calls of fn(i) per repetition.
+    template<typename Fn>
+    Result* run(const std::string& name, size_t ops, Fn&& fn) {
+        return run_batch(name, [&] {
+            for (size_t i = 0; i < ops; ++i) fn(i);
+            return ops;
+        });
+    }
+
+    // Times one call of fn() per repetition; fn returns the number of
+    // operations it performed (used for multi-threaded or self-timed cases).
+    template<typename Fn>
+    Result* run_batch(const std::string& name, Fn&& fn) {
+        if (!filter_.empty() && name.find(filter_) == std::string::npos) return nullptr;
+        for (int i = 0; i < warmup_; ++i) do_not_optimize(fn());
+
+        Result r;
+        r.name = name;
+        for (int i = 0; i < reps_; ++i) {
+            uint64_t start = monotonic_ns();
+            size_t ops = fn();
+            uint64_t elapsed = monotonic_ns() - start;
+            r.ops_per_rep = ops;
+            r.ns_per_op.push_back(ops ? static_cast<double>(elapsed) / ops : 0);
+        }
+        std::sort(r.ns_per_op.begin(), r.ns_per_op.end());
+        results_.push_back(std::move(r));
+        Result* out = &results_.back();
+        if (!json_) print(*out);
+        return out;
+    }
+
+    // Attaches an extra named value (e.g. MB/s, drop count) to a result.
+    void counter(Result* r, const std::string& key, double value) {
+        if (!r) return;
+        r->counters.emplace_back(key, value);
+        if (!json_) printf("%-34s %s = %.2f\n", "", key.c_str(), value);
+    }
+
+    int finish() {
+        if (!json_) return 0;
+        std::string out;
+        JsonWriter w(out);
+        w.begin_object();
+        w.field("suite", name_);
+        char host[256] = {};
+        gethostname(host, sizeof(host) - 1);
+        w.field("host", host);
+        std::string ts;
+        append_timestamp(ts, realtime_ns());
+        w.field("timestamp", ts);
+        w.field("reps", static_cast<uint64_t>(reps_));
+        w.key("results");
+        w.begin_array();
+        for (const auto& r : results_) {
+            w.begin_object();
+            w.field("name", r.name);
+            w.field("ops_per_rep", static_cast<uint64_t>(r.ops_per_rep));
+            w.key("ns_per_op");
+            w.begin_object();
+            write_number(w, "min", r.percentile(0));
+            write_number(w, "p50", r.percentile(50));
+            write_number(w, "p90", r.percentile(90));
+            write_number(w, "p99", r.percentile(99));
+            write_number(w, "max", r.percentile(100));
+            write_number(w, "mean", r.mean());
+            w.end_object();
+            write_number(w, "ops_per_sec", r.percentile(50) > 0 ? 1e9 / r.percentile(50) : 0);
+            for (const auto& [k, v] : r.counters) write_number(w, k, v);
+            w.end_object();
+        }
+        w.end_array();
+        w.end_object();
+        out += '\n';
+
+        FILE* f = json_path_.empty() ? stdout : fopen(json_path_.c_str(), "w");
+        if (!f) {
+            perror(json_path_.c_str());
+            return 1;
+        }
+        fwrite(out.data(), 1, out.size(), f);
+        if (f != stdout) fclose(f);
+        return 0;
+    }
+
+private:
+    static void write_number(JsonWriter& w, const std::string& key, double v) {
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%.3f", v);
+        w.key(key);
+        w.raw(std::string_view(buf, len));
+    }
+
+    static void print(const Result& r) {
+        double p50 = r.percentile(50);
+        printf("%-34s %12.1f %12.1f %12.1f %12.1f %14.0f\n", r.name.c_str(), p50, r.percentile(90),
+               r.percentile(99), r.percentile(100), p50 > 0 ? 1e9 / p50 : 0);
+    }
+
+    std::string name_;
+    int reps_;
+    int warmup_;
+    bool json_ = false;
+    std::string json_path_;
+    std::string filter_;
+    std::deque<Result> results_;   // stable addresses for counter()
+};
+
+} // namespace bench
@@ -0,0 +1,118 @@
+// Capture-to-enqueue jitter of a monitor thread under CPU contention.
+//
+// A capture thread wakes on an absolute 1 ms deadline, stamps an event and
+// enqueues it the way a monitor does, while a consumer drains the queue. Each
+// case reports how late the thread woke (scheduling jitter) and how long
+// stamp-to-enqueue took: idle, with two busy-looping threads per CPU, and
+// with those hogs plus a capture profile (pinned to the last CPU, SCHED_FIFO
+// 50) applied through thread_profile. Without CAP_SYS_NICE the profile cannot
+// take effect; the case then reports rt_applied = 0.
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include "event.hpp"
+#include "thread_profile.hpp"
+#include "bench_harness.hpp"
+
+constexpr uint8_t STOP = 0xff;
+constexpr uint64_t PERIOD_NS = 1'000'000;
+constexpr size_t TICKS = 200;
+
+struct Jitter {
+    std::vector<uint64_t> wake_ns;      // deadline -> stamped
+    std::vector<uint64_t> enqueue_ns;   // stamped -> enqueued
+    bool applied = true;
+};
+
+// Busy loops at default priority on every CPU until destroyed.
+class CpuHog {
+public:
+    explicit CpuHog(unsigned threads) {
+        for (unsigned i = 0; i < threads; ++i)
+            threads_.emplace_back([this] {
+                uint64_t x = 0;
+                while (running_.load(std::memory_order_relaxed)) bench::do_not_optimize(++x);
+            });
+    }
+    ~CpuHog() {
+        running_ = false;
+        for (auto& t : threads_) t.join();
+    }
+
+private:
+    std::atomic<bool> running_{true};
+    std::vector<std::thread> threads_;
+};
+
+size_t run_capture(QueueType& queue, const Config::ThreadProfile* profile, Jitter& out) {
+    std::thread consumer([&] {
+        RawEvent ev;
+        while (!queue.dequeue(ev) || ev.type != STOP) {}
+    });
+    std::thread capture([&] {
+        if (profile) out.applied = thread_profile::apply("capture", *profile) && out.applied;
+        RawEvent ev{};
+        ev.type = SYSLOG_LINE;
+        timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+        for (size_t i = 0; i < TICKS; ++i) {
+            next.tv_nsec += PERIOD_NS;
+            if (next.tv_nsec >= 1'000'000'000) {
+                next.tv_nsec -= 1'000'000'000;
+                ++next.tv_sec;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+            stamp_capture(ev);
+            ev.event_id = i;
+            while (!queue.try_enqueue(ev, Config::AdmissionConfig::TRY_ENQUEUE_ATTEMPTS)) std::this_thread::yield();
+            uint64_t done = monotonic_ns();
+            uint64_t due = static_cast<uint64_t>(next.tv_sec) * 1'000'000'000 + next.tv_nsec;
+            out.wake_ns.push_back(ev.capture_monotonic_ns > due ? ev.capture_monotonic_ns - due : 0);
+            out.enqueue_ns.push_back(done - ev.capture_monotonic_ns);
+        }
+    });
+    capture.join();
+    RawEvent stop{};
+    stop.type = STOP;
+    queue.enqueue(stop);
+    consumer.join();
+    return TICKS;
+}
+
+int main(int argc, char** argv) {
+    bench::Suite suite("capture_jitter", argc, argv, 5, 1);
+    auto queue = std::make_unique<QueueType>();
+    queue->init();
+    const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    Config::ThreadProfile profile;
+    profile.cpus = std::to_string(cpus - 1);
+    profile.policy = "fifo";
+    profile.priority = 50;
+
+    auto run_case = [&](const std::string& name, bool hog, const Config::ThreadProfile* p) {
+        Jitter j;
+        std::unique_ptr<CpuHog> hogs;
+        if (hog) hogs = std::make_unique<CpuHog>(cpus * 2);
+        auto* r = suite.run_batch(name, [&] { return run_capture(*queue, p, j); });
+        hogs.reset();
+        if (!r) return;
+        auto pct = [](std::vector<uint64_t>& v, double p) {
+            std::sort(v.begin(), v.end());
+            return v[std::min(v.size() - 1, static_cast<size_t>(p / 100 * v.size()))] / 1e3;
+        };
+        suite.counter(r, "wake_p50_us", pct(j.wake_ns, 50));
+        suite.counter(r, "wake_p99_us", pct(j.wake_ns, 99));
+        suite.counter(r, "wake_max_us", pct(j.wake_ns, 100));
+        suite.counter(r, "enqueue_p99_us", pct(j.enqueue_ns, 99));
+        if (p) suite.counter(r, "rt_applied", j.applied ? 1 : 0);
+    };
+
+    run_case("idle/default", false, nullptr);
+    run_case("hog/default", true, nullptr);
+    run_case("hog/profile", true, &profile);
+    return suite.finish();
+}
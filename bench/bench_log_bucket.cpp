@@ -0,0 +1,133 @@
+// Worker-side log bucket throughput: the old single vector behind log_mutex
+// versus ShardedLogBucket, at 1..16 workers with a flusher draining every 1 ms.
+// ns/op is wall time per push and includes the flusher wherever it shares a
+// CPU with the workers; worker_cpu_ns_per_push is the workers' own CPU time
+// per push, i.e. the cost of the push path alone.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include "config.hpp"
+#include "log_bucket.hpp"
+#include "bench_harness.hpp"
+
+struct Entry {
+    uint64_t event_id;
+    char text[120];
+};
+
+constexpr int LOG_THRESHOLD = Config::WorkerConfig::LOG_THRESHOLD;
+constexpr auto RUN_TIME = std::chrono::milliseconds(200);
+
+struct MutexBucket {
+    std::mutex mutex;
+    std::vector<Entry> bucket;
+
+    void push(size_t, Entry&& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bucket.push_back(std::move(e));
+    }
+    bool over_threshold() {
+        // push_log_bucket_if_needed() took the lock just to look at the size.
+        std::lock_guard<std::mutex> lock(mutex);
+        return bucket.size() >= LOG_THRESHOLD;
+    }
+    size_t drain() {
+        std::vector<Entry> out;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            out.swap(bucket);
+        }
+        return out.size();
+    }
+};
+
+struct ShardedBucket {
+    ShardedLogBucket<Entry> bucket;
+    std::vector<Entry> out;
+
+    explicit ShardedBucket(size_t workers) : bucket(workers, LOG_THRESHOLD * 2) {}
+
+    void push(size_t shard, Entry&& e) { bucket.push(shard, std::move(e)); }
+    bool over_threshold() { return bucket.pending() >= LOG_THRESHOLD; }
+    size_t drain() {
+        out.clear();
+        return bucket.collect_into(out);
+    }
+};
+
+uint64_t thread_cpu_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ULL + ts.tv_nsec;
+}
+
+// Worker CPU time and pushes, summed over every run of a case.
+struct WorkerCpu {
+    std::atomic<uint64_t> ns{0};
+    std::atomic<uint64_t> pushes{0};
+
+    double per_push() const { return pushes ? static_cast<double>(ns) / pushes : 0; }
+};
+
+template<typename Bucket>
+size_t run(Bucket& bucket, int workers, WorkerCpu& cpu) {
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> total(0);
+    std::atomic<uint64_t> drained(0);
+
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; ++w) {
+        pool.emplace_back([&, w] {
+            uint64_t n = 0;
+            uint64_t cpu_start = thread_cpu_ns();
+            Entry e{};
+            snprintf(e.text, sizeof(e.text), "Oct 18 10:00:00 host sshd[%d]: failed password for invalid user", w);
+            while (running.load(std::memory_order_relaxed)) {
+                e.event_id = n++;
+                bucket.push(w, Entry(e));
+                (void)bucket.over_threshold();
+            }
+            total.fetch_add(n);
+            cpu.ns.fetch_add(thread_cpu_ns() - cpu_start);
+            cpu.pushes.fetch_add(n);
+        });
+    }
+    std::thread flusher([&] {
+        while (running.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            drained.fetch_add(bucket.drain());
+        }
+    });
+
+    std::this_thread::sleep_for(RUN_TIME);
+    running = false;
+    for (auto& t : pool) t.join();
+    flusher.join();
+    return total.load();
+}
+
+int main(int argc, char** argv) {
+    bench::Suite suite("log_bucket", argc, argv, 5, 1);
+    for (int workers : {1, 2, 4, 8, 16}) {
+        WorkerCpu mutex_cpu, sharded_cpu;
+        auto mutex_case = suite.run_batch("mutex/" + std::to_string(workers) + "w", [&] {
+            MutexBucket m;
+            return run(m, workers, mutex_cpu);
+        });
+        suite.counter(mutex_case, "worker_cpu_ns_per_push", mutex_cpu.per_push());
+        auto sharded_case = suite.run_batch("sharded/" + std::to_string(workers) + "w", [&] {
+            ShardedBucket s(workers);
+            return run(s, workers, sharded_cpu);
+        });
+        suite.counter(sharded_case, "worker_cpu_ns_per_push", sharded_cpu.per_push());
+        if (mutex_case && sharded_case) {
+            suite.counter(sharded_case, "speedup_vs_mutex", mutex_case->percentile(50) / sharded_case->percentile(50));
+            suite.counter(sharded_case, "push_speedup_vs_mutex", mutex_cpu.per_push() / sharded_cpu.per_push());
+        }
+    }
+    return suite.finish();
+}
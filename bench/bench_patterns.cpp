@@ -0,0 +1,206 @@
+// Syslog pattern matching: the cjgdev trie the agent used to build on every
+// start against the flat PatternAutomaton, over a syslog corpus. The corpus is
+// synthetic (about 5% of lines contain a configured pattern) unless
+// --corpus=<file> points at a real log. The startup cases compile a 50k
+// pattern IOC-style set both ways and map it from a cache file. The regex
+// cases run sshd/sudo/kernel-style rules through PatternMatcher (literal
+// prefilter, then the regex on candidate lines) and, as the baseline, search
+// every regex on every line. The header cases time parse_syslog_header and
+// matching the default rules against the message field only (the default
+// scope) rather than the whole line.
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "aho_corasick.hpp"
+#include "patterns.hpp"
+#include "pattern_automaton.hpp"
+#include "pattern_matcher.hpp"
+#include "syslog_header.hpp"
+#include "bench_harness.hpp"
+
+std::vector<std::string> synthetic_corpus(const std::vector<std::string>& patterns, size_t lines) {
+    static const char* programs[] = {"sshd", "kernel", "systemd", "cron", "dockerd", "kubelet", "NetworkManager"};
+    static const char* bodies[] = {
+        "Accepted publickey for deploy from 10.0.4.17 port 52144 ssh2",
+        "Started Session 4411 of user root.",
+        "eth0: Link is Up - 1Gbps/Full - flow control rx/tx",
+        "(root) CMD (run-parts /etc/cron.hourly)",
+        "Container 3f9c2a1b health check passed",
+        "Reconciling pod default/web-7d9f8c6b5-x2k4q",
+        "audit: type=1400 apparmor=\"STATUS\" operation=\"profile_replace\"",
+    };
+    std::mt19937 rng(42);
+    std::vector<std::string> out;
+    out.reserve(lines);
+    char prefix[96];
+    for (size_t i = 0; i < lines; ++i) {
+        snprintf(prefix, sizeof(prefix), "Oct 18 10:%02zu:%02zu host-01 %s[%u]: ", (i / 60) % 60, i % 60,
+                 programs[rng() % 7], static_cast<unsigned>(rng() % 30000));
+        std::string line = prefix;
+        if (!patterns.empty() && rng() % 100 < 5) {
+            line += "error: ";
+            line += patterns[rng() % patterns.size()];
+            line += " detected";
+        } else {
+            line += bodies[rng() % 7];
+        }
+        out.push_back(std::move(line));
+    }
+    return out;
+}
+
+// Hex digests and host names, like a threat-intelligence feed.
+std::vector<std::string> ioc_patterns(size_t n) {
+    std::mt19937_64 rng(7);
+    std::vector<std::string> out;
+    out.reserve(n);
+    char buf[64];
+    for (size_t i = 0; i < n; ++i) {
+        if (i % 2) snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)rng(), (unsigned long long)rng());
+        else snprintf(buf, sizeof(buf), "c2-%llx.example-%zu.net", (unsigned long long)(rng() & 0xffffff), i % 97);
+        out.push_back(buf);
+    }
+    return out;
+}
+
+const std::vector<std::string> REGEX_RULES = {
+    R"(re:Failed password for (invalid user )?\S+ from \d+\.\d+\.\d+\.\d+ port \d+)",
+    R"(re:Accepted publickey for (root|admin) from)",
+    R"(re:session opened for user (root|admin))",
+    R"(re:segfault at [0-9a-f]+ ip [0-9a-f]+ sp [0-9a-f]+ error \d+)",
+    R"(re:Out of memory: Kill(ed)? process \d+ \(\S+\))",
+    R"(re:sudo: +\S+ : .*COMMAND=/bin/(ba)?sh)",
+    R"(re:authentication failure;.*rhost=\S+)",
+    R"(re:Connection closed by \d+\.\d+\.\d+\.\d+ port \d+ \[preauth\])",
+    R"(re:maximum authentication attempts exceeded for \S+)",
+    R"(re:apparmor="DENIED" operation="\w+")",
+    R"(re:Started Session \d+ of user root)",
+    R"(re:CMD \(run-parts /etc/cron\.(hourly|daily)\))",
+};
+
+std::vector<PatternRule> parse_rules(const std::vector<std::string>& lines, SyslogField field) {
+    std::vector<PatternRule> rules;
+    for (const auto& line : lines) {
+        rules.push_back(parse_pattern_rule(line));
+        rules.back().field = field;
+    }
+    return rules;
+}
+
+int main(int argc, char** argv) {
+    bench::Suite suite("patterns", argc, argv, 10, 1);
+
+    std::vector<std::string> patterns = Config::patterns.default_patterns;
+    std::vector<std::string> corpus;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--corpus=", 9) == 0) {
+            std::ifstream in(argv[i] + 9);
+            for (std::string line; std::getline(in, line);) corpus.push_back(line);
+        }
+    }
+    if (corpus.empty()) corpus = synthetic_corpus(patterns, 20'000);
+
+    size_t bytes = 0;
+    for (const auto& line : corpus) bytes += line.size() + 1;
+
+    aho_corasick::trie trie;
+    for (const auto& pat : patterns) trie.insert(pat);
+
+    size_t matching_lines = 0;
+    for (const auto& line : corpus) matching_lines += !trie.parse_text(line).empty();
+
+    auto* r = suite.run("trie/parse_text per line", corpus.size(), [&](size_t i) {
+        bench::do_not_optimize(trie.parse_text(corpus[i]).size());
+    });
+    if (r) {
+        suite.counter(r, "MB_per_sec", bytes / (r->percentile(50) * corpus.size()) * 1e3);
+        suite.counter(r, "match_ratio", static_cast<double>(matching_lines) / corpus.size());
+    }
+
+    auto automaton = PatternAutomaton::build(patterns);
+    r = suite.run("automaton/for_each_match per line", corpus.size(), [&](size_t i) {
+        size_t hits = 0;
+        automaton.for_each_match(corpus[i], [&hits](uint32_t) { ++hits; });
+        bench::do_not_optimize(hits);
+    });
+    if (r) suite.counter(r, "MB_per_sec", bytes / (r->percentile(50) * corpus.size()) * 1e3);
+
+    // Baseline the trie should beat: one substring search per pattern.
+    r = suite.run("naive find per line", corpus.size(), [&](size_t i) {
+        for (const auto& pat : patterns) bench::do_not_optimize(corpus[i].find(pat));
+    });
+    if (r) suite.counter(r, "MB_per_sec", bytes / (r->percentile(50) * corpus.size()) * 1e3);
+
+    // Header parsing, and the default rules scoped to the message.
+    r = suite.run("header/parse per line", corpus.size(), [&](size_t i) {
+        bench::do_not_optimize(parse_syslog_header(corpus[i]).message.size());
+    });
+    if (r) suite.counter(r, "MB_per_sec", bytes / (r->percentile(50) * corpus.size()) * 1e3);
+    for (SyslogField field : {FIELD_LINE, FIELD_MESSAGE}) {
+        PatternMatcher scoped(parse_rules(patterns, field), "");
+        r = suite.run(field == FIELD_LINE ? "header/match whole line" : "header/parse + match message", corpus.size(),
+                      [&](size_t i) {
+                          size_t hits = 0;
+                          scoped.for_each_match(corpus[i], [&hits](uint32_t) { ++hits; });
+                          bench::do_not_optimize(hits);
+                      });
+        if (r) suite.counter(r, "scanned_bytes_per_line", static_cast<double>(scoped.stats().bytes_scanned) / scoped.stats().lines);
+    }
+
+    // Regex rules: literal prefilter against every regex on every line.
+    PatternMatcher matcher(parse_rules(REGEX_RULES, FIELD_LINE), "");
+    r = suite.run("regex/prefiltered per line", corpus.size(), [&](size_t i) {
+        size_t hits = 0;
+        matcher.for_each_match(corpus[i], [&hits](uint32_t) { ++hits; });
+        bench::do_not_optimize(hits);
+    });
+    if (r) {
+        suite.counter(r, "MB_per_sec", bytes / (r->percentile(50) * corpus.size()) * 1e3);
+        suite.counter(r, "searches_per_line",
+                      static_cast<double>(matcher.stats().regex_searches) / matcher.stats().lines);
+    }
+    std::vector<regex::Regex> regexes;
+    for (const auto& rule : REGEX_RULES) regexes.emplace_back(std::string_view(rule).substr(REGEX_PATTERN_PREFIX.size()));
+    size_t regex_lines = 0;
+    for (const auto& line : corpus)
+        for (const auto& re : regexes)
+            if (re.search(line)) {
+                ++regex_lines;
+                break;
+            }
+    r = suite.run("regex/every regex per line", corpus.size(), [&](size_t i) {
+        size_t hits = 0;
+        for (const auto& re : regexes) hits += re.search(corpus[i]);
+        bench::do_not_optimize(hits);
+    });
+    if (r) {
+        suite.counter(r, "MB_per_sec", bytes / (r->percentile(50) * corpus.size()) * 1e3);
+        suite.counter(r, "match_ratio", static_cast<double>(regex_lines) / corpus.size());
+    }
+
+    // Agent startup with a large rule set.
+    const std::vector<std::string> iocs = ioc_patterns(50'000);
+    suite.run_batch("startup/trie insert 50k", [&] {
+        aho_corasick::trie t;
+        for (const auto& p : iocs) t.insert(p);
+        t.parse_text("x");   // failure links are built on first use
+        return size_t{1};
+    });
+    r = suite.run_batch("startup/automaton build 50k", [&] {
+        bench::do_not_optimize(PatternAutomaton::build(iocs).state_count());
+        return size_t{1};
+    });
+    std::string cache = "/tmp/bench_patterns." + std::to_string(getpid()) + ".acm";
+    PatternAutomaton::build(iocs).save(cache);
+    if (r) suite.counter(r, "image_MB", PatternAutomaton::build(iocs).image_size() / 1e6);
+    const PatternAutomaton::Key key = PatternAutomaton::key_for(iocs);
+    suite.run_batch("startup/automaton map 50k", [&] {
+        std::string why;
+        bench::do_not_optimize(PatternAutomaton::open(cache, key, static_cast<uint32_t>(iocs.size()), why)->state_count());
+        return size_t{1};
+    });
+    unlink(cache.c_str());
+
+    return suite.finish();
+}
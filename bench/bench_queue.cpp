@@ -0,0 +1,128 @@
+// MmapQueue throughput: single-threaded enqueue/dequeue, and producers against
+// consumers the way the agent monitors and reader workers use it (enqueue
+// retried with yield, dequeue misses answered with a sleep). The multi-threaded
+// cases also report enqueue-to-dequeue latency.
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "event.hpp"
+#include "bench_harness.hpp"
+
+constexpr uint8_t FILLER = 0xff;
+constexpr auto RUN_TIME = std::chrono::milliseconds(200);
+
+struct MtResult {
+    size_t consumed = 0;
+    std::vector<uint64_t> latencies_ns;
+};
+
+MtResult run_mt(QueueType& queue, int producers, int consumers) {
+    std::atomic<bool> producers_running(true);
+    std::atomic<bool> consumers_running(true);
+    std::atomic<int> live_consumers(consumers);
+    std::vector<std::vector<uint64_t>> latencies(consumers);
+    std::vector<size_t> consumed(consumers, 0);
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            auto& lat = latencies[c];
+            lat.reserve(1 << 20);
+            RawEvent ev;
+            while (true) {
+                if (queue.dequeue(ev)) {
+                    if (ev.type != FILLER) {
+                        ++consumed[c];
+                        if (lat.size() < lat.capacity()) lat.push_back(monotonic_ns() - ev.capture_monotonic_ns);
+                    }
+                    if (!consumers_running.load(std::memory_order_relaxed)) break;
+                } else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(Config::WorkerConfig::WORKER_SLEEP_MS));
+                }
+            }
+            live_consumers.fetch_sub(1);
+        });
+    }
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            RawEvent ev{};
+            ev.type = SYSLOG_LINE;
+            ev.syslog.line_len = copy_field(ev.syslog.line, TEXT_SIZE, "Oct 18 10:00:00 host sshd[1]: failed password");
+            uint64_t id = static_cast<uint64_t>(p) << 48;
+            while (producers_running.load(std::memory_order_relaxed)) {
+                ev.event_id = id++;
+                stamp_capture(ev);
+                while (!queue.enqueue(ev)) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(RUN_TIME);
+    producers_running = false;
+    for (int p = 0; p < producers; ++p) threads[consumers + p].join();
+
+    // An idle dequeue keeps retrying for up to MAX_RETRY_ATTEMPTS sleeps; keep
+    // feeding filler events until every consumer has noticed the stop.
+    consumers_running = false;
+    RawEvent filler{};
+    filler.type = FILLER;
+    while (live_consumers.load() > 0) {
+        queue.enqueue(filler);
+        std::this_thread::yield();
+    }
+    for (int c = 0; c < consumers; ++c) threads[c].join();
+
+    MtResult r;
+    for (int c = 0; c < consumers; ++c) {
+        r.consumed += consumed[c];
+        r.latencies_ns.insert(r.latencies_ns.end(), latencies[c].begin(), latencies[c].end());
+    }
+    return r;
+}
+
+int main(int argc, char** argv) {
+    bench::Suite suite("mmap_queue", argc, argv, 10, 1);
+    auto queue = std::make_unique<QueueType>();
+    queue->init();
+
+    RawEvent ev{};
+    ev.type = SYSLOG_LINE;
+    RawEvent out;
+
+    suite.run("st/enqueue+dequeue", 1'000'000, [&](size_t i) {
+        ev.event_id = i;
+        queue->enqueue(ev);
+        queue->dequeue(out);
+        bench::do_not_optimize(out.event_id);
+    });
+
+    constexpr size_t BURST = QUEUE_SIZE / 2;
+    suite.run_batch("st/burst " + std::to_string(BURST), [&] {
+        for (size_t i = 0; i < BURST; ++i) {
+            ev.event_id = i;
+            queue->enqueue(ev);
+        }
+        for (size_t i = 0; i < BURST; ++i) queue->dequeue(out);
+        return BURST * 2;
+    });
+
+    // 3 producers / 4 consumers is the agent + reader default.
+    for (auto [producers, consumers] : {std::pair{1, 1}, {2, 2}, {3, 4}, {4, 4}}) {
+        queue->init();
+        MtResult last;
+        auto* r = suite.run_batch("mt/" + std::to_string(producers) + "p" + std::to_string(consumers) + "c", [&] {
+            last = run_mt(*queue, producers, consumers);
+            queue->init();
+            return last.consumed;
+        });
+        if (r && !last.latencies_ns.empty()) {
+            auto& lat = last.latencies_ns;
+            std::sort(lat.begin(), lat.end());
+            suite.counter(r, "latency_p50_us", lat[lat.size() / 2] / 1e3);
+            suite.counter(r, "latency_p99_us", lat[lat.size() * 99 / 100] / 1e3);
+        }
+    }
+    return suite.finish();
+}
@@ -0,0 +1,89 @@
+// Batch serialization: one RawEvent to JSON, a whole LOG_THRESHOLD batch in both
+// batch formats, and the legacy nlohmann-based format_logs_json for comparison.
+#include <string>
+#include <vector>
+#include "event_format.hpp"
+#include "log_utils.hpp"
+#include "bench_harness.hpp"
+
+std::vector<LogRecord> sample_records(size_t n) {
+    std::vector<LogRecord> records;
+    for (size_t i = 0; i < n; ++i) {
+        LogRecord rec{};
+        RawEvent& ev = rec.ev;
+        ev.event_id = i;
+        stamp_capture(ev);
+        rec.dequeued_monotonic_ns = ev.capture_monotonic_ns + 50'000;
+        switch (i % 3) {
+            case 0:
+                ev.type = SYSLOG_LINE;
+                ev.syslog.offset = i * 120;
+                ev.syslog.pattern_count = 1;
+                ev.syslog.pattern_ids[0] = 0;
+                ev.syslog.line_len = copy_field(ev.syslog.line, TEXT_SIZE,
+                    "Oct 18 10:00:00 host-01 kernel: [ 4411.20] segfault at 0 ip 00007f \"quoted\" \\ path");
+                break;
+            case 1:
+                ev.type = USB_EVENT;
+                ev.usb.action = USB_ACTION_ADD;
+                ev.usb.has_ids = 1;
+                ev.usb.vendor = 0x046d;
+                ev.usb.product = 0xc52b;
+                copy_field(ev.usb.devnode, USB_DEVNODE_SIZE, "/dev/bus/usb/001/007");
+                break;
+            default:
+                ev.type = FILE_DELETE;
+                ev.file.mask = IN_DELETE;
+                ev.file.wd = 1;
+                ev.file.path_len = copy_field(ev.file.path, TEXT_SIZE, "/etc/ssh/sshd_config");
+                ev.file.name_offset = 9;
+                break;
+        }
+        records.push_back(rec);
+    }
+    return records;
+}
+
+int main(int argc, char** argv) {
+    bench::Suite suite("serialize", argc, argv);
+    const size_t batch = Config::WorkerConfig::LOG_THRESHOLD;
+    auto records = sample_records(batch);
+    std::vector<std::string> pattern_names = {"segfault"};
+    const std::string prev_cid = "QmYwAPJzv5CZsnA625s3Xf2nemtYgPpHdWEz79ojWnPbdG";
+
+    std::string out, event_buf, scratch;
+    suite.run("write_log_record", 100'000, [&](size_t i) {
+        out.clear();
+        JsonWriter w(out);
+        write_log_record(w, records[i % batch], pattern_names, scratch);
+        bench::do_not_optimize(out.size());
+    });
+
+    auto* r = suite.run("write_log_batch json/" + std::to_string(batch), 2'000, [&](size_t) {
+        write_log_batch(out, records, prev_cid, BatchFormat::JSON, pattern_names, event_buf, scratch);
+        bench::do_not_optimize(out.size());
+    });
+    suite.counter(r, "batch_bytes", out.size());
+
+    r = suite.run("write_log_batch ndjson/" + std::to_string(batch), 2'000, [&](size_t) {
+        write_log_batch(out, records, prev_cid, BatchFormat::NDJSON, pattern_names, event_buf, scratch);
+        bench::do_not_optimize(out.size());
+    });
+    suite.counter(r, "batch_bytes", out.size());
+
+    // Pre-rendered entries, as the reader built them before the streaming writer.
+    std::vector<std::string> logs;
+    for (const auto& rec : records) {
+        std::string entry;
+        JsonWriter w(entry);
+        write_log_record(w, rec, pattern_names, scratch);
+        logs.push_back(entry);
+    }
+    r = suite.run("format_logs_json/" + std::to_string(batch), 2'000, [&](size_t) {
+        out = format_logs_json(logs, prev_cid);
+        bench::do_not_optimize(out.size());
+    });
+    suite.counter(r, "batch_bytes", out.size());
+
+    return suite.finish();
+}
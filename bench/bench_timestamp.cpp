@@ -0,0 +1,64 @@
+// Per-event timestamp formatting: the old stringstream/put_time path, a
+// snprintf rendering of the full string, and the cached TimestampFormatter.
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include "timestamp.hpp"
+#include "bench_harness.hpp"
+
+constexpr size_t OPS = 200'000;
+
+std::string stringstream_timestamp(uint64_t ns) {
+    using namespace std::chrono;
+    system_clock::time_point tp{duration_cast<system_clock::duration>(nanoseconds(ns))};
+    auto ms = duration_cast<milliseconds>(tp.time_since_epoch()) % 1000;
+    std::time_t t = system_clock::to_time_t(tp);
+    std::tm tm_utc;
+    gmtime_r(&t, &tm_utc);
+    std::stringstream ss;
+    ss << std::put_time(&tm_utc, "%Y-%m-%dT%H:%M:%S");
+    ss << '.' << std::setw(3) << std::setfill('0') << ms.count() << "Z";
+    return ss.str();
+}
+
+void snprintf_timestamp(std::string& out, uint64_t ns) {
+    std::time_t t = static_cast<std::time_t>(ns / 1'000'000'000ULL);
+    std::tm tm_utc;
+    gmtime_r(&t, &tm_utc);
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                       tm_utc.tm_year + 1900, tm_utc.tm_mon + 1, tm_utc.tm_mday, tm_utc.tm_hour,
+                       tm_utc.tm_min, tm_utc.tm_sec, static_cast<int>(ns / 1'000'000ULL % 1000));
+    out.append(buf, len);
+}
+
+int main(int argc, char** argv) {
+    bench::Suite suite("timestamp", argc, argv);
+    std::string out;
+    // Simulated event stream: 10k events/s, so the second changes every 10k calls.
+    const uint64_t base = realtime_ns();
+    auto event_ns = [base](size_t i) { return base + i * 100'000; };
+
+    suite.run("stringstream", OPS, [&](size_t i) { bench::do_not_optimize(stringstream_timestamp(event_ns(i)).size()); });
+    suite.run("snprintf", OPS, [&](size_t i) {
+        out.clear();
+        snprintf_timestamp(out, event_ns(i));
+        bench::do_not_optimize(out.size());
+    });
+    suite.run("cached", OPS, [&](size_t i) {
+        out.clear();
+        append_timestamp(out, event_ns(i));
+        bench::do_not_optimize(out.size());
+    });
+
+    std::string a = stringstream_timestamp(1'700'000'000'123'456'789ULL);
+    std::string b;
+    append_timestamp(b, 1'700'000'000'123'456'789ULL);
+    if (a != b) {
+        fprintf(stderr, "mismatch: %s vs %s\n", a.c_str(), b.c_str());
+        return 1;
+    }
+    return suite.finish();
+}
@@ -17,18 +17,30 @@ namespace Config {
     FileMonitorConfig file_monitor;
     SystemMonitorConfig system_monitor;
     IPFSConfig ipfs;
+    ChainsConfig chains;
     EncryptionConfig encryption;
     PatternConfig patterns;
     LoggingConfig logging;
     SharedMemoryConfig shared_memory;
+    AdmissionConfig admission;
+    ThreadsConfig threads;
+    BatchConfig batch;
+    MetricsConfig metrics;
+    TraceConfig trace;
 
     void initialize_config() {
         // Update paths to be absolute
         encryption.private_key_path = get_absolute_path(encryption.private_key_path);
         encryption.public_key_path = get_absolute_path(encryption.public_key_path);
         patterns.pattern_file_path = get_absolute_path(patterns.pattern_file_path);
+        if (!patterns.automaton_cache_path.empty())
+            patterns.automaton_cache_path = get_absolute_path(patterns.automaton_cache_path);
         logging.log_file_path = get_absolute_path(logging.log_file_path);
         shared_memory.queue_file_path = get_absolute_path(shared_memory.queue_file_path);
+        if (!shared_memory.queue_dir.empty()) shared_memory.queue_dir = get_absolute_path(shared_memory.queue_dir);
+        system_monitor.usb_fifo_path = get_absolute_path(system_monitor.usb_fifo_path);
+        if (!metrics.socket_path.empty()) metrics.socket_path = get_absolute_path(metrics.socket_path);
+        trace.dir = get_absolute_path(trace.dir);
         
         // Create necessary directories
         ensure_directory_exists(dirs.get_keys_path());
@@ -128,23 +140,55 @@ namespace Config {
             {"num_workers", WorkerConfig::DEFAULT_NUM_WORKERS},
             {"log_threshold", WorkerConfig::LOG_THRESHOLD},
             {"time_threshold_seconds", WorkerConfig::TIME_THRESHOLD_SECONDS},
+            {"critical_flush_ms", WorkerConfig::CRITICAL_FLUSH_MS},
+            {"high_flush_ms", WorkerConfig::HIGH_FLUSH_MS},
+            {"low_flush_ms", WorkerConfig::LOW_FLUSH_MS},
             {"worker_sleep_ms", WorkerConfig::WORKER_SLEEP_MS},
             {"flusher_sleep_ms", WorkerConfig::FLUSHER_SLEEP_MS},
             {"monitor_poll_ms", WorkerConfig::MONITOR_POLL_MS}
         };
         
+        // Batch sizing
+        config["batch"] = {
+            {"adaptive", batch.adaptive},
+            {"min_bytes", batch.min_bytes},
+            {"max_bytes", batch.max_bytes},
+            {"latency_budget_ms", batch.latency_budget_ms}
+        };
+        
+        // Metrics endpoint
+        config["metrics"] = {
+            {"enabled", metrics.enabled},
+            {"socket_path", metrics.socket_path},
+            {"http_port", metrics.http_port}
+        };
+        
+        // Event lifecycle tracing
+        config["trace"] = {
+            {"sample_every", trace.sample_every},
+            {"dir", trace.dir}
+        };
+        
         // File monitoring
         config["file_monitor"] = {
             {"watch_paths", file_monitor.watch_paths},
             {"inotify_buffer_size", FileMonitorConfig::INOTIFY_BUFFER_SIZE},
-            {"inotify_timeout_ms", FileMonitorConfig::INOTIFY_TIMEOUT_MS}
+            {"inotify_timeout_ms", FileMonitorConfig::INOTIFY_TIMEOUT_MS},
+            {"rollup_window_ms", FileMonitorConfig::ROLLUP_WINDOW_MS},
+            {"rollup_burst_threshold", FileMonitorConfig::ROLLUP_BURST_THRESHOLD},
+            {"rollup_sample_names", FileMonitorConfig::ROLLUP_SAMPLE_NAMES}
         };
         
         // System monitoring
         config["system_monitor"] = {
             {"syslog_path", system_monitor.syslog_path},
             {"journald_path", system_monitor.journald_path},
+            {"usb_source", system_monitor.usb_source},
+            {"usb_fifo_path", system_monitor.usb_fifo_path},
+            {"syslog_dedup", system_monitor.syslog_dedup},
             {"syslog_buffer_size", SystemMonitorConfig::SYSLOG_BUFFER_SIZE},
+            {"dedup_window_ms", SystemMonitorConfig::DEDUP_WINDOW_MS},
+            {"dedup_capacity", SystemMonitorConfig::DEDUP_CAPACITY},
             {"usb_poll_timeout_ms", SystemMonitorConfig::USB_POLL_TIMEOUT_MS}
         };
         
@@ -152,11 +196,25 @@ namespace Config {
         config["ipfs"] = {
             {"ipns_key_name", ipfs.ipns_key_name},
             {"daemon_url", ipfs.ipfs_daemon_url},
+            {"batch_format", ipfs.batch_format},
+            {"cid_version", ipfs.cid_version},
+            {"upload_queue_depth", IPFSConfig::UPLOAD_QUEUE_DEPTH},
             {"timeout_seconds", IPFSConfig::IPFS_TIMEOUT_SECONDS},
             {"ipns_ttl_seconds", IPFSConfig::IPNS_TTL_SECONDS},
             {"allow_offline", IPFSConfig::ALLOW_OFFLINE}
         };
         
+        // Per-source chains
+        json groups_json = json::array();
+        for (const auto& g : chains.groups)
+            groups_json.push_back({{"name", g.name}, {"ipns_key", g.ipns_key}, {"sources", g.sources}});
+        config["chains"] = {
+            {"enabled", chains.enabled},
+            {"groups", groups_json},
+            {"manifest_key", chains.manifest_key},
+            {"manifest_interval_s", chains.manifest_interval_s}
+        };
+        
         // Encryption configuration
         config["encryption"] = {
             {"private_key_path", encryption.private_key_path},
@@ -170,12 +228,15 @@ namespace Config {
         // Pattern configuration
         config["patterns"] = {
             {"pattern_file_path", patterns.pattern_file_path},
+            {"automaton_cache_path", patterns.automaton_cache_path},
+            {"default_field", patterns.default_field},
             {"default_patterns", patterns.default_patterns}
         };
         
         // Logging configuration
         config["logging"] = {
             {"log_file_path", logging.log_file_path},
+            {"level", logging.level},
             {"enable_console_logging", LoggingConfig::ENABLE_CONSOLE_LOGGING},
             {"enable_file_logging", LoggingConfig::ENABLE_FILE_LOGGING},
             {"max_log_file_size_mb", LoggingConfig::MAX_LOG_FILE_SIZE_MB},
@@ -185,10 +246,37 @@ namespace Config {
         // Shared memory configuration
         config["shared_memory"] = {
             {"queue_file_path", shared_memory.queue_file_path},
+            {"queue_dir", shared_memory.queue_dir},
+            {"agent_name", shared_memory.agent_name},
             {"file_permissions", SharedMemoryConfig::FILE_PERMISSIONS},
             {"create_if_not_exists", SharedMemoryConfig::CREATE_IF_NOT_EXISTS}
         };
         
+        auto limits_json = [](const SourceLimits& l) {
+            return json{{"rate", l.rate}, {"burst", l.burst}, {"queue_share", l.queue_share}};
+        };
+        config["admission"] = {
+            {"enabled", admission.enabled},
+            {"syslog", limits_json(admission.syslog)},
+            {"usb", limits_json(admission.usb)},
+            {"file", limits_json(admission.file)},
+            {"sample_every", admission.sample_every},
+            {"report_interval_ms", AdmissionConfig::REPORT_INTERVAL_MS}
+        };
+        
+        // Thread placement and scheduling
+        auto profile_json = [](const ThreadProfile& p) {
+            return json{{"cpus", p.cpus}, {"policy", p.policy}, {"priority", p.priority}, {"numa_local", p.numa_local}};
+        };
+        config["threads"] = {
+            {"lock_memory", threads.lock_memory},
+            {"prefault_queue", threads.prefault_queue},
+            {"capture", profile_json(threads.capture)},
+            {"worker", profile_json(threads.worker)},
+            {"flusher", profile_json(threads.flusher)},
+            {"uploader", profile_json(threads.uploader)}
+        };
+        
         // Systemd configuration
         config["systemd"] = {
             {"enable_integration", SystemdConfig::ENABLE_SYSTEMD_INTEGRATION},
@@ -244,12 +332,58 @@ namespace Config {
                 auto& sys_config = config["system_monitor"];
                 if (sys_config.contains("syslog_path")) system_monitor.syslog_path = sys_config["syslog_path"];
                 if (sys_config.contains("journald_path")) system_monitor.journald_path = sys_config["journald_path"];
+                if (sys_config.contains("usb_source")) system_monitor.usb_source = sys_config["usb_source"];
+                if (sys_config.contains("usb_fifo_path")) system_monitor.usb_fifo_path = sys_config["usb_fifo_path"];
+                if (sys_config.contains("syslog_dedup")) system_monitor.syslog_dedup = sys_config["syslog_dedup"];
             }
             
             if (config.contains("ipfs")) {
                 auto& ipfs_config = config["ipfs"];
                 if (ipfs_config.contains("ipns_key_name")) ipfs.ipns_key_name = ipfs_config["ipns_key_name"];
                 if (ipfs_config.contains("daemon_url")) ipfs.ipfs_daemon_url = ipfs_config["daemon_url"];
+                if (ipfs_config.contains("batch_format")) ipfs.batch_format = ipfs_config["batch_format"];
+                if (ipfs_config.contains("cid_version")) ipfs.cid_version = ipfs_config["cid_version"];
+            }
+            
+            if (config.contains("chains")) {
+                auto& chains_config = config["chains"];
+                if (chains_config.contains("enabled")) chains.enabled = chains_config["enabled"];
+                if (chains_config.contains("groups")) {
+                    chains.groups.clear();
+                    for (const auto& g : chains_config["groups"]) {
+                        ChainGroup group;
+                        group.name = g.value("name", "");
+                        group.ipns_key = g.value("ipns_key", "");
+                        if (g.contains("sources")) group.sources = g["sources"].get<std::vector<std::string>>();
+                        chains.groups.push_back(std::move(group));
+                    }
+                }
+                if (chains_config.contains("manifest_key")) chains.manifest_key = chains_config["manifest_key"];
+                if (chains_config.contains("manifest_interval_s")) chains.manifest_interval_s = chains_config["manifest_interval_s"];
+            }
+            
+            if (config.contains("batch")) {
+                auto& batch_config = config["batch"];
+                if (batch_config.contains("adaptive")) batch.adaptive = batch_config["adaptive"];
+                if (batch_config.contains("min_bytes")) batch.min_bytes = batch_config["min_bytes"];
+                if (batch_config.contains("max_bytes")) batch.max_bytes = batch_config["max_bytes"];
+                if (batch_config.contains("latency_budget_ms")) batch.latency_budget_ms = batch_config["latency_budget_ms"];
+            }
+            
+            if (config.contains("metrics")) {
+                auto& metrics_config = config["metrics"];
+                if (metrics_config.contains("enabled")) metrics.enabled = metrics_config["enabled"];
+                if (metrics_config.contains("socket_path")) {
+                    metrics.socket_path = metrics_config["socket_path"];
+                    if (!metrics.socket_path.empty()) metrics.socket_path = get_absolute_path(metrics.socket_path);
+                }
+                if (metrics_config.contains("http_port")) metrics.http_port = metrics_config["http_port"];
+            }
+            
+            if (config.contains("trace")) {
+                auto& trace_config = config["trace"];
+                if (trace_config.contains("sample_every")) trace.sample_every = trace_config["sample_every"];
+                if (trace_config.contains("dir")) trace.dir = get_absolute_path(trace_config["dir"].get<std::string>());
             }
             
             if (config.contains("encryption")) {
@@ -261,6 +395,12 @@ namespace Config {
             if (config.contains("patterns")) {
                 auto& pat_config = config["patterns"];
                 if (pat_config.contains("pattern_file_path")) patterns.pattern_file_path = pat_config["pattern_file_path"];
+                if (pat_config.contains("automaton_cache_path")) {
+                    patterns.automaton_cache_path = pat_config["automaton_cache_path"];
+                    if (!patterns.automaton_cache_path.empty())
+                        patterns.automaton_cache_path = get_absolute_path(patterns.automaton_cache_path);
+                }
+                if (pat_config.contains("default_field")) patterns.default_field = pat_config["default_field"];
                 if (pat_config.contains("default_patterns")) {
                     patterns.default_patterns = pat_config["default_patterns"].get<std::vector<std::string>>();
                 }
@@ -269,11 +409,52 @@ namespace Config {
             if (config.contains("logging")) {
                 auto& log_config = config["logging"];
                 if (log_config.contains("log_file_path")) logging.log_file_path = log_config["log_file_path"];
+                if (log_config.contains("level")) logging.level = log_config["level"];
             }
             
             if (config.contains("shared_memory")) {
                 auto& shm_config = config["shared_memory"];
                 if (shm_config.contains("queue_file_path")) shared_memory.queue_file_path = shm_config["queue_file_path"];
+                if (shm_config.contains("queue_dir")) {
+                    shared_memory.queue_dir = shm_config["queue_dir"];
+                    if (!shared_memory.queue_dir.empty())
+                        shared_memory.queue_dir = get_absolute_path(shared_memory.queue_dir);
+                }
+                if (shm_config.contains("agent_name")) shared_memory.agent_name = shm_config["agent_name"];
+            }
+            
+            if (config.contains("admission")) {
+                auto& adm_config = config["admission"];
+                auto load_limits = [&](const char* name, SourceLimits& l) {
+                    if (!adm_config.contains(name)) return;
+                    auto& src = adm_config[name];
+                    if (src.contains("rate")) l.rate = src["rate"];
+                    if (src.contains("burst")) l.burst = src["burst"];
+                    if (src.contains("queue_share")) l.queue_share = src["queue_share"];
+                };
+                if (adm_config.contains("enabled")) admission.enabled = adm_config["enabled"];
+                load_limits("syslog", admission.syslog);
+                load_limits("usb", admission.usb);
+                load_limits("file", admission.file);
+                if (adm_config.contains("sample_every")) admission.sample_every = adm_config["sample_every"];
+            }
+            
+            if (config.contains("threads")) {
+                auto& threads_config = config["threads"];
+                auto load_profile = [&](const char* name, ThreadProfile& p) {
+                    if (!threads_config.contains(name)) return;
+                    auto& src = threads_config[name];
+                    if (src.contains("cpus")) p.cpus = src["cpus"];
+                    if (src.contains("policy")) p.policy = src["policy"];
+                    if (src.contains("priority")) p.priority = src["priority"];
+                    if (src.contains("numa_local")) p.numa_local = src["numa_local"];
+                };
+                if (threads_config.contains("lock_memory")) threads.lock_memory = threads_config["lock_memory"];
+                if (threads_config.contains("prefault_queue")) threads.prefault_queue = threads_config["prefault_queue"];
+                load_profile("capture", threads.capture);
+                load_profile("worker", threads.worker);
+                load_profile("flusher", threads.flusher);
+                load_profile("uploader", threads.uploader);
             }
             
             std::cout << "Configuration loaded from: " << full_path << std::endl;
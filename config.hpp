@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -59,16 +60,60 @@ namespace Config {
         constexpr static int DEFAULT_NUM_WORKERS = 4;
         constexpr static int LOG_THRESHOLD = 50;
         constexpr static int TIME_THRESHOLD_SECONDS = 4;
+        // Longest an event may wait in the bucket, by severity. Critical events
+        // flush at once; normal ones wait at most the batch controller's wait,
+        // high ones at most HIGH_FLUSH_MS of it, and low-severity events wait
+        // longer so they mostly ride along with more urgent batches.
+        constexpr static int CRITICAL_FLUSH_MS = 0;
+        constexpr static int HIGH_FLUSH_MS = 1000;
+        constexpr static int LOW_FLUSH_MS = 15000;
         constexpr static int WORKER_SLEEP_MS = 1;
         constexpr static int FLUSHER_SLEEP_MS = 1000;
         constexpr static int MONITOR_POLL_MS = 500;
     };
     
+    // === Batch Sizing Configuration ===
+    // The reader sizes batches from the observed arrival rate and push latency
+    // so that a normal-severity event reaches storage within latency_budget_ms,
+    // keeping each batch between min_bytes and max_bytes of serialized JSON.
+    // With adaptive off it falls back to LOG_THRESHOLD / TIME_THRESHOLD_SECONDS.
+    struct BatchConfig {
+        bool adaptive = true;
+        size_t min_bytes = 16 * 1024;
+        size_t max_bytes = 4 * 1024 * 1024;
+        int latency_budget_ms = 4000;
+        constexpr static double EWMA_ALPHA = 0.2;
+        constexpr static double PUSH_LATENCY_DEVIATIONS = 4.0;   // margin kept for slow pushes
+        constexpr static size_t INITIAL_BYTES_PER_EVENT = 512;
+    };
+    
+    // === Metrics Configuration ===
+    // The reader serves Prometheus text on a Unix socket (empty path = off)
+    // and/or a loopback HTTP port (0 = off).
+    struct MetricsConfig {
+        bool enabled = true;
+        std::string socket_path = "tmp/metrics.sock";
+        int http_port = 0;
+        constexpr static int POLL_MS = 250;
+    };
+    
+    // === Trace Configuration ===
+    // One in sample_every events is traced through agent and reader (0 = off);
+    // each process writes <dir>/<process>-<pid>.json on shutdown.
+    struct TraceConfig {
+        uint32_t sample_every = 0;
+        std::string dir = "tmp/trace";
+        constexpr static size_t BUFFER_RECORDS = 1 << 16;   // per thread; later records are dropped
+    };
+    
     // === File Monitoring Configuration ===
     struct FileMonitorConfig {
         std::vector<std::string> watch_paths;
         constexpr static int INOTIFY_BUFFER_SIZE = 8192;
         constexpr static int INOTIFY_TIMEOUT_MS = 500;
+        constexpr static int ROLLUP_WINDOW_MS = 1000;
+        constexpr static size_t ROLLUP_BURST_THRESHOLD = 16;
+        constexpr static size_t ROLLUP_SAMPLE_NAMES = 3;
         
         FileMonitorConfig() {
             // Default watch paths - can be overridden
@@ -89,17 +134,36 @@ namespace Config {
     struct SystemMonitorConfig {
         std::string syslog_path = "/var/log/syslog";
         std::string journald_path = "/var/log/journal";
+        // "udev", or "fifo" to read "<action> <vendor> <product> <devnode> [<devpath>]"
+        // lines from usb_fifo_path (used by loadgen to inject USB events).
+        std::string usb_source = "udev";
+        std::string usb_fifo_path = "tmp/usb_events.fifo";
+        bool syslog_dedup = true;                   // collapse repeated matched lines per template
         constexpr static int SYSLOG_BUFFER_SIZE = 8192;
+        constexpr static int DEDUP_WINDOW_MS = 1000;
+        constexpr static size_t DEDUP_CAPACITY = 1024;      // templates tracked (LRU)
         constexpr static int USB_POLL_TIMEOUT_MS = 500;
+        constexpr static size_t USB_CACHE_CAPACITY = 1024;   // devices whose attributes are remembered
     };
     
     // === IPFS Configuration ===
     struct IPFSConfig {
         std::string ipns_key_name = "log-agent";
         std::string ipfs_daemon_url = "http://localhost:5001";
+        std::string batch_format = "json";   // "json" or "ndjson"
+        int cid_version = 0;                  // 0 ("Qm...") or 1 ("bafy...", raw leaves)
         constexpr static int IPFS_TIMEOUT_SECONDS = 5;
         constexpr static int IPNS_TTL_SECONDS = 0;
         constexpr static bool ALLOW_OFFLINE = true;
+        // Sealed batches are linked by their locally computed CID and uploaded
+        // in the background; at most this many may wait for upload before the
+        // reader stops sealing (and lets batches grow instead).
+        constexpr static size_t UPLOAD_QUEUE_DEPTH = 8;
+        constexpr static int UPLOAD_RETRY_MS = 1000;
+        constexpr static int UPLOAD_SHUTDOWN_ATTEMPTS = 3;
+        // chaincar export: block requests in flight, and tries per block.
+        constexpr static int EXPORT_FETCH_JOBS = 8;
+        constexpr static int BLOCK_GET_ATTEMPTS = 3;
         
         // IPFS URLs for installation
         constexpr static const char* IPFS_DOWNLOAD_URL = "https://dist.ipfs.tech/kubo/v0.22.0/kubo_v0.22.0_linux-amd64.tar.gz";
@@ -107,6 +171,29 @@ namespace Config {
         constexpr static const char* AHO_CORASICK_URL = "https://raw.githubusercontent.com/cjgdev/aho_corasick/master/src/aho_corasick/aho_corasick.hpp";
     };
     
+    // === Chain Configuration ===
+    // By default every event goes into one chain published under
+    // ipfs.ipns_key_name. With chains enabled, each group is a chain of its
+    // own with its own IPNS key, sealed and uploaded independently of the
+    // others. An event goes into the first group listing its source
+    // ("syslog", "usb" or "file"), or the first group if none does. Without
+    // groups there is one chain per source; a group without ipns_key is keyed
+    // "<ipns_key_name>-<name>".
+    // Every manifest_interval_s, if a head moved, a manifest naming each
+    // chain's head is published under manifest_key (empty = "<ipns_key_name>-manifest").
+    struct ChainGroup {
+        std::string name;
+        std::string ipns_key;
+        std::vector<std::string> sources;
+    };
+
+    struct ChainsConfig {
+        bool enabled = false;
+        std::vector<ChainGroup> groups;
+        std::string manifest_key;
+        int manifest_interval_s = 30;
+    };
+    
     // === Encryption Configuration ===
     struct EncryptionConfig {
         std::string private_key_path;
@@ -124,12 +211,20 @@ namespace Config {
     };
     
     // === Pattern Configuration ===
+    // One pattern per line, optionally prefixed with a severity tag:
+    // "[critical] kernel panic", "[high] segfault", "[low] session opened".
+    // Untagged patterns are normal severity. The compiled matcher is cached in
+    // automaton_cache_path (empty = compile on every start).
     struct PatternConfig {
         std::string pattern_file_path;
+        std::string automaton_cache_path;
+        std::string default_field;            // syslog field searched by rules without @in=
         std::vector<std::string> default_patterns;
 
         PatternConfig(){
             pattern_file_path = "tmp/pattern.txt";
+            automaton_cache_path = "tmp/patterns.acm";
+            default_field = "message";
             default_patterns = {
                 "permission denied",
                 "unauthorized access",
@@ -137,43 +232,43 @@ namespace Config {
                 "authentication failure",
                 "failed login",
                 "invalid user",
-                "segfault",
-                "segmentation fault",
+                "[high] segfault",
+                "[high] segmentation fault",
                 "core dumped",
-                "panic",
-                "kernel panic",
-                "oom-killer",
-                "out of memory",
-                "disk failure",
-                "i/o error",
-                "filesystem error",
+                "[high] panic",
+                "[critical] kernel panic",
+                "[critical] oom-killer",
+                "[high] out of memory",
+                "[critical] disk failure",
+                "[high] i/o error",
+                "[high] filesystem error",
                 "mount failure",
                 "device not ready",
                 "usb disconnect",
-                "usb device added",
+                "[low] usb device added",
                 "connection refused",
                 "network unreachable",
                 "no route to host",
-                "packet loss",
-                "connection timeout",
-                "port scan",
-                "scan detected",
-                "intrusion detected",
-                "malware detected",
+                "[low] packet loss",
+                "[low] connection timeout",
+                "[high] port scan",
+                "[high] scan detected",
+                "[critical] intrusion detected",
+                "[critical] malware detected",
                 "root access",
-                "root login",
+                "[high] root login",
                 "sudo failure",
-                "failed password",
+                "[high] failed password",
                 "invalid password",
-                "session opened",
-                "session closed",
+                "[low] session opened",
+                "[low] session closed",
                 "rejected",
                 "blacklisted",
                 "firewall drop",
                 "iptables drop",
-                "selinux violation",
+                "[high] selinux violation",
                 "audit failure",
-                "kernel bug",
+                "[high] kernel bug",
                 "modprobe error",
                 "service crash",
                 "daemon died",
@@ -182,41 +277,41 @@ namespace Config {
                 "fatal error",
                 "systemd failure",
                 "service failed",
-                "watchdog timeout",
-                "login attempt",
-                "brute force",
+                "[high] watchdog timeout",
+                "[low] login attempt",
+                "[high] brute force",
                 "login rate limit",
                 "tcp reset",
-                "dns spoof",
+                "[high] dns spoof",
                 "suspicious activity",
                 "invalid certificate",
                 "certificate expired",
                 "key mismatch",
-                "ssh disconnect",
-                "ssh login failed",
+                "[low] ssh disconnect",
+                "[high] ssh login failed",
                 "ssh key rejected",
-                "ransomware",
+                "[critical] ransomware",
                 "phishing",
-                "trojan",
-                "worm",
-                "exploit",
-                "buffer overflow",
-                "heap corruption",
-                "stack smash",
+                "[critical] trojan",
+                "[critical] worm",
+                "[critical] exploit",
+                "[high] buffer overflow",
+                "[critical] heap corruption",
+                "[critical] stack smash",
                 "format string",
-                "double free",
+                "[high] double free",
                 "race condition",
-                "memory leak",
+                "[low] memory leak",
                 "unexpected reboot",
                 "system halt",
-                "service not found",
+                "[low] service not found",
                 "executable not found",
                 "segmentation violation",
                 "unknown device",
                 "invalid configuration",
-                "tampering",
+                "[critical] tampering",
                 "configuration mismatch",
-                "unexpected behavior",
+                "[low] unexpected behavior",
                 "error while loading shared libraries",
                 "unable to resolve host",
                 "failed to execute",
@@ -335,6 +430,7 @@ namespace Config {
     // === Logging Configuration ===
     struct LoggingConfig {
         std::string log_file_path;
+        std::string level = "info";                 // "debug", "info", "warn" or "error"
         constexpr static bool ENABLE_CONSOLE_LOGGING = true;
         constexpr static bool ENABLE_FILE_LOGGING = true;
         constexpr static int MAX_LOG_FILE_SIZE_MB = 100;
@@ -348,14 +444,64 @@ namespace Config {
     // === Shared Memory Configuration ===
     struct SharedMemoryConfig {
         std::string queue_file_path;
+        // Fan-in: with queue_dir set, each agent creates its queue as
+        // <queue_dir>/<agent_name>.queue instead of queue_file_path, and one
+        // reader drains every segment in the directory, tagging events with
+        // the agent's name. agent_name defaults to the host name.
+        std::string queue_dir;
+        std::string agent_name;
         constexpr static int FILE_PERMISSIONS = 0666;
         constexpr static bool CREATE_IF_NOT_EXISTS = true;
+        constexpr static int SEGMENT_SCAN_MS = 1000;        // how often the reader looks for new or removed segments
+        constexpr static size_t SEGMENT_BURST = 64;         // events a worker takes from one segment before the next
         
         SharedMemoryConfig() {
             queue_file_path = "tmp/event_queue_shm";
         }
     };
     
+    // === Admission Control Configuration ===
+    // Per-source token buckets (events/s, burst) and the queue fill level above
+    // which a source's events are shed. Excess events are sampled 1 in
+    // sample_every; everything shed is counted in periodic accounting events.
+    struct SourceLimits {
+        double rate;
+        double burst;
+        double queue_share;
+    };
+
+    struct AdmissionConfig {
+        bool enabled = true;
+        SourceLimits syslog{5000, 10000, 0.50};
+        SourceLimits usb{200, 400, 0.95};
+        SourceLimits file{2000, 4000, 0.75};
+        uint32_t sample_every = 100;
+        constexpr static int REPORT_INTERVAL_MS = 5000;
+        constexpr static int TRY_ENQUEUE_ATTEMPTS = 8;
+    };
+    
+    // === Thread Profiles ===
+    // Placement and scheduling per thread role. cpus is a list such as "2-3,6"
+    // (empty = any CPU); policy is "other", "fifo" or "rr", the real-time ones
+    // with priority 1-99 (needs CAP_SYS_NICE or an rtprio limit). numa_local
+    // allocates the thread's memory, and for capture also the shared queue,
+    // on the NUMA node of its CPUs.
+    struct ThreadProfile {
+        std::string cpus;
+        std::string policy = "other";
+        int priority = 0;
+        bool numa_local = false;
+    };
+    
+    struct ThreadsConfig {
+        bool lock_memory = false;      // mlockall() in agent and reader
+        bool prefault_queue = true;    // fault in the whole shared queue at startup
+        ThreadProfile capture;         // agent monitors
+        ThreadProfile worker;          // reader queue consumers
+        ThreadProfile flusher;
+        ThreadProfile uploader;
+    };
+    
     // === Systemd Configuration ===
     struct SystemdConfig {
         constexpr static bool ENABLE_SYSTEMD_INTEGRATION = true;
@@ -369,10 +515,16 @@ namespace Config {
     extern FileMonitorConfig file_monitor;
     extern SystemMonitorConfig system_monitor;
     extern IPFSConfig ipfs;
+    extern ChainsConfig chains;
     extern EncryptionConfig encryption;
     extern PatternConfig patterns;
     extern LoggingConfig logging;
     extern SharedMemoryConfig shared_memory;
+    extern AdmissionConfig admission;
+    extern ThreadsConfig threads;
+    extern BatchConfig batch;
+    extern MetricsConfig metrics;
+    extern TraceConfig trace;
     
     // === Configuration Management ===
     void initialize_config();
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include "event.hpp"
+#include "timestamp.hpp"
+#include "async_logger.hpp"
+#include "trace.hpp"
+#include "config.hpp"
+
+// Token bucket refilled continuously at `rate` tokens per second, holding at
+// most `burst` tokens. Starts full.
+class TokenBucket {
+public:
+    TokenBucket(double rate, double burst, uint64_t now_ns)
+        : rate_(rate), burst_(std::max(burst, 1.0)), tokens_(burst_), last_ns_(now_ns) {}
+
+    bool try_take(uint64_t now_ns) {
+        if (now_ns > last_ns_) {
+            tokens_ = std::min(burst_, tokens_ + (now_ns - last_ns_) * rate_ / 1e9);
+            last_ns_ = now_ns;
+        }
+        if (tokens_ < 1.0) return false;
+        tokens_ -= 1.0;
+        return true;
+    }
+
+private:
+    double rate_;
+    double burst_;
+    double tokens_;
+    uint64_t last_ns_;
+};
+
+// Admission control in front of the shared queue for one monitor thread.
+//
+// An event is shed when the queue is fuller than the source's share of it (so
+// low-share sources give way first as the reader falls behind), then checked
+// against the source's token bucket; events over the rate are sampled one in
+// `sample_every`. Critical events skip both checks. Nothing here blocks: a
+// queue with no free slot after a few attempts counts as a drop. Event ids are
+// assigned on admission, so the ids seen by the reader stay contiguous except
+// where enqueue itself failed.
+//
+// Every shed event is counted, and maybe_report() periodically queues an
+// ADMISSION_REPORT with the exact counts for the interval. Counters are only
+// reset once a report is queued; if it cannot be, the next one covers both
+// intervals.
+class AdmissionGate {
+public:
+    AdmissionGate(QueueType* queue, EventSource source, const Config::SourceLimits& limits,
+                  std::atomic<uint64_t>& id_counter)
+        : queue_(queue), source_(source), id_counter_(id_counter),
+          enabled_(Config::admission.enabled), sample_every_(Config::admission.sample_every),
+          share_limit_(static_cast<size_t>(std::clamp(limits.queue_share, 0.0, 1.0) * QUEUE_SIZE)),
+          bucket_(limits.rate, limits.burst, monotonic_ns()), interval_start_ns_(monotonic_ns()) {}
+
+    // Offers one event to the queue. Returns true if it was queued.
+    bool submit(RawEvent& ev) {
+        if (!enabled_) {
+            ev.event_id = id_counter_.fetch_add(1);
+            ev.trace_id = trace::sample();
+            uint64_t start_ns = ev.trace_id ? monotonic_ns() : 0;
+            while (!queue_->enqueue(ev)) std::this_thread::yield();
+            trace_enqueued(ev, start_ns);
+            ++counts_.admitted;
+            return true;
+        }
+        if (ev.severity == SEVERITY_CRITICAL) return submit_summary(ev);
+
+        if (queue_->size_approx() >= share_limit_) {
+            ++counts_.dropped_quota;
+            return false;
+        }
+        bool sampled = false;
+        if (!bucket_.try_take(monotonic_ns())) {
+            if (sample_every_ == 0 || ++excess_ % sample_every_ != 0) {
+                ++counts_.dropped_rate;
+                return false;
+            }
+            sampled = true;
+        }
+        if (!enqueue(ev)) return false;
+        ++(sampled ? counts_.sampled : counts_.admitted);
+        return true;
+    }
+
+    // Queues an event that already summarizes others (repeat or rollup
+    // summaries), or a critical one. It bypasses the rate limit and quota,
+    // since shedding it would lose more than one event or the one that
+    // matters, but is still dropped rather than blocking.
+    bool submit_summary(RawEvent& ev) {
+        if (!enabled_) return submit(ev);
+        if (!enqueue(ev)) return false;
+        ++counts_.admitted;
+        return true;
+    }
+
+    // Queues an accounting report once per REPORT_INTERVAL_MS (or now, with
+    // `force`, at shutdown) for intervals in which anything was sampled or shed.
+    void maybe_report(bool force = false) {
+        uint64_t now = monotonic_ns();
+        uint64_t elapsed_ns = now - interval_start_ns_;
+        if (!force && elapsed_ns < static_cast<uint64_t>(Config::AdmissionConfig::REPORT_INTERVAL_MS) * 1'000'000)
+            return;
+
+        uint64_t shed = counts_.sampled + counts_.dropped_rate + counts_.dropped_quota + counts_.dropped_full;
+        if (shed == 0) {
+            reset(now);
+            return;
+        }
+
+        RawEvent ev{};
+        ev.type = ADMISSION_REPORT;
+        ev.severity = SEVERITY_NORMAL;
+        stamp_capture(ev);
+        auto& a = ev.admission;
+        a.source = source_;
+        a.interval_ms = static_cast<uint32_t>(elapsed_ns / 1'000'000);
+        a.admitted = counts_.admitted;
+        a.sampled = counts_.sampled;
+        a.dropped_rate = counts_.dropped_rate;
+        a.dropped_quota = counts_.dropped_quota;
+        a.dropped_full = counts_.dropped_full;
+        a.queue_depth = static_cast<uint32_t>(queue_->size_approx());
+
+        ev.event_id = id_counter_.fetch_add(1);
+        if (!queue_->try_enqueue(ev, Config::AdmissionConfig::TRY_ENQUEUE_ATTEMPTS)) return;
+        logger::warn("ADMISSION", "{}: admitted {}, sampled {}, dropped rate {} quota {} full {} in {} ms",
+                     event_source_name(source_), a.admitted, a.sampled, a.dropped_rate, a.dropped_quota,
+                     a.dropped_full, a.interval_ms);
+        reset(now);
+    }
+
+private:
+    struct Counts {
+        uint64_t admitted = 0;
+        uint64_t sampled = 0;
+        uint64_t dropped_rate = 0;
+        uint64_t dropped_quota = 0;
+        uint64_t dropped_full = 0;
+    };
+
+    bool enqueue(RawEvent& ev) {
+        ev.event_id = id_counter_.fetch_add(1);
+        ev.trace_id = trace::sample();
+        uint64_t start_ns = ev.trace_id ? monotonic_ns() : 0;
+        if (queue_->try_enqueue(ev, Config::AdmissionConfig::TRY_ENQUEUE_ATTEMPTS)) {
+            trace_enqueued(ev, start_ns);
+            return true;
+        }
+        ++counts_.dropped_full;
+        return false;
+    }
+
+    // Capture covers the monitor's work from stamping the event to offering it.
+    static void trace_enqueued(const RawEvent& ev, uint64_t start_ns) {
+        if (!ev.trace_id) return;
+        trace::span(ev.trace_id, "capture", ev.capture_monotonic_ns, start_ns, trace::Kind::FlowStart);
+        trace::span(ev.trace_id, "enqueue", start_ns, monotonic_ns());
+    }
+
+    void reset(uint64_t now) {
+        counts_ = Counts{};
+        interval_start_ns_ = now;
+    }
+
+    QueueType* queue_;
+    EventSource source_;
+    std::atomic<uint64_t>& id_counter_;
+    bool enabled_;
+    uint32_t sample_every_;
+    size_t share_limit_;
+    TokenBucket bucket_;
+    uint64_t excess_ = 0;             // events over the rate, for 1-in-N sampling
+    uint64_t interval_start_ns_;
+    Counts counts_;
+};
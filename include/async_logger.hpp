@@ -0,0 +1,457 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "timestamp.hpp"
+#include "config.hpp"
+
+// Asynchronous logger. Producers encode their arguments in binary form into a
+// per-thread single-producer ring and return; a background thread formats the
+// records, writes them to the console and/or a size-rotated file, and never
+// holds up the caller. When a ring is full the record is dropped and counted.
+//
+//     logger::info("SYSLOG", "matched {} patterns: {}", count, line);
+//
+// Levels below RTSA_LOG_MIN_LEVEL are compiled out; Config::logging.level
+// filters the rest at run time.
+
+#ifndef RTSA_LOG_MIN_LEVEL
+#define RTSA_LOG_MIN_LEVEL 0
+#endif
+
+namespace logger {
+
+enum class Level : uint8_t { Debug = 0, Info = 1, Warn = 2, Error = 3 };
+
+inline const char* level_name(Level l) {
+    switch (l) {
+        case Level::Debug: return "DEBUG";
+        case Level::Info: return "INFO";
+        case Level::Warn: return "WARN";
+        default: return "ERROR";
+    }
+}
+
+inline Level level_from_string(const std::string& s) {
+    if (s == "debug") return Level::Debug;
+    if (s == "warn") return Level::Warn;
+    if (s == "error") return Level::Error;
+    return Level::Info;
+}
+
+namespace detail {
+
+constexpr size_t RECORD_SIZE = 512;
+constexpr size_t RING_SIZE = 1024;
+constexpr int DRAIN_SLEEP_MS = 2;
+
+// Decoded argument handed to the formatter.
+struct ArgView {
+    enum Kind : uint8_t { SIGNED, UNSIGNED, FLOAT, BOOL, STRING } kind;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+    };
+    std::string_view s;
+};
+
+using FormatFn = void (*)(std::string& out, const char* fmt, const char* data, size_t arg_count);
+
+struct Record {
+    uint64_t realtime_ns;
+    const char* tag;                 // must be a string literal
+    const char* fmt;                 // must be a string literal
+    FormatFn format;
+    Level level;
+    uint8_t arg_count;               // arguments that fit in data; the rest render as "…"
+    uint16_t data_len;
+    char data[RECORD_SIZE - 40];
+};
+
+template<typename T>
+constexpr bool is_string_arg =
+    std::is_same_v<T, const char*> || std::is_same_v<T, char*> ||
+    std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+template<typename T>
+using stored_t = std::decay_t<T>;
+
+// --- encoding (producer side) ---
+
+// Encoding stops at the first argument that does not fit; a string is cut
+// short rather than skipped as long as its length prefix fits.
+struct Encoder {
+    char* p;
+    char* end;
+    uint8_t count = 0;
+    bool full = false;
+
+    void put(const void* src, size_t n) {
+        memcpy(p, src, n);
+        p += n;
+    }
+
+    template<typename T>
+    void operator()(const T& v) {
+        using S = stored_t<T>;
+        if (full) return;
+        size_t room = static_cast<size_t>(end - p);
+        if constexpr (is_string_arg<S>) {
+            std::string_view sv;
+            if constexpr (std::is_pointer_v<S>) sv = v ? std::string_view(v) : std::string_view("(null)");
+            else sv = std::string_view(v);
+            if (room < sizeof(uint16_t)) {
+                full = true;
+                return;
+            }
+            uint16_t len = static_cast<uint16_t>(std::min(sv.size(), room - sizeof(uint16_t)));
+            put(&len, sizeof(len));
+            put(sv.data(), len);
+        } else {
+            static_assert(std::is_arithmetic_v<S> || std::is_enum_v<S>,
+                          "logger arguments must be arithmetic, enum or string-like");
+            if (room < sizeof(S)) {
+                full = true;
+                return;
+            }
+            put(&v, sizeof(S));
+        }
+        ++count;
+    }
+};
+
+// --- decoding (drain side) ---
+
+// Arguments the producer could not fit are not in the data at all; they
+// decode to a placeholder without touching p.
+template<typename T>
+ArgView decode(const char*& p, bool present) {
+    using S = stored_t<T>;
+    ArgView a{};
+    if (!present) {
+        a.kind = ArgView::STRING;
+        a.s = "…";
+    } else if constexpr (is_string_arg<S>) {
+        uint16_t len;
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        a.kind = ArgView::STRING;
+        a.s = std::string_view(p, len);
+        p += len;
+    } else {
+        S v;
+        memcpy(&v, p, sizeof(S));
+        p += sizeof(S);
+        if constexpr (std::is_same_v<S, bool>) { a.kind = ArgView::BOOL; a.b = v; }
+        else if constexpr (std::is_floating_point_v<S>) { a.kind = ArgView::FLOAT; a.d = v; }
+        else if constexpr (std::is_enum_v<S>) { a.kind = ArgView::SIGNED; a.i = static_cast<int64_t>(v); }
+        else if constexpr (std::is_signed_v<S>) { a.kind = ArgView::SIGNED; a.i = v; }
+        else { a.kind = ArgView::UNSIGNED; a.u = v; }
+    }
+    return a;
+}
+
+inline void render(std::string& out, const char* fmt, const ArgView* args, size_t count) {
+    size_t next = 0;
+    for (const char* f = fmt; *f; ++f) {
+        if (f[0] == '{' && f[1] == '}') {
+            ++f;
+            if (next >= count) continue;
+            const ArgView& a = args[next++];
+            char buf[32];
+            switch (a.kind) {
+                case ArgView::STRING: out += a.s; break;
+                case ArgView::BOOL: out += a.b ? "true" : "false"; break;
+                case ArgView::SIGNED: out.append(buf, std::to_chars(buf, buf + sizeof(buf), a.i).ptr - buf); break;
+                case ArgView::UNSIGNED: out.append(buf, std::to_chars(buf, buf + sizeof(buf), a.u).ptr - buf); break;
+                case ArgView::FLOAT: out.append(buf, snprintf(buf, sizeof(buf), "%.3f", a.d)); break;
+            }
+        } else {
+            out += *f;
+        }
+    }
+}
+
+template<typename... Args>
+void format_record(std::string& out, const char* fmt, const char* data, size_t arg_count) {
+    [[maybe_unused]] const char* p = data;
+    [[maybe_unused]] size_t i = 0;
+    // Braced initialization evaluates left to right, matching encode order.
+    std::array<ArgView, sizeof...(Args) + 1> views = {decode<Args>(p, i++ < arg_count)..., ArgView{}};
+    render(out, fmt, views.data(), sizeof...(Args));
+}
+
+template<typename... Args>
+void encode_record(Record& r, const char* fmt, const Args&... args) {
+    static_assert(sizeof...(Args) <= UINT8_MAX, "too many logger arguments");
+    r.fmt = fmt;
+    r.format = &format_record<Args...>;
+    Encoder enc{r.data, r.data + sizeof(r.data)};
+    (enc(args), ...);
+    r.arg_count = enc.count;
+    r.data_len = static_cast<uint16_t>(enc.p - r.data);
+}
+
+// Single-producer / single-consumer ring owned by one logging thread.
+struct ThreadRing {
+    alignas(Config::QueueConfig::CACHE_LINE_SIZE) std::atomic<uint64_t> head{0};   // consumer
+    alignas(Config::QueueConfig::CACHE_LINE_SIZE) std::atomic<uint64_t> tail{0};   // producer
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> orphaned{false};
+    Record slots[RING_SIZE];
+};
+
+class Logger {
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    void set_level(Level l) { level_.store(static_cast<uint8_t>(l), std::memory_order_relaxed); }
+    bool enabled(Level l) const { return static_cast<uint8_t>(l) >= level_.load(std::memory_order_relaxed); }
+
+    void start(const std::string& process_name) {
+        if (running_.exchange(true)) return;
+        set_level(level_from_string(Config::logging.level));
+        console_ = Config::LoggingConfig::ENABLE_CONSOLE_LOGGING;
+        if (Config::LoggingConfig::ENABLE_FILE_LOGGING) {
+            // One file per process so agent and reader never rotate each other's file.
+            std::string path = Config::logging.log_file_path;
+            size_t dot = path.rfind('.');
+            size_t slash = path.rfind('/');
+            if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+                path.insert(dot, "." + process_name);
+            else
+                path += "." + process_name;
+            file_path_ = path;
+            open_file();
+        }
+        drain_thread_ = std::thread([this] { drain_loop(); });
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) return;
+        if (drain_thread_.joinable()) drain_thread_.join();
+        drain_all();
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    template<typename... Args>
+    void log(Level level, const char* tag, const char* fmt, const Args&... args) {
+        ThreadRing* ring = local_ring();
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail - ring->head.load(std::memory_order_acquire) >= RING_SIZE) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record& r = ring->slots[tail & (RING_SIZE - 1)];
+        r.realtime_ns = realtime_ns();
+        r.tag = tag;
+        r.level = level;
+        encode_record(r, fmt, args...);
+        ring->tail.store(tail + 1, std::memory_order_release);
+    }
+
+    ~Logger() { stop(); }
+
+private:
+    Logger() = default;
+
+    struct RingHandle {
+        std::shared_ptr<ThreadRing> ring;
+        ~RingHandle() {
+            if (ring) ring->orphaned.store(true, std::memory_order_release);
+        }
+    };
+
+    ThreadRing* local_ring() {
+        thread_local RingHandle handle;
+        if (!handle.ring) {
+            handle.ring = std::make_shared<ThreadRing>();
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings_.push_back(handle.ring);
+        }
+        return handle.ring.get();
+    }
+
+    void drain_loop() {
+        while (running_.load(std::memory_order_acquire)) {
+            if (!drain_all()) std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_SLEEP_MS));
+        }
+    }
+
+    // Formats and writes everything currently queued; returns whether any
+    // record was processed.
+    bool drain_all() {
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings = rings_;
+        }
+
+        bool any = false;
+        file_buf_.clear();
+        out_buf_.clear();
+        err_buf_.clear();
+        for (auto& ring : rings) {
+            uint64_t head = ring->head.load(std::memory_order_relaxed);
+            uint64_t tail = ring->tail.load(std::memory_order_acquire);
+            for (; head != tail; ++head) {
+                const Record& r = ring->slots[head & (RING_SIZE - 1)];
+                line_.clear();
+                formatter_.append(line_, r.realtime_ns);
+                line_ += ' ';
+                line_ += level_name(r.level);
+                line_ += " [";
+                line_ += r.tag;
+                line_ += "] ";
+                r.format(line_, r.fmt, r.data, r.arg_count);
+                line_ += '\n';
+                emit(r.level);
+                any = true;
+            }
+            ring->head.store(head, std::memory_order_release);
+
+            uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped) {
+                line_.clear();
+                formatter_.append(line_, realtime_ns());
+                line_ += " WARN [LOGGER] dropped " + std::to_string(dropped) + " records (ring full)\n";
+                emit(Level::Warn);
+            }
+        }
+
+        if (console_) {
+            // INFO and DEBUG go to stdout, WARN and ERROR to stderr.
+            write_all(STDOUT_FILENO, out_buf_.data(), out_buf_.size());
+            write_all(STDERR_FILENO, err_buf_.data(), err_buf_.size());
+        }
+        if (fd_ >= 0 && !file_buf_.empty()) {
+            rotate_if_needed(file_buf_.size());
+            write_all(fd_, file_buf_.data(), file_buf_.size());
+            file_size_ += file_buf_.size();
+        }
+        prune_orphans();
+        return any;
+    }
+
+    void emit(Level level) {
+        if (fd_ >= 0) file_buf_ += line_;
+        if (console_) (level >= Level::Warn ? err_buf_ : out_buf_) += line_;
+    }
+
+    static void write_all(int fd, const char* p, size_t n) {
+        while (n > 0) {
+            ssize_t w = ::write(fd, p, n);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            p += w;
+            n -= static_cast<size_t>(w);
+        }
+    }
+
+    void open_file() {
+        fd_ = ::open(file_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        struct stat st;
+        file_size_ = (fd_ >= 0 && fstat(fd_, &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+    }
+
+    // Size-based rotation: file -> file.1 -> ... -> file.(MAX_LOG_FILES - 1).
+    void rotate_if_needed(size_t incoming) {
+        constexpr uint64_t max_bytes = static_cast<uint64_t>(Config::LoggingConfig::MAX_LOG_FILE_SIZE_MB) * 1024 * 1024;
+        if (file_size_ + incoming <= max_bytes || file_size_ == 0) return;
+
+        ::close(fd_);
+        constexpr int keep = Config::LoggingConfig::MAX_LOG_FILES;
+        std::remove((file_path_ + "." + std::to_string(keep - 1)).c_str());
+        for (int i = keep - 2; i >= 1; --i) {
+            std::rename((file_path_ + "." + std::to_string(i)).c_str(),
+                        (file_path_ + "." + std::to_string(i + 1)).c_str());
+        }
+        if (keep > 1) std::rename(file_path_.c_str(), (file_path_ + ".1").c_str());
+        else std::remove(file_path_.c_str());
+        open_file();
+    }
+
+    void prune_orphans() {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (auto it = rings_.begin(); it != rings_.end();) {
+            ThreadRing& r = **it;
+            if (r.orphaned.load(std::memory_order_acquire) &&
+                r.head.load(std::memory_order_relaxed) == r.tail.load(std::memory_order_acquire))
+                it = rings_.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::atomic<uint8_t> level_{static_cast<uint8_t>(Level::Info)};
+    std::atomic<bool> running_{false};
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<ThreadRing>> rings_;
+    std::thread drain_thread_;
+
+    // Drain-thread state.
+    TimestampFormatter formatter_;
+    std::string line_;
+    std::string file_buf_;
+    std::string out_buf_;
+    std::string err_buf_;
+    std::string file_path_;
+    int fd_ = -1;
+    uint64_t file_size_ = 0;
+    bool console_ = true;
+};
+
+} // namespace detail
+
+inline void start(const std::string& process_name) { detail::Logger::instance().start(process_name); }
+inline void stop() { detail::Logger::instance().stop(); }
+
+// For call sites that must do work to build their arguments.
+template<Level L>
+inline bool enabled() {
+    if constexpr (static_cast<int>(L) >= RTSA_LOG_MIN_LEVEL) return detail::Logger::instance().enabled(L);
+    else return false;
+}
+
+template<Level L, typename... Args>
+inline void log(const char* tag, const char* fmt, const Args&... args) {
+    if constexpr (static_cast<int>(L) >= RTSA_LOG_MIN_LEVEL) {
+        auto& l = detail::Logger::instance();
+        if (l.enabled(L)) l.log(L, tag, fmt, args...);
+    }
+}
+
+template<typename... Args>
+inline void debug(const char* tag, const char* fmt, const Args&... args) { log<Level::Debug>(tag, fmt, args...); }
+template<typename... Args>
+inline void info(const char* tag, const char* fmt, const Args&... args) { log<Level::Info>(tag, fmt, args...); }
+template<typename... Args>
+inline void warn(const char* tag, const char* fmt, const Args&... args) { log<Level::Warn>(tag, fmt, args...); }
+template<typename... Args>
+inline void error(const char* tag, const char* fmt, const Args&... args) { log<Level::Error>(tag, fmt, args...); }
+
+} // namespace logger
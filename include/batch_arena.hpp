@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Memory for sealing one batch: the ciphertext, the envelope text and
+// whatever else a seal builds and drops. Allocations bump a pointer through
+// one block; reset() ends the batch by rewinding it, with no per-object
+// frees. A batch that outgrows the block spills to the heap (counted in
+// heap_allocations) and the block is regrown to the new high-water mark on
+// reset, so steady-state batches never touch the allocator.
+//
+// Single-threaded: one arena per chain, used only by whichever thread holds
+// that chain's Chain::flushing while it seals. The stats are atomics so the
+// metrics thread may read them.
+class BatchArena {
+public:
+    struct Stats {
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> last_allocations{0};    // served by the arena in the last batch
+        std::atomic<uint64_t> last_bytes{0};
+        std::atomic<uint64_t> heap_allocations{0};    // blocks and spills, all batches
+        std::atomic<uint64_t> capacity{0};
+    };
+
+    explicit BatchArena(size_t initial_bytes = 1 << 20) { rebuild(initial_bytes); }
+    BatchArena(const BatchArena&) = delete;
+    BatchArena& operator=(const BatchArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &front_; }
+
+    // Ends the batch. Everything allocated from resource() is gone.
+    void reset() {
+        stats_.batches.fetch_add(1, std::memory_order_relaxed);
+        stats_.last_allocations.store(front_.count, std::memory_order_relaxed);
+        stats_.last_bytes.store(front_.bytes, std::memory_order_relaxed);
+        stats_.heap_allocations.fetch_add(heap_.count, std::memory_order_relaxed);
+        const bool spilled = heap_.count > 0;
+        const size_t used = front_.bytes;
+        front_.count = front_.bytes = 0;
+        heap_.count = heap_.bytes = 0;
+        if (spilled) rebuild(used + used / 4);
+        else monotonic_->release();
+    }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    // Counts what passes through to `next`.
+    struct Counting : std::pmr::memory_resource {
+        std::pmr::memory_resource* next = nullptr;
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+
+        void* do_allocate(size_t n, size_t align) override {
+            ++count;
+            bytes += n;
+            return next->allocate(n, align);
+        }
+        void do_deallocate(void* p, size_t n, size_t align) override { next->deallocate(p, n, align); }
+        bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+    };
+
+    void rebuild(size_t bytes) {
+        monotonic_.reset();
+        block_.reset(new std::byte[bytes]);   // not zeroed
+        heap_.next = std::pmr::new_delete_resource();
+        monotonic_.emplace(block_.get(), bytes, &heap_);
+        front_.next = &*monotonic_;
+        stats_.capacity.store(bytes, std::memory_order_relaxed);
+        stats_.heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<std::byte[]> block_;
+    Counting heap_;     // monotonic_ -> heap, past the end of block_
+    std::optional<std::pmr::monotonic_buffer_resource> monotonic_;
+    Counting front_;    // callers -> monotonic_
+    Stats stats_;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include "config.hpp"
+
+// Decides how large a batch the reader should build and how long a
+// normal-severity event may wait for one.
+//
+// After every push it updates smoothed estimates of the arrival rate (events
+// collected / time since the previous collect), the serialized size per event
+// and the push latency (from collection until the upload is verified, tracked
+// as mean and mean deviation like a TCP RTT). The wait is the latency budget
+// minus the expected push time plus a margin for slow pushes; the target batch
+// is what arrives in that wait, clamped to [min_bytes, max_bytes]. A batch is
+// pushed when it reaches the target or its oldest event reaches the wait, so
+// high rates give large objects and low rates give prompt ones.
+//
+// target_events() and max_wait_ns() are read lock-free by the workers;
+// on_collect() comes from the thread that owns the flush and on_push() from
+// the uploader once a batch is stored.
+class BatchController {
+public:
+    enum class Trigger : uint8_t { Size, Deadline, Force };
+
+    struct Snapshot {
+        bool adaptive = false;
+        double arrival_rate = 0;            // events/s
+        double bytes_per_event = 0;
+        double push_latency_ms = 0;         // smoothed mean
+        double push_latency_dev_ms = 0;     // smoothed mean deviation
+        uint64_t target_events = 0;
+        uint64_t target_bytes = 0;
+        uint64_t max_wait_ms = 0;
+        uint64_t last_batch_events = 0;
+        uint64_t last_batch_bytes = 0;
+        uint64_t batches = 0;
+        uint64_t failed_pushes = 0;
+        uint64_t by_size = 0;               // pushes triggered by each cause
+        uint64_t by_deadline = 0;
+        uint64_t by_force = 0;
+    };
+
+    explicit BatchController(const Config::BatchConfig& config)
+        : adaptive_(config.adaptive), min_bytes_(std::max<size_t>(config.min_bytes, 1)),
+          max_bytes_(std::max(config.max_bytes, min_bytes_)),
+          budget_ns_(static_cast<uint64_t>(std::max(config.latency_budget_ms, 0)) * 1'000'000),
+          bytes_per_event_(Config::BatchConfig::INITIAL_BYTES_PER_EVENT) {
+        update_max_events();
+        if (adaptive_) {
+            recompute();
+        } else {
+            target_events_.store(Config::WorkerConfig::LOG_THRESHOLD, std::memory_order_relaxed);
+            max_wait_ns_.store(Config::WorkerConfig::TIME_THRESHOLD_SECONDS * 1'000'000'000ULL,
+                               std::memory_order_relaxed);
+        }
+    }
+
+    size_t target_events() const { return target_events_.load(std::memory_order_relaxed); }
+    // Events that fill a max_bytes batch at the current size estimate.
+    size_t max_events() const { return max_events_.load(std::memory_order_relaxed); }
+    uint64_t max_wait_ns() const { return max_wait_ns_.load(std::memory_order_relaxed); }
+
+    // Called when a batch of `events` was taken from the bucket at `collect_ns`.
+    void on_collect(size_t events, uint64_t collect_ns) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (last_collect_ns_ != 0 && collect_ns > last_collect_ns_) {
+            double rate = events * 1e9 / (collect_ns - last_collect_ns_);
+            arrival_rate_ = have_rate_ ? ewma(arrival_rate_, rate) : rate;
+            have_rate_ = true;
+        }
+        last_collect_ns_ = collect_ns;
+    }
+
+    // Called once per batch with its size and how long it took from collection
+    // until it was stored (or given up on).
+    void on_push(size_t events, size_t bytes, uint64_t push_ns, bool ok, Trigger trigger) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        switch (trigger) {
+            case Trigger::Size: ++stats_.by_size; break;
+            case Trigger::Deadline: ++stats_.by_deadline; break;
+            case Trigger::Force: ++stats_.by_force; break;
+        }
+        if (!ok) {
+            ++stats_.failed_pushes;
+            return;
+        }
+        ++stats_.batches;
+        stats_.last_batch_events = events;
+        stats_.last_batch_bytes = bytes;
+        if (events > 0) bytes_per_event_ = ewma(bytes_per_event_, static_cast<double>(bytes) / events);
+        update_max_events();
+
+        double ms = push_ns / 1e6;
+        if (!have_latency_) {
+            push_ms_ = ms;
+            push_dev_ms_ = ms / 2;
+            have_latency_ = true;
+        } else {
+            push_dev_ms_ = ewma(push_dev_ms_, std::fabs(ms - push_ms_));
+            push_ms_ = ewma(push_ms_, ms);
+        }
+        if (adaptive_) recompute();
+    }
+
+    Snapshot snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Snapshot s = stats_;
+        s.adaptive = adaptive_;
+        s.arrival_rate = arrival_rate_;
+        s.bytes_per_event = bytes_per_event_;
+        s.push_latency_ms = push_ms_;
+        s.push_latency_dev_ms = push_dev_ms_;
+        s.target_events = target_events();
+        s.target_bytes = static_cast<uint64_t>(s.target_events * bytes_per_event_);
+        s.max_wait_ms = max_wait_ns() / 1'000'000;
+        return s;
+    }
+
+private:
+    static double ewma(double current, double sample) {
+        return current + Config::BatchConfig::EWMA_ALPHA * (sample - current);
+    }
+
+    void update_max_events() {
+        max_events_.store(std::max<size_t>(1, static_cast<size_t>(max_bytes_ / std::max(bytes_per_event_, 1.0))),
+                          std::memory_order_relaxed);
+    }
+
+    void recompute() {
+        double reserve_ns = (push_ms_ + Config::BatchConfig::PUSH_LATENCY_DEVIATIONS * push_dev_ms_) * 1e6;
+        double wait_ns = std::max(0.0, static_cast<double>(budget_ns_) - reserve_ns);
+        double bytes = std::clamp(arrival_rate_ * bytes_per_event_ * wait_ns / 1e9,
+                                  static_cast<double>(min_bytes_), static_cast<double>(max_bytes_));
+        size_t events = std::max<size_t>(1, static_cast<size_t>(bytes / std::max(bytes_per_event_, 1.0)));
+        target_events_.store(events, std::memory_order_relaxed);
+        max_wait_ns_.store(static_cast<uint64_t>(wait_ns), std::memory_order_relaxed);
+    }
+
+    const bool adaptive_;
+    const size_t min_bytes_;
+    const size_t max_bytes_;
+    const uint64_t budget_ns_;
+
+    std::atomic<size_t> target_events_{1};
+    std::atomic<uint64_t> max_wait_ns_{0};
+    std::atomic<size_t> max_events_{1};
+
+    mutable std::mutex mutex_;            // guards the estimates and stats_
+    Snapshot stats_;
+    double arrival_rate_ = 0;
+    double bytes_per_event_;
+    double push_ms_ = 0;
+    double push_dev_ms_ = 0;
+    bool have_rate_ = false;
+    bool have_latency_ = false;
+    uint64_t last_collect_ns_ = 0;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "event.hpp"
+
+// Binary capture of a RawEvent stream, used by the replay tool.
+//
+// Layout: a fixed header, then one record per event: a uint16_t length and
+// that many leading bytes of the RawEvent. Only the used part of the text
+// payload is stored; the reader zero-fills the rest. The header records the
+// RawEvent size and TEXT_SIZE so captures from an incompatible build are
+// rejected instead of misread.
+
+constexpr char CAPTURE_MAGIC[8] = {'R', 'T', 'S', 'A', 'C', 'A', 'P', '1'};
+constexpr uint32_t CAPTURE_VERSION = 6;   // 2: RawEvent::severity, 3: RawEvent::trace_id, 4: syslog fields, 5: USB strings,
+                                          // 6: 64-bit trace_id
+
+struct CaptureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t raw_event_size;
+    uint32_t text_size;
+    uint32_t reserved;
+    uint64_t created_realtime_ns;
+};
+
+// Number of leading bytes of `ev` that carry information.
+inline size_t capture_wire_size(const RawEvent& ev) {
+    size_t base = offsetof(RawEvent, syslog);   // all payloads share the union offset
+    switch (ev.type) {
+        case SYSLOG_LINE: return base + offsetof(SyslogPayload, line) + std::min<size_t>(ev.syslog.line_len, TEXT_SIZE);
+        case USB_EVENT: return base + offsetof(UsbPayload, strings) + std::min<size_t>(ev.usb.strings_len, USB_STRINGS_SIZE);
+        case FILE_DELETE: return base + offsetof(FilePayload, path) + std::min<size_t>(ev.file.path_len, TEXT_SIZE);
+        case FILE_ROLLUP:
+            return base + offsetof(FileRollupPayload, names) + std::min<size_t>(ev.rollup.names_len, TEXT_SIZE);
+        case SYSLOG_REPEAT:
+            return base + offsetof(SyslogRepeatPayload, templ) + std::min<size_t>(ev.repeat.templ_len, TEXT_SIZE);
+        case ADMISSION_REPORT: return base + sizeof(AdmissionPayload);
+        default: return sizeof(RawEvent);
+    }
+}
+
+class CaptureWriter {
+public:
+    explicit CaptureWriter(const std::string& path) {
+        file_ = fopen(path.c_str(), "wb");
+        if (!file_) throw std::runtime_error("Cannot create capture file: " + path + " err: " + strerror(errno));
+        setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+
+        CaptureHeader h{};
+        memcpy(h.magic, CAPTURE_MAGIC, sizeof(h.magic));
+        h.version = CAPTURE_VERSION;
+        h.raw_event_size = sizeof(RawEvent);
+        h.text_size = TEXT_SIZE;
+        h.created_realtime_ns = realtime_ns();
+        if (fwrite(&h, sizeof(h), 1, file_) != 1) {
+            fclose(file_);
+            throw std::runtime_error("Cannot write capture header");
+        }
+    }
+
+    ~CaptureWriter() {
+        if (file_) fclose(file_);
+    }
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    void write(const RawEvent& ev) {
+        uint16_t len = static_cast<uint16_t>(capture_wire_size(ev));
+        if (fwrite(&len, sizeof(len), 1, file_) != 1 || fwrite(&ev, len, 1, file_) != 1)
+            throw std::runtime_error("Short write to capture file");
+        ++count_;
+        bytes_ += sizeof(len) + len;
+    }
+
+    void flush() { fflush(file_); }
+    uint64_t count() const { return count_; }
+    uint64_t bytes() const { return bytes_ + sizeof(CaptureHeader); }
+
+private:
+    FILE* file_ = nullptr;
+    uint64_t count_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+class CaptureReader {
+public:
+    explicit CaptureReader(const std::string& path) {
+        file_ = fopen(path.c_str(), "rb");
+        if (!file_) throw std::runtime_error("Cannot open capture file: " + path + " err: " + strerror(errno));
+        setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+
+        if (fread(&header_, sizeof(header_), 1, file_) != 1 ||
+            memcmp(header_.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+            fclose(file_);
+            throw std::runtime_error("Not a capture file: " + path);
+        }
+        if (header_.version != CAPTURE_VERSION || header_.raw_event_size != sizeof(RawEvent) ||
+            header_.text_size != TEXT_SIZE) {
+            fclose(file_);
+            throw std::runtime_error("Capture file " + path + " was written by an incompatible build");
+        }
+        data_start_ = ftell(file_);
+    }
+
+    ~CaptureReader() {
+        if (file_) fclose(file_);
+    }
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    // Reads the next event; returns false at end of file. A truncated final
+    // record (e.g. from an interrupted recording) is treated as end of file.
+    bool next(RawEvent& ev) {
+        uint16_t len;
+        if (fread(&len, sizeof(len), 1, file_) != 1) return false;
+        if (len > sizeof(RawEvent)) throw std::runtime_error("Corrupt capture record");
+        memset(&ev, 0, sizeof(ev));
+        return fread(&ev, len, 1, file_) == 1;
+    }
+
+    void rewind() { fseek(file_, data_start_, SEEK_SET); }
+    const CaptureHeader& header() const { return header_; }
+
+private:
+    FILE* file_ = nullptr;
+    CaptureHeader header_{};
+    long data_start_ = 0;
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "cid.hpp"
+
+// CARv1 archives: a varint-prefixed dag-cbor header {"roots": [CID...],
+// "version": 1}, then one section per block: varint(length), the binary CID,
+// the block bytes. This is the format `ipfs dag export` writes and
+// `ipfs dag import` reads.
+namespace car {
+
+namespace detail {
+
+inline void append_cbor_head(std::vector<uint8_t>& out, uint8_t major, uint64_t v) {
+    major <<= 5;
+    if (v < 24) {
+        out.push_back(major | static_cast<uint8_t>(v));
+    } else if (v <= 0xff) {
+        out.push_back(major | 24);
+        out.push_back(static_cast<uint8_t>(v));
+    } else {
+        int width = v <= 0xffff ? 2 : v <= 0xffffffff ? 4 : 8;
+        out.push_back(major | (width == 2 ? 25 : width == 4 ? 26 : 27));
+        for (int shift = (width - 1) * 8; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(v >> shift));
+    }
+}
+
+inline void append_cbor_text(std::vector<uint8_t>& out, const char* text) {
+    append_cbor_head(out, 3, strlen(text));
+    out.insert(out.end(), text, text + strlen(text));
+}
+
+inline std::vector<uint8_t> encode_header(const std::vector<cid::Cid>& roots) {
+    std::vector<uint8_t> out;
+    append_cbor_head(out, 5, 2);   // keys in dag-cbor order: shorter first
+    append_cbor_text(out, "roots");
+    append_cbor_head(out, 4, roots.size());
+    for (const auto& r : roots) {
+        std::vector<uint8_t> bytes = r.bytes();
+        append_cbor_head(out, 6, 42);   // CID tag; bytes carry a leading 0x00
+        append_cbor_head(out, 2, bytes.size() + 1);
+        out.push_back(0);
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+    append_cbor_text(out, "version");
+    append_cbor_head(out, 0, 1);
+    return out;
+}
+
+// Just enough CBOR to read a CAR header.
+class CborReader {
+public:
+    CborReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    void head(uint8_t& major, uint64_t& v) {
+        uint8_t b = byte();
+        major = b >> 5;
+        uint8_t info = b & 31;
+        if (info < 24) v = info;
+        else if (info <= 27) {
+            v = 0;
+            for (int i = 0; i < (1 << (info - 24)); ++i) v = (v << 8) | byte();
+        } else throw std::runtime_error("Unsupported CBOR item in CAR header");
+    }
+
+    uint64_t expect(uint8_t want) {
+        uint8_t major;
+        uint64_t v;
+        head(major, v);
+        if (major != want) throw std::runtime_error("Unexpected CBOR type in CAR header");
+        return v;
+    }
+
+    std::string_view bytes(uint64_t n) {
+        if (n > size_ - pos_) throw std::runtime_error("Truncated CAR header");
+        std::string_view out(reinterpret_cast<const char*>(data_ + pos_), n);
+        pos_ += n;
+        return out;
+    }
+
+private:
+    uint8_t byte() {
+        if (pos_ >= size_) throw std::runtime_error("Truncated CAR header");
+        return data_[pos_++];
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+inline std::vector<cid::Cid> decode_header(const std::vector<uint8_t>& header) {
+    CborReader r(header.data(), header.size());
+    std::vector<cid::Cid> roots;
+    uint64_t version = 0;
+    for (uint64_t entries = r.expect(5); entries > 0; --entries) {
+        std::string_view key = r.bytes(r.expect(3));
+        if (key == "roots") {
+            for (uint64_t n = r.expect(4); n > 0; --n) {
+                if (r.expect(6) != 42) throw std::runtime_error("CAR root is not a CID");
+                std::string_view b = r.bytes(r.expect(2));
+                if (b.empty() || b[0] != 0) throw std::runtime_error("CAR root is not a CID");
+                size_t pos = 1;
+                roots.push_back(cid::Cid::from_bytes(reinterpret_cast<const uint8_t*>(b.data()), b.size(), pos));
+            }
+        } else if (key == "version") {
+            version = r.expect(0);
+        } else {
+            throw std::runtime_error("Unknown CAR header field");
+        }
+    }
+    if (version != 1) throw std::runtime_error("Only CARv1 is supported");
+    return roots;
+}
+
+inline void write_varint(FILE* f, uint64_t v) {
+    std::vector<uint8_t> buf;
+    cid::append_varint(buf, v);
+    if (fwrite(buf.data(), 1, buf.size(), f) != buf.size()) throw std::runtime_error("Short write to CAR file");
+}
+
+// Returns false at a clean end of file.
+inline bool read_varint(FILE* f, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(f);
+        if (c == EOF) {
+            if (shift == 0) return false;
+            throw std::runtime_error("Truncated CAR section");
+        }
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    throw std::runtime_error("Varint too long in CAR file");
+}
+
+} // namespace detail
+
+// Streams blocks into a CAR whose roots are only known at the end (the log
+// chain is discovered while it is exported). Sections go to `<path>.part`;
+// finish() writes the header to `path` and appends them, so the writer holds
+// nothing but the list of roots.
+class Writer {
+public:
+    explicit Writer(std::string path) : path_(std::move(path)), part_path_(path_ + ".part") {
+        part_ = fopen(part_path_.c_str(), "w+b");
+        if (!part_) throw std::runtime_error("Cannot create " + part_path_ + ": " + strerror(errno));
+        setvbuf(part_, nullptr, _IOFBF, 1 << 20);
+    }
+
+    ~Writer() {
+        if (part_) {
+            fclose(part_);
+            std::error_code ec;
+            std::filesystem::remove(part_path_, ec);
+        }
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    void add(const cid::Cid& c, const uint8_t* data, size_t size) {
+        std::vector<uint8_t> cid_bytes = c.bytes();
+        detail::write_varint(part_, cid_bytes.size() + size);
+        if (fwrite(cid_bytes.data(), 1, cid_bytes.size(), part_) != cid_bytes.size() ||
+            fwrite(data, 1, size, part_) != size)
+            throw std::runtime_error("Short write to " + part_path_);
+        ++blocks_;
+        bytes_ += size;
+    }
+
+    void finish(const std::vector<cid::Cid>& roots) {
+        if (fflush(part_) != 0) throw std::runtime_error("Short write to " + part_path_);
+        rewind(part_);
+
+        FILE* out = fopen(path_.c_str(), "wb");
+        if (!out) throw std::runtime_error("Cannot create " + path_ + ": " + strerror(errno));
+        std::vector<uint8_t> header = detail::encode_header(roots);
+        detail::write_varint(out, header.size());
+        bool ok = fwrite(header.data(), 1, header.size(), out) == header.size();
+        std::vector<char> buf(1 << 20);
+        size_t n;
+        while (ok && (n = fread(buf.data(), 1, buf.size(), part_)) > 0) ok = fwrite(buf.data(), 1, n, out) == n;
+        ok = fclose(out) == 0 && ok;
+        if (!ok) throw std::runtime_error("Short write to " + path_);
+    }
+
+    uint64_t blocks() const { return blocks_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    std::string path_;
+    std::string part_path_;
+    FILE* part_ = nullptr;
+    uint64_t blocks_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+// Reads a CAR one block at a time, checking every block against its CID.
+class Reader {
+public:
+    static constexpr uint64_t MAX_HEADER_SIZE = 64 << 20;   // about 1.7M roots
+
+    explicit Reader(const std::string& path) : path_(path) {
+        file_ = fopen(path.c_str(), "rb");
+        if (!file_) throw std::runtime_error("Cannot open " + path + ": " + strerror(errno));
+        setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+        uint64_t len;
+        if (!detail::read_varint(file_, len) || len > MAX_HEADER_SIZE) fail("Not a CAR file");
+        std::vector<uint8_t> header(len);
+        if (fread(header.data(), 1, len, file_) != len) fail("Truncated CAR header");
+        try {
+            roots_ = detail::decode_header(header);
+        } catch (const std::exception& e) {
+            fail(e.what());
+        }
+    }
+
+    ~Reader() {
+        if (file_) fclose(file_);
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    const std::vector<cid::Cid>& roots() const { return roots_; }
+
+    // Reads the next block into `c` and `data`; returns false at end of file.
+    // Throws on truncation or a block that does not match its CID.
+    bool next(cid::Cid& c, std::vector<uint8_t>& data) {
+        uint64_t len;
+        if (!detail::read_varint(file_, len)) return false;
+        std::vector<uint8_t> section(len);
+        if (fread(section.data(), 1, len, file_) != len) throw std::runtime_error("Truncated CAR section in " + path_);
+        size_t pos = 0;
+        c = cid::Cid::from_bytes(section.data(), section.size(), pos);
+        data.assign(section.begin() + pos, section.end());
+        if (!cid::verify_block(c, data.data(), data.size()))
+            throw std::runtime_error("Block " + c.to_string() + " in " + path_ + " does not match its CID");
+        return true;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& what) {
+        fclose(file_);
+        file_ = nullptr;
+        throw std::runtime_error(path_ + ": " + what);
+    }
+
+    std::string path_;
+    FILE* file_ = nullptr;
+    std::vector<cid::Cid> roots_;
+};
+
+} // namespace car
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <openssl/sha.h>
+
+// In-process IPFS content identifiers for files, matching what `ipfs add`
+// produces with its default importer: fixed 256 KiB chunks, a balanced DAG of
+// at most 174 links per node, sha2-256.
+//
+//   CIDv0: every node is a dag-pb UnixFS File node (leaves carry the data);
+//          printed as base58btc "Qm...". This is `ipfs add` with no flags.
+//   CIDv1: leaves are raw blocks, inner nodes dag-pb; printed as base32
+//          "bafy..." (or "bafk..." for a single raw block). This is
+//          `ipfs add --cid-version=1`, which implies --raw-leaves.
+namespace cid {
+
+constexpr size_t CHUNK_SIZE = 256 * 1024;
+constexpr size_t MAX_LINKS = 174;
+constexpr uint64_t CODEC_RAW = 0x55;
+constexpr uint64_t CODEC_DAG_PB = 0x70;
+constexpr uint8_t MH_SHA2_256 = 0x12;
+constexpr uint8_t UNIXFS_FILE = 2;
+
+template<typename Bytes>
+void append_varint(Bytes& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// Reads a varint at `pos`, advancing it; throws on truncation.
+inline uint64_t read_varint(const uint8_t* data, size_t size, size_t& pos) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= size) throw std::runtime_error("Truncated varint");
+        uint8_t b = data[pos++];
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    throw std::runtime_error("Varint too long");
+}
+
+inline std::string base58btc(const std::vector<uint8_t>& bytes) {
+    static constexpr char ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    size_t zeros = 0;
+    while (zeros < bytes.size() && bytes[zeros] == 0) ++zeros;
+    std::vector<uint8_t> digits;   // little-endian base 58
+    for (size_t i = zeros; i < bytes.size(); ++i) {
+        uint32_t carry = bytes[i];
+        for (auto& d : digits) {
+            carry += static_cast<uint32_t>(d) << 8;
+            d = carry % 58;
+            carry /= 58;
+        }
+        while (carry) {
+            digits.push_back(carry % 58);
+            carry /= 58;
+        }
+    }
+    std::string out(zeros, '1');
+    for (auto it = digits.rbegin(); it != digits.rend(); ++it) out += ALPHABET[*it];
+    return out;
+}
+
+inline std::string base32_lower(const std::vector<uint8_t>& bytes) {
+    static constexpr char ALPHABET[] = "abcdefghijklmnopqrstuvwxyz234567";
+    std::string out;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (uint8_t b : bytes) {
+        buffer = (buffer << 8) | b;
+        bits += 8;
+        while (bits >= 5) {
+            out += ALPHABET[(buffer >> (bits - 5)) & 31];
+            bits -= 5;
+        }
+    }
+    if (bits > 0) out += ALPHABET[(buffer << (5 - bits)) & 31];
+    return out;
+}
+
+inline std::vector<uint8_t> base58btc_decode(std::string_view text) {
+    static constexpr std::string_view ALPHABET = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    size_t zeros = 0;
+    while (zeros < text.size() && text[zeros] == '1') ++zeros;
+    std::vector<uint8_t> bytes;   // little-endian base 256
+    for (size_t i = zeros; i < text.size(); ++i) {
+        size_t digit = ALPHABET.find(text[i]);
+        if (digit == std::string_view::npos) throw std::runtime_error("Invalid base58 character");
+        uint32_t carry = static_cast<uint32_t>(digit);
+        for (auto& b : bytes) {
+            carry += static_cast<uint32_t>(b) * 58;
+            b = carry & 0xff;
+            carry >>= 8;
+        }
+        while (carry) {
+            bytes.push_back(carry & 0xff);
+            carry >>= 8;
+        }
+    }
+    std::vector<uint8_t> out(zeros, 0);
+    out.insert(out.end(), bytes.rbegin(), bytes.rend());
+    return out;
+}
+
+inline std::vector<uint8_t> base32_lower_decode(std::string_view text) {
+    std::vector<uint8_t> out;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char ch : text) {
+        int v = ch >= 'a' && ch <= 'z' ? ch - 'a' : ch >= '2' && ch <= '7' ? ch - '2' + 26 : -1;
+        if (v < 0) throw std::runtime_error("Invalid base32 character");
+        buffer = (buffer << 5) | static_cast<uint32_t>(v);
+        bits += 5;
+        if (bits >= 8) {
+            out.push_back(static_cast<uint8_t>(buffer >> (bits - 8)));
+            bits -= 8;
+        }
+    }
+    return out;
+}
+
+struct Cid {
+    uint8_t version = 0;
+    uint64_t codec = CODEC_DAG_PB;
+    std::array<uint8_t, SHA256_DIGEST_LENGTH> digest{};
+
+    // Binary form, as embedded in dag-pb links and CAR files.
+    template<typename Bytes>
+    void append_to(Bytes& out) const {
+        if (version == 1) {
+            out.push_back(1);
+            append_varint(out, codec);
+        }
+        out.push_back(MH_SHA2_256);
+        out.push_back(static_cast<uint8_t>(digest.size()));
+        out.insert(out.end(), digest.begin(), digest.end());
+    }
+
+    std::vector<uint8_t> bytes() const {
+        std::vector<uint8_t> out;
+        append_to(out);
+        return out;
+    }
+
+    std::string to_string() const {
+        return version == 0 ? base58btc(bytes()) : "b" + base32_lower(bytes());
+    }
+
+    // CIDv1 spelling of the same block, as `ipfs block put` reports it.
+    std::string to_v1_string() const {
+        Cid v1 = *this;
+        v1.version = 1;
+        return v1.to_string();
+    }
+
+    // Parses the binary form at `pos` (advancing it). Only sha2-256 is accepted.
+    static Cid from_bytes(const uint8_t* data, size_t size, size_t& pos) {
+        Cid c;
+        if (size - pos >= 2 && data[pos] == MH_SHA2_256 && data[pos + 1] == SHA256_DIGEST_LENGTH) {
+            c.version = 0;
+        } else {
+            if (read_varint(data, size, pos) != 1) throw std::runtime_error("Unsupported CID version");
+            c.version = 1;
+            c.codec = read_varint(data, size, pos);
+        }
+        if (size - pos < 2 + c.digest.size() || data[pos] != MH_SHA2_256 || data[pos + 1] != SHA256_DIGEST_LENGTH)
+            throw std::runtime_error("Unsupported multihash in CID");
+        memcpy(c.digest.data(), data + pos + 2, c.digest.size());
+        pos += 2 + c.digest.size();
+        return c;
+    }
+
+    // Parses "Qm..." (v0) or "b..." (v1, base32); throws on anything else.
+    static Cid from_string(std::string_view text) {
+        std::vector<uint8_t> bytes;
+        if (text.size() == 46 && text.substr(0, 2) == "Qm") bytes = base58btc_decode(text);
+        else if (!text.empty() && text[0] == 'b') bytes = base32_lower_decode(text.substr(1));
+        else throw std::runtime_error("Unsupported CID: " + std::string(text));
+        size_t pos = 0;
+        Cid c = from_bytes(bytes.data(), bytes.size(), pos);
+        if (pos != bytes.size()) throw std::runtime_error("Trailing bytes in CID: " + std::string(text));
+        return c;
+    }
+
+    bool operator==(const Cid& o) const { return version == o.version && codec == o.codec && digest == o.digest; }
+    bool operator!=(const Cid& o) const { return !(*this == o); }
+};
+
+inline Cid hash_block(uint8_t version, uint64_t codec, const uint8_t* data, size_t size) {
+    Cid c;
+    c.version = version;
+    c.codec = codec;
+    SHA256(data, size, c.digest.data());
+    return c;
+}
+
+struct Block {
+    Cid cid;
+    std::vector<uint8_t> data;
+};
+
+namespace detail {
+
+template<typename Bytes>
+void append_bytes_field(Bytes& out, uint8_t key, const uint8_t* data, size_t size) {
+    out.push_back(key);
+    append_varint(out, size);
+    out.insert(out.end(), data, data + size);
+}
+
+template<typename Bytes>
+void append_varint_field(Bytes& out, uint8_t key, uint64_t v) {
+    out.push_back(key);
+    append_varint(out, v);
+}
+
+// UnixFS Data message for a File node: Type, Data, filesize, blocksizes.
+template<typename Bytes, typename Sizes>
+void unixfs_file(Bytes& out, const uint8_t* data, size_t size, uint64_t filesize, const Sizes& blocksizes) {
+    out.clear();
+    append_varint_field(out, 0x08, UNIXFS_FILE);
+    if (size > 0) append_bytes_field(out, 0x12, data, size);
+    append_varint_field(out, 0x18, filesize);
+    for (uint64_t b : blocksizes) append_varint_field(out, 0x20, b);
+}
+
+struct Link {
+    Cid cid;
+    uint64_t tsize;      // serialized size of the linked subtree
+    uint64_t filesize;   // file bytes below the link
+};
+
+// dag-pb PBNode: Links (field 2, each {Hash, Name = "", Tsize}) then Data (field 1).
+template<typename Bytes, typename Links>
+void dag_pb_node(Bytes& out, const Links& links, const Bytes& unixfs) {
+    out.clear();
+    Bytes link(out.get_allocator());
+    for (const auto& l : links) {
+        link.clear();
+        link.push_back(0x0a);   // Hash
+        size_t len_at = link.size();
+        link.push_back(0);      // a CID is < 128 bytes: one-byte length
+        l.cid.append_to(link);
+        link[len_at] = static_cast<uint8_t>(link.size() - len_at - 1);
+        append_bytes_field(link, 0x12, nullptr, 0);
+        append_varint_field(link, 0x18, l.tsize);
+        append_bytes_field(out, 0x12, link.data(), link.size());
+    }
+    append_bytes_field(out, 0x0a, unixfs.data(), unixfs.size());
+}
+
+// Calls `on_field(number, data, size)` for every length-delimited field of a
+// protobuf message and skips varint fields; throws on anything else.
+template<typename F>
+void for_each_bytes_field(const uint8_t* data, size_t size, F&& on_field) {
+    size_t pos = 0;
+    while (pos < size) {
+        uint64_t key = read_varint(data, size, pos);
+        if ((key & 7) == 0) {
+            read_varint(data, size, pos);
+        } else if ((key & 7) == 2) {
+            uint64_t len = read_varint(data, size, pos);
+            if (len > size - pos) throw std::runtime_error("Truncated protobuf field");
+            on_field(key >> 3, data + pos, static_cast<size_t>(len));
+            pos += len;
+        } else {
+            throw std::runtime_error("Unsupported protobuf wire type");
+        }
+    }
+}
+
+} // namespace detail
+
+// True if `data` hashes to `c`.
+inline bool verify_block(const Cid& c, const uint8_t* data, size_t size) {
+    return hash_block(c.version, c.codec, data, size).digest == c.digest;
+}
+
+// Children of a block in link order: the Hash of every dag-pb link; raw
+// blocks have none.
+inline std::vector<Cid> block_links(const Cid& c, const uint8_t* data, size_t size) {
+    std::vector<Cid> links;
+    if (c.codec != CODEC_DAG_PB) return links;
+    detail::for_each_bytes_field(data, size, [&](uint64_t field, const uint8_t* link, size_t link_size) {
+        if (field != 2) return;
+        detail::for_each_bytes_field(link, link_size, [&](uint64_t f, const uint8_t* hash, size_t hash_size) {
+            size_t pos = 0;
+            if (f == 1) links.push_back(Cid::from_bytes(hash, hash_size, pos));
+        });
+    });
+    return links;
+}
+
+// File bytes held directly by a block: the whole of a raw block, or the
+// UnixFS Data of a dag-pb node (empty for inner nodes).
+inline std::string_view block_file_data(const Cid& c, const uint8_t* data, size_t size) {
+    if (c.codec == CODEC_RAW) return {reinterpret_cast<const char*>(data), size};
+    std::string_view out;
+    detail::for_each_bytes_field(data, size, [&](uint64_t field, const uint8_t* unixfs, size_t unixfs_size) {
+        if (field != 1) return;
+        detail::for_each_bytes_field(unixfs, unixfs_size, [&](uint64_t f, const uint8_t* bytes, size_t n) {
+            if (f == 2) out = {reinterpret_cast<const char*>(bytes), n};
+        });
+    });
+    return out;
+}
+
+namespace detail {
+
+// file_dag() with node buffers of type Bytes (std::vector or std::pmr::vector
+// with `alloc`). Blocks are only collected for std::vector.
+template<typename Bytes>
+Cid build_file_dag(std::string_view content, int version, std::vector<Block>* blocks,
+                   const typename Bytes::allocator_type& alloc) {
+    using Alloc = typename Bytes::allocator_type;
+    using Links = std::vector<Link, typename std::allocator_traits<Alloc>::template rebind_alloc<Link>>;
+    using Sizes = std::vector<uint64_t, typename std::allocator_traits<Alloc>::template rebind_alloc<uint64_t>>;
+    const auto* data = reinterpret_cast<const uint8_t*>(content.data());
+    const uint8_t v = version == 1 ? 1 : 0;
+    Bytes node(alloc), unixfs(alloc);
+    auto emit = [&](uint64_t codec, const uint8_t* bytes, size_t size, uint64_t tsize_below, uint64_t filesize) {
+        Link l{hash_block(v, codec, bytes, size), size + tsize_below, filesize};
+        if constexpr (std::is_same_v<Bytes, std::vector<uint8_t>>)
+            if (blocks) blocks->push_back(Block{l.cid, std::vector<uint8_t>(bytes, bytes + size)});
+        return l;
+    };
+
+    const Links no_links(alloc);
+    Links level(alloc), parents(alloc), children(alloc);
+    Sizes blocksizes(alloc);
+    size_t offset = 0;
+    do {
+        size_t n = std::min(CHUNK_SIZE, content.size() - offset);
+        if (v == 1) {
+            level.push_back(emit(CODEC_RAW, data + offset, n, 0, n));
+        } else {
+            unixfs_file(unixfs, data + offset, n, n, blocksizes);
+            dag_pb_node(node, no_links, unixfs);
+            level.push_back(emit(CODEC_DAG_PB, node.data(), node.size(), 0, n));
+        }
+        offset += n;
+    } while (offset < content.size());
+
+    // Balanced layout: group each level into parents of up to MAX_LINKS.
+    while (level.size() > 1) {
+        parents.clear();
+        for (size_t i = 0; i < level.size(); i += MAX_LINKS) {
+            children.assign(level.begin() + i, level.begin() + std::min(level.size(), i + MAX_LINKS));
+            uint64_t filesize = 0, tsize = 0;
+            blocksizes.clear();
+            for (const auto& c : children) {
+                filesize += c.filesize;
+                tsize += c.tsize;
+                blocksizes.push_back(c.filesize);
+            }
+            unixfs_file(unixfs, nullptr, 0, filesize, blocksizes);
+            dag_pb_node(node, children, unixfs);
+            parents.push_back(emit(CODEC_DAG_PB, node.data(), node.size(), tsize, filesize));
+        }
+        level.swap(parents);
+    }
+    return level.front().cid;
+}
+
+} // namespace detail
+
+// Builds the DAG `ipfs add` would build for `content` and returns its root.
+// With `blocks` non-null every block is appended to it, children before
+// parents (so the root is last).
+inline Cid file_dag(std::string_view content, int version, std::vector<Block>* blocks = nullptr) {
+    return detail::build_file_dag<std::vector<uint8_t>>(content, version, blocks, {});
+}
+
+// The root file_dag() computes, with every temporary node drawn from `scratch`.
+inline Cid file_root(std::string_view content, int version, std::pmr::memory_resource* scratch) {
+    return detail::build_file_dag<std::pmr::vector<uint8_t>>(content, version, nullptr, scratch);
+}
+
+inline std::string read_file_bytes(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot read " + path);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // namespace cid
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include "config.hpp"
+
+// Aggregates delete/move-out events per watched directory. The first
+// ROLLUP_BURST_THRESHOLD events of a window pass through individually; past
+// that the directory is "bursting" and further events are only counted, then
+// reported as one summary when the window closes. A bursting directory stays in
+// rollup mode until a full window passes without deletions.
+class DeleteRollup {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Summary {
+        std::string dir;
+        uint64_t count = 0;          // events folded into this summary
+        uint64_t deleted = 0;        // of which IN_DELETE
+        uint64_t moved = 0;          // of which IN_MOVED_FROM
+        std::vector<std::string> first_names;
+        std::vector<std::string> last_names;
+        Clock::duration span{};      // first to last suppressed event
+    };
+
+    DeleteRollup(std::chrono::milliseconds window = std::chrono::milliseconds(Config::FileMonitorConfig::ROLLUP_WINDOW_MS),
+                 size_t burst_threshold = Config::FileMonitorConfig::ROLLUP_BURST_THRESHOLD,
+                 size_t sample_names = Config::FileMonitorConfig::ROLLUP_SAMPLE_NAMES)
+        : window_(window), threshold_(burst_threshold), samples_(sample_names) {}
+
+    // Records one event. Returns true if the caller should emit it as-is,
+    // false if it was folded into the directory's pending summary.
+    bool add(int wd, const std::string& dir, const char* name, bool moved, Clock::time_point now) {
+        auto [it, inserted] = windows_.try_emplace(wd);
+        Window& w = it->second;
+        if (inserted) {
+            w.dir = dir;
+            w.start = now;
+            w.last_names.assign(samples_, std::string());
+        }
+
+        ++w.seen;
+        if (!w.bursting && w.seen <= threshold_) return true;
+
+        w.bursting = true;
+        if (w.count == 0) w.first_ts = now;
+        w.last_ts = now;
+        ++w.count;
+        ++(moved ? w.moved : w.deleted);
+
+        if (w.first_names.size() < samples_) {
+            w.first_names.emplace_back(name);
+        } else if (samples_ > 0) {
+            w.last_names[w.last_pos % samples_].assign(name);
+            ++w.last_pos;
+        }
+        return false;
+    }
+
+    // Closes every window older than the rollup window and hands a summary for
+    // each directory with suppressed events to `emit`.
+    template<typename Emit>
+    void flush_expired(Clock::time_point now, Emit&& emit) {
+        for (auto it = windows_.begin(); it != windows_.end();) {
+            Window& w = it->second;
+            if (now - w.start < window_) {
+                ++it;
+                continue;
+            }
+            if (w.count == 0) {
+                it = windows_.erase(it);
+                continue;
+            }
+            emit(take_summary(w));
+            w.start = now;
+            w.seen = 0;
+            ++it;
+        }
+    }
+
+    // Emits summaries for every directory regardless of window age (shutdown).
+    template<typename Emit>
+    void flush_all(Emit&& emit) {
+        for (auto& [wd, w] : windows_) {
+            if (w.count > 0) emit(take_summary(w));
+        }
+        windows_.clear();
+    }
+
+    // Milliseconds until the oldest open window closes, capped at `cap`.
+    int next_deadline_ms(Clock::time_point now, int cap) const {
+        auto best = std::chrono::milliseconds(cap);
+        for (const auto& [wd, w] : windows_) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(w.start + window_ - now);
+            best = std::min(best, std::max(left, std::chrono::milliseconds(0)));
+        }
+        return static_cast<int>(best.count());
+    }
+
+private:
+    struct Window {
+        std::string dir;
+        Clock::time_point start;
+        Clock::time_point first_ts;
+        Clock::time_point last_ts;
+        uint64_t seen = 0;
+        uint64_t count = 0;
+        uint64_t deleted = 0;
+        uint64_t moved = 0;
+        bool bursting = false;
+        std::vector<std::string> first_names;
+        std::vector<std::string> last_names;
+        size_t last_pos = 0;
+    };
+
+    Summary take_summary(Window& w) {
+        Summary s;
+        s.dir = w.dir;
+        s.count = w.count;
+        s.deleted = w.deleted;
+        s.moved = w.moved;
+        s.span = w.last_ts - w.first_ts;
+        s.first_names = std::move(w.first_names);
+
+        // Unroll the ring so the newest name comes last.
+        size_t filled = std::min(w.last_pos, samples_);
+        for (size_t i = 0; i < filled; ++i) {
+            size_t idx = (w.last_pos - filled + i) % samples_;
+            s.last_names.push_back(w.last_names[idx]);
+        }
+
+        w.count = w.deleted = w.moved = 0;
+        w.first_names.clear();
+        w.last_names.assign(samples_, std::string());
+        w.last_pos = 0;
+        return s;
+    }
+
+    std::chrono::milliseconds window_;
+    size_t threshold_;
+    size_t samples_;
+    std::unordered_map<int, Window> windows_;
+};
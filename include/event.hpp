@@ -0,0 +1,287 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string_view>
+#include "mmap_queue.hpp"
+#include "timestamp.hpp"
+#include "config.hpp"
+
+constexpr size_t QUEUE_SIZE = Config::QueueConfig::DEFAULT_QUEUE_SIZE;
+constexpr size_t TEXT_SIZE = Config::QueueConfig::DEFAULT_TEXT_SIZE;
+constexpr size_t MAX_MATCHED_PATTERNS = 8;
+constexpr size_t MAX_PATTERNS = UINT16_MAX;   // pattern ids travel as uint16_t
+constexpr size_t USB_DEVNODE_SIZE = 64;
+constexpr size_t USB_STRINGS_SIZE = 192;
+
+enum EventType : uint8_t {
+    SYSLOG_LINE = 0,
+    USB_EVENT = 1,
+    FILE_DELETE = 2,
+    FILE_ROLLUP = 3,
+    SYSLOG_REPEAT = 4,
+    ADMISSION_REPORT = 5
+};
+
+// Ordered: a higher value is more urgent.
+enum Severity : uint8_t {
+    SEVERITY_LOW = 0,
+    SEVERITY_NORMAL = 1,
+    SEVERITY_HIGH = 2,
+    SEVERITY_CRITICAL = 3
+};
+
+enum EventSource : uint8_t {
+    SOURCE_SYSLOG = 0,
+    SOURCE_USB = 1,
+    SOURCE_FILE = 2
+};
+
+enum UsbAction : uint8_t {
+    USB_ACTION_OTHER = 0,
+    USB_ACTION_ADD,
+    USB_ACTION_REMOVE,
+    USB_ACTION_CHANGE,
+    USB_ACTION_MOVE,
+    USB_ACTION_BIND,
+    USB_ACTION_UNBIND,
+    USB_ACTION_ONLINE,
+    USB_ACTION_OFFLINE
+};
+
+// A field inside a payload's text buffer; len 0 when absent.
+struct TextSpan {
+    uint16_t off;
+    uint16_t len;
+};
+
+// Matched syslog line. `pattern_count` is the number of distinct patterns that
+// hit; only the first MAX_MATCHED_PATTERNS ids are kept. The header fields
+// parsed by the agent (syslog_header.hpp) are spans of `line`.
+struct SyslogPayload {
+    uint64_t offset;                          // byte offset of the line in the syslog file
+    uint16_t pattern_count;
+    uint16_t pattern_ids[MAX_MATCHED_PATTERNS];
+    uint16_t line_len;
+    uint8_t has_priority;
+    uint8_t priority;                         // syslog PRI: facility * 8 + severity
+    TextSpan timestamp;
+    TextSpan host;
+    TextSpan app;
+    TextSpan pid;
+    TextSpan message;
+    char line[TEXT_SIZE];
+};
+
+// USB device event. The sysfs serial, manufacturer and product strings are
+// spans of `strings` (usb_device_cache.hpp).
+struct UsbPayload {
+    uint8_t action;                           // UsbAction
+    uint8_t has_ids;                          // vendor/product were readable
+    uint8_t cached;                           // attributes remembered from an earlier event
+    uint16_t vendor;
+    uint16_t product;
+    TextSpan serial;
+    TextSpan manufacturer;
+    TextSpan product_name;
+    uint16_t strings_len;
+    char devnode[USB_DEVNODE_SIZE];
+    char strings[USB_STRINGS_SIZE];
+};
+
+// Deleted or moved-out file. `path` holds "<dir>/<name>"; the name starts at
+// path + name_offset.
+struct FilePayload {
+    uint32_t mask;                            // inotify mask (IN_DELETE / IN_MOVED_FROM)
+    int32_t wd;
+    uint16_t name_offset;
+    uint16_t path_len;
+    char path[TEXT_SIZE];
+};
+
+// Directory rollup summary. `names` holds the directory followed by
+// first_count + last_count file names, each NUL-terminated.
+struct FileRollupPayload {
+    uint32_t count;
+    uint32_t deleted;
+    uint32_t moved;
+    uint32_t span_ms;
+    uint8_t first_count;
+    uint8_t last_count;
+    uint16_t names_len;
+    char names[TEXT_SIZE];
+};
+
+// Summary of matched syslog lines suppressed as repeats of `templ` (the line
+// with numbers, hex and addresses masked as '#') during one dedup window.
+struct SyslogRepeatPayload {
+    uint64_t last_offset;                     // byte offset of the last repeat
+    uint32_t count;
+    uint32_t span_ms;                         // first to last repeat
+    uint16_t pattern_count;
+    uint16_t pattern_ids[MAX_MATCHED_PATTERNS];
+    uint16_t templ_len;
+    char templ[TEXT_SIZE];
+};
+
+// Admission accounting for one source over one report interval: how many
+// events were queued within the rate limit, queued as samples of the excess,
+// or shed (and why). Only sent for intervals in which something was shed.
+struct AdmissionPayload {
+    uint8_t source;                           // EventSource
+    uint32_t interval_ms;
+    uint64_t admitted;
+    uint64_t sampled;
+    uint64_t dropped_rate;                    // over the token bucket, not sampled
+    uint64_t dropped_quota;                   // queue above the source's share
+    uint64_t dropped_full;                    // no free slot found
+    uint32_t queue_depth;                     // occupancy when the report was built
+};
+
+struct RawEvent {
+    uint8_t type; // EventType
+    uint8_t severity; // Severity
+    uint64_t trace_id;                        // non-zero when sampled for tracing (trace.hpp)
+    uint64_t event_id;
+    uint64_t capture_realtime_ns;             // CLOCK_REALTIME when the agent saw the event
+    uint64_t capture_monotonic_ns;            // CLOCK_MONOTONIC at the same point, for latency
+    union {
+        SyslogPayload syslog;
+        UsbPayload usb;
+        FilePayload file;
+        FileRollupPayload rollup;
+        SyslogRepeatPayload repeat;
+        AdmissionPayload admission;
+    };
+};
+using QueueType = MmapQueue<RawEvent, QUEUE_SIZE>;
+
+inline void stamp_capture(RawEvent& ev) {
+    ev.capture_realtime_ns = realtime_ns();
+    ev.capture_monotonic_ns = monotonic_ns();
+}
+
+// Copies at most cap - 1 bytes and NUL-terminates; returns the copied length.
+inline uint16_t copy_field(char* dst, size_t cap, const char* src, size_t len) {
+    if (len >= cap) len = cap - 1;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+    return static_cast<uint16_t>(len);
+}
+
+inline uint16_t copy_field(char* dst, size_t cap, const char* src) {
+    return copy_field(dst, cap, src, strlen(src));
+}
+
+inline UsbAction usb_action_from_string(const char* action) {
+    if (!action) return USB_ACTION_OTHER;
+    if (strcmp(action, "add") == 0) return USB_ACTION_ADD;
+    if (strcmp(action, "remove") == 0) return USB_ACTION_REMOVE;
+    if (strcmp(action, "change") == 0) return USB_ACTION_CHANGE;
+    if (strcmp(action, "move") == 0) return USB_ACTION_MOVE;
+    if (strcmp(action, "bind") == 0) return USB_ACTION_BIND;
+    if (strcmp(action, "unbind") == 0) return USB_ACTION_UNBIND;
+    if (strcmp(action, "online") == 0) return USB_ACTION_ONLINE;
+    if (strcmp(action, "offline") == 0) return USB_ACTION_OFFLINE;
+    return USB_ACTION_OTHER;
+}
+
+inline const char* usb_action_name(uint8_t action) {
+    switch (action) {
+        case USB_ACTION_ADD: return "add";
+        case USB_ACTION_REMOVE: return "remove";
+        case USB_ACTION_CHANGE: return "change";
+        case USB_ACTION_MOVE: return "move";
+        case USB_ACTION_BIND: return "bind";
+        case USB_ACTION_UNBIND: return "unbind";
+        case USB_ACTION_ONLINE: return "online";
+        case USB_ACTION_OFFLINE: return "offline";
+        default: return "other";
+    }
+}
+
+inline const char* event_type_name(uint8_t type) {
+    switch (type) {
+        case SYSLOG_LINE: return "SYSLOG";
+        case USB_EVENT: return "USB";
+        case FILE_DELETE: return "FILE";
+        case FILE_ROLLUP: return "FILE_ROLLUP";
+        case SYSLOG_REPEAT: return "SYSLOG_REPEAT";
+        case ADMISSION_REPORT: return "ADMISSION";
+        default: return "SYSTEM";
+    }
+}
+
+inline const char* severity_name(uint8_t severity) {
+    switch (severity) {
+        case SEVERITY_LOW: return "low";
+        case SEVERITY_NORMAL: return "normal";
+        case SEVERITY_HIGH: return "high";
+        case SEVERITY_CRITICAL: return "critical";
+        default: return "unknown";
+    }
+}
+
+// Returns false for an unknown name.
+inline bool severity_from_string(std::string_view name, uint8_t& out) {
+    if (name == "low") out = SEVERITY_LOW;
+    else if (name == "normal") out = SEVERITY_NORMAL;
+    else if (name == "high") out = SEVERITY_HIGH;
+    else if (name == "critical") out = SEVERITY_CRITICAL;
+    else return false;
+    return true;
+}
+
+inline const char* event_source_name(uint8_t source) {
+    switch (source) {
+        case SOURCE_SYSLOG: return "syslog";
+        case SOURCE_USB: return "usb";
+        case SOURCE_FILE: return "file";
+        default: return "unknown";
+    }
+}
+
+// Returns false for an unknown name.
+inline bool event_source_from_string(std::string_view name, uint8_t& out) {
+    if (name == "syslog") out = SOURCE_SYSLOG;
+    else if (name == "usb") out = SOURCE_USB;
+    else if (name == "file") out = SOURCE_FILE;
+    else return false;
+    return true;
+}
+
+// The source that produced an event; an admission report belongs to the
+// source it accounts for.
+inline uint8_t event_source(const RawEvent& ev) {
+    switch (ev.type) {
+        case USB_EVENT: return SOURCE_USB;
+        case FILE_DELETE:
+        case FILE_ROLLUP: return SOURCE_FILE;
+        case ADMISSION_REPORT:
+            return ev.admission.source <= SOURCE_FILE ? ev.admission.source : static_cast<uint8_t>(SOURCE_SYSLOG);
+        default: return SOURCE_SYSLOG;
+    }
+}
+
+// Parses a sysfs hex id such as "046d"; returns false if absent or malformed.
+inline bool parse_usb_id(const char* s, uint16_t& out) {
+    if (!s || !*s) return false;
+    char* end = nullptr;
+    unsigned long v = strtoul(s, &end, 16);
+    if (*end != '\0' || v > 0xffff) return false;
+    out = static_cast<uint16_t>(v);
+    return true;
+}
+
+// Formats ids as "046d:c52b" into `buf`; the logger only understands "{}".
+inline std::string_view format_usb_ids(char (&buf)[10], uint16_t vendor, uint16_t product) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    for (int i = 0; i < 4; ++i) {
+        buf[3 - i] = HEX[(vendor >> (4 * i)) & 0xf];
+        buf[8 - i] = HEX[(product >> (4 * i)) & 0xf];
+    }
+    buf[4] = ':';
+    buf[9] = '\0';
+    return std::string_view(buf, 9);
+}
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <sys/inotify.h>
+#include "event.hpp"
+#include "json_writer.hpp"
+#include "timestamp.hpp"
+
+// An event as held by the reader until its batch is sealed.
+struct LogRecord {
+    RawEvent ev;
+    uint64_t dequeued_monotonic_ns;
+    const std::string* agent = nullptr;   // source agent when the reader drains several (queue_segments.hpp)
+};
+
+enum class BatchFormat {
+    JSON,    // {"timestamp", "logs": [<event JSON as string>...], "prev_cid"}
+    NDJSON   // header line {"timestamp", "prev_cid", "count"}, then one event object per line
+};
+
+inline BatchFormat batch_format_from_string(const std::string& name) {
+    return name == "ndjson" ? BatchFormat::NDJSON : BatchFormat::JSON;
+}
+
+// Walks the NUL-separated names of a rollup payload: the directory first, then
+// the first and last sampled file names.
+template<typename Fn>
+inline void for_each_rollup_name(const FileRollupPayload& r, Fn&& fn) {
+    size_t pos = 0;
+    size_t total = 1 + r.first_count + r.last_count;
+    for (size_t i = 0; i < total && pos < r.names_len; ++i) {
+        const char* name = r.names + pos;
+        fn(i, name);
+        pos += strlen(name) + 1;
+    }
+}
+
+inline void append_hex16(std::string& out, uint16_t v) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    char buf[4] = {HEX[(v >> 12) & 0xf], HEX[(v >> 8) & 0xf], HEX[(v >> 4) & 0xf], HEX[v & 0xf]};
+    out.append(buf, sizeof(buf));
+}
+
+// Appends the human-readable message for an event (unescaped).
+inline void append_event_message(std::string& out, const RawEvent& ev) {
+    switch (ev.type) {
+        case SYSLOG_LINE:
+            out.append(ev.syslog.line, ev.syslog.line_len);
+            break;
+        case USB_EVENT: {
+            const auto& u = ev.usb;
+            auto span = [&u](TextSpan t) { return std::string_view(u.strings + t.off, t.len); };
+            out += "USB device ";
+            out += usb_action_name(u.action);
+            if (u.has_ids) {
+                out += " (Vendor: ";
+                append_hex16(out, u.vendor);
+                out += ", Product: ";
+                append_hex16(out, u.product);
+                out += ')';
+            }
+            if (u.manufacturer.len || u.product_name.len) {
+                out += ' ';
+                out += span(u.manufacturer);
+                if (u.manufacturer.len && u.product_name.len) out += ' ';
+                out += span(u.product_name);
+            }
+            if (u.devnode[0]) {
+                out += " at ";
+                out += u.devnode;
+            }
+            break;
+        }
+        case FILE_DELETE:
+            out += ev.file.mask & IN_DELETE ? "Deleted file: " : "Moved out file: ";
+            out.append(ev.file.path, ev.file.path_len);
+            break;
+        case FILE_ROLLUP: {
+            const auto& r = ev.rollup;
+            out += "Deleted ";
+            out += std::to_string(r.deleted);
+            out += ", moved out ";
+            out += std::to_string(r.moved);
+            out += " files in ";
+            for_each_rollup_name(r, [&](size_t i, const char* name) {
+                if (i == 0) {
+                    out += name;
+                    out += " over ";
+                    out += std::to_string(r.span_ms);
+                    out += " ms";
+                    return;
+                }
+                out += i == 1 ? " (" : i == 1u + r.first_count ? " ... " : ", ";
+                out += name;
+            });
+            if (r.first_count + r.last_count > 0) out += ')';
+            break;
+        }
+        case SYSLOG_REPEAT:
+            out += "Repeated ";
+            out += std::to_string(ev.repeat.count);
+            out += " times in ";
+            out += std::to_string(ev.repeat.span_ms);
+            out += " ms: ";
+            out.append(ev.repeat.templ, ev.repeat.templ_len);
+            break;
+        case ADMISSION_REPORT: {
+            const auto& a = ev.admission;
+            out += "Admission ";
+            out += event_source_name(a.source);
+            out += " over ";
+            out += std::to_string(a.interval_ms);
+            out += " ms: admitted ";
+            out += std::to_string(a.admitted);
+            out += ", sampled ";
+            out += std::to_string(a.sampled);
+            out += ", dropped ";
+            out += std::to_string(a.dropped_rate + a.dropped_quota + a.dropped_full);
+            out += " (rate ";
+            out += std::to_string(a.dropped_rate);
+            out += ", quota ";
+            out += std::to_string(a.dropped_quota);
+            out += ", full ";
+            out += std::to_string(a.dropped_full);
+            out += ')';
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+inline void write_pattern_fields(JsonWriter& w, const uint16_t* ids, uint16_t count,
+                                 const std::vector<std::string>& pattern_names) {
+    size_t kept = std::min<size_t>(count, MAX_MATCHED_PATTERNS);
+    w.key("pattern_ids");
+    w.begin_array();
+    for (size_t i = 0; i < kept; ++i) w.value(ids[i]);
+    w.end_array();
+    w.key("patterns");
+    w.begin_array();
+    for (size_t i = 0; i < kept; ++i) {
+        if (ids[i] < pattern_names.size()) w.value(pattern_names[ids[i]]);
+    }
+    w.end_array();
+}
+
+// Writes the type-specific fields of an event so consumers can filter without
+// re-parsing `message`.
+inline void write_event_fields(JsonWriter& w, const RawEvent& ev, const std::vector<std::string>& pattern_names) {
+    switch (ev.type) {
+        case SYSLOG_LINE: {
+            const auto& s = ev.syslog;
+            w.field("offset", s.offset);
+            write_pattern_fields(w, s.pattern_ids, s.pattern_count, pattern_names);
+            // Header fields as parsed by the agent; absent ones are omitted.
+            auto span = [&s](TextSpan t) { return std::string_view(s.line + t.off, t.len); };
+            if (s.has_priority) {
+                w.field("facility", s.priority >> 3);
+                w.field("syslog_severity", s.priority & 7);
+            }
+            if (s.timestamp.len) w.field("syslog_time", span(s.timestamp));
+            if (s.host.len) w.field("host", span(s.host));
+            if (s.app.len) w.field("app", span(s.app));
+            if (s.pid.len) w.field("pid", span(s.pid));
+            if (s.message.len) w.field("body", span(s.message));
+            break;
+        }
+        case SYSLOG_REPEAT: {
+            const auto& r = ev.repeat;
+            w.field("template", std::string_view(r.templ, r.templ_len));
+            w.field("count", r.count);
+            w.field("span_ms", r.span_ms);
+            w.field("last_offset", r.last_offset);
+            write_pattern_fields(w, r.pattern_ids, r.pattern_count, pattern_names);
+            break;
+        }
+        case USB_EVENT: {
+            const auto& u = ev.usb;
+            w.field("action", usb_action_name(u.action));
+            if (u.has_ids) {
+                char hex[5];
+                snprintf(hex, sizeof(hex), "%04x", u.vendor);
+                w.field("vendor", hex);
+                snprintf(hex, sizeof(hex), "%04x", u.product);
+                w.field("product", hex);
+            }
+            if (u.devnode[0]) w.field("devnode", u.devnode);
+            auto span = [&u](TextSpan t) { return std::string_view(u.strings + t.off, t.len); };
+            if (u.serial.len) w.field("serial", span(u.serial));
+            if (u.manufacturer.len) w.field("manufacturer", span(u.manufacturer));
+            if (u.product_name.len) w.field("product_name", span(u.product_name));
+            if (u.cached) w.field("cached", true);
+            break;
+        }
+        case FILE_DELETE: {
+            const auto& f = ev.file;
+            w.field("mask", f.mask);
+            w.field("wd", f.wd);
+            w.field("path", std::string_view(f.path, f.path_len));
+            w.field("name", std::string_view(f.path + f.name_offset, f.path_len - f.name_offset));
+            break;
+        }
+        case FILE_ROLLUP: {
+            const auto& r = ev.rollup;
+            for_each_rollup_name(r, [&](size_t i, const char* name) {
+                if (i == 0) w.field("dir", name);
+            });
+            w.key("first_names");
+            w.begin_array();
+            for_each_rollup_name(r, [&](size_t i, const char* name) {
+                if (i >= 1 && i <= r.first_count) w.value(name);
+            });
+            w.end_array();
+            w.key("last_names");
+            w.begin_array();
+            for_each_rollup_name(r, [&](size_t i, const char* name) {
+                if (i > r.first_count) w.value(name);
+            });
+            w.end_array();
+            w.field("count", r.count);
+            w.field("deleted", r.deleted);
+            w.field("moved", r.moved);
+            w.field("span_ms", r.span_ms);
+            break;
+        }
+        case ADMISSION_REPORT: {
+            const auto& a = ev.admission;
+            w.field("source", event_source_name(a.source));
+            w.field("interval_ms", a.interval_ms);
+            w.field("admitted", a.admitted);
+            w.field("sampled", a.sampled);
+            w.field("dropped_rate", a.dropped_rate);
+            w.field("dropped_quota", a.dropped_quota);
+            w.field("dropped_full", a.dropped_full);
+            w.field("queue_depth", a.queue_depth);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Writes one log entry object. `scratch` is reused for the message text.
+inline void write_log_record(JsonWriter& w, const LogRecord& rec, const std::vector<std::string>& pattern_names,
+                             std::string& scratch) {
+    w.begin_object();
+    w.field("event_id", rec.ev.event_id);
+    if (rec.agent) w.field("agent", *rec.agent);
+    w.field("type", event_type_name(rec.ev.type));
+    w.field("severity", severity_name(rec.ev.severity));
+    scratch.clear();
+    append_event_message(scratch, rec.ev);
+    w.field("message", scratch);
+    scratch.clear();
+    append_timestamp(scratch, rec.ev.capture_realtime_ns);
+    w.field("timestamp", scratch);
+    if (rec.dequeued_monotonic_ns >= rec.ev.capture_monotonic_ns)
+        w.field("queue_latency_us", (rec.dequeued_monotonic_ns - rec.ev.capture_monotonic_ns) / 1000);
+    write_event_fields(w, rec.ev, pattern_names);
+    w.end_object();
+}
+
+// Serializes a sealed batch into `out` (cleared first). `event_buf` and
+// `scratch` are caller-owned so repeated batches reuse their capacity.
+inline void write_log_batch(std::string& out, const std::vector<LogRecord>& records, const std::string& prev_cid,
+                            BatchFormat format, const std::vector<std::string>& pattern_names,
+                            std::string& event_buf, std::string& scratch) {
+    out.clear();
+    JsonWriter w(out);
+
+    auto write_header_fields = [&] {
+        scratch.clear();
+        append_timestamp(scratch, realtime_ns());
+        w.field("timestamp", scratch);
+        w.key("prev_cid");
+        if (prev_cid.empty()) w.null();
+        else w.value(prev_cid);
+    };
+
+    if (format == BatchFormat::NDJSON) {
+        w.begin_object();
+        write_header_fields();
+        w.field("count", static_cast<uint64_t>(records.size()));
+        w.end_object();
+        for (const auto& rec : records) {
+            w.newline();
+            write_log_record(w, rec, pattern_names, scratch);
+        }
+        w.newline();
+        return;
+    }
+
+    // Legacy layout: every entry is embedded as a JSON-encoded string.
+    w.begin_object();
+    write_header_fields();
+    w.key("logs");
+    w.begin_array();
+    for (const auto& rec : records) {
+        event_buf.clear();
+        JsonWriter ew(event_buf);
+        write_log_record(ew, rec, pattern_names, scratch);
+        w.value(event_buf);
+    }
+    w.end_array();
+    w.end_object();
+}
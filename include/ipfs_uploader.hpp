@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "cid.hpp"
+#include "log_utils.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "thread_profile.hpp"
+#include "async_logger.hpp"
+#include "config.hpp"
+
+// A sealed batch: encrypted on disk, already linked into the chain by the CID
+// computed for it in process.
+struct UploadJob {
+    std::string path;
+    cid::Cid cid;
+    size_t events = 0;
+    size_t bytes = 0;            // serialized batch size before encryption
+    uint64_t sealed_ns = 0;      // monotonic, when the batch was taken from the bucket
+    uint64_t queued_ns = 0;      // monotonic, when it was submitted
+    uint8_t trigger = 0;         // BatchController::Trigger, for accounting
+    std::vector<uint64_t> trace_ids;   // traced events in the batch
+};
+
+// Uploads sealed batches in chain order on a background thread so the reader
+// can keep sealing. Each upload is verified: the daemon's CID must equal the
+// local one. On a mismatch (a daemon whose importer settings differ) the
+// blocks are computed locally and put into the daemon one by one, then the
+// root is pinned, so the chain link stays resolvable. A job is retried until
+// it is verified; only then is the IPNS head moved to it (when the queue
+// drains or every UPLOAD_QUEUE_DEPTH uploads, so a backlog is published once).
+class IpfsUploader {
+public:
+    struct Stats {
+        uint64_t uploaded = 0;       // verified, including repaired
+        uint64_t mismatches = 0;
+        uint64_t repaired = 0;
+        uint64_t failures = 0;       // failed attempts (retried)
+        uint64_t abandoned = 0;      // left on disk at shutdown
+        uint64_t queued = 0;
+        std::string head;            // last CID published to IPNS
+    };
+
+    // Time spent per attempt in each daemon call.
+    struct Timings {
+        metrics::Histogram add = metrics::seconds_histogram();
+        metrics::Histogram publish = metrics::seconds_histogram();
+        metrics::Histogram repair = metrics::seconds_histogram();
+    };
+
+    // Called once per job from the upload thread with the final outcome.
+    using Done = std::function<void(const UploadJob&, bool ok)>;
+
+    IpfsUploader(int cid_version, std::string ipns_key, Done on_done)
+        : cid_version_(cid_version), ipns_key_(std::move(ipns_key)), on_done_(std::move(on_done)),
+          thread_(&IpfsUploader::run, this) {}
+
+    ~IpfsUploader() { stop(); }
+
+    IpfsUploader(const IpfsUploader&) = delete;
+    IpfsUploader& operator=(const IpfsUploader&) = delete;
+
+    bool has_capacity() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return jobs_.size() < Config::IPFSConfig::UPLOAD_QUEUE_DEPTH;
+    }
+
+    void submit(UploadJob&& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        cv_.notify_one();
+    }
+
+    // Uploads what is queued, giving each job UPLOAD_SHUTDOWN_ATTEMPTS tries,
+    // and stops the thread. Jobs that still fail stay on disk for recovery.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) return;
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats s = stats_;
+        s.queued = jobs_.size();
+        return s;
+    }
+
+    const Timings& timings() const { return timings_; }
+
+private:
+    void run() {
+        trace::set_thread_name("uploader");
+        thread_profile::apply("uploader", Config::threads.uploader);
+        int attempts = 0;
+        size_t unpublished = 0;
+        for (;;) {
+            UploadJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return stopping_ || !jobs_.empty(); });
+                if (jobs_.empty()) return;
+                job = jobs_.front();
+            }
+
+            bool ok = upload(job);
+            ++attempts;
+            bool give_up = !ok && stopping() && attempts >= Config::IPFSConfig::UPLOAD_SHUTDOWN_ATTEMPTS;
+            if (!ok && !give_up) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ++stats_.failures;
+                cv_.wait_for(lock, std::chrono::milliseconds(Config::IPFSConfig::UPLOAD_RETRY_MS));
+                continue;
+            }
+
+            attempts = 0;
+            bool drained;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                jobs_.pop_front();
+                drained = jobs_.empty();
+                if (ok) ++stats_.uploaded;
+                else ++stats_.abandoned;
+            }
+            if (ok) {
+                std::error_code ec;
+                std::filesystem::remove(job.path, ec);
+                if (drained || ++unpublished >= Config::IPFSConfig::UPLOAD_QUEUE_DEPTH) {
+                    publish(job.cid);
+                    unpublished = 0;
+                }
+            } else {
+                logger::error("IPFS", "Giving up on {} ({}); left on disk for the next start", job.path,
+                              job.cid.to_string());
+            }
+            on_done_(job, ok);
+        }
+    }
+
+    bool stopping() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stopping_;
+    }
+
+    bool upload(const UploadJob& job) {
+        std::string expected = job.cid.to_string();
+        uint64_t start_ns = monotonic_ns();
+        std::string got = ipfs_add(job.path, cid_version_);
+        timings_.add.observe_ns(monotonic_ns() - start_ns);
+        trace::batch_slice("ipfs_add", start_ns, monotonic_ns());
+        if (got.empty()) return false;
+        if (got == expected) {
+            logger::info("IPFS", "Pushed CID: {}", got);
+            trace_stored(job, start_ns);
+            return true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.mismatches;
+        }
+        logger::error("IPFS", "CID mismatch for {}: local {}, daemon {}; repairing", job.path, expected, got);
+        start_ns = monotonic_ns();
+        bool repaired = repair(job);
+        timings_.repair.observe_ns(monotonic_ns() - start_ns);
+        trace::batch_slice("ipfs_repair", start_ns, monotonic_ns());
+        if (!repaired) return false;
+        trace_stored(job, start_ns);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.repaired;
+        }
+        logger::warn("IPFS", "Repaired {} by putting its blocks directly", expected);
+        return true;
+    }
+
+    // Ends the flow of each traced event at the daemon call that stored it.
+    static void trace_stored(const UploadJob& job, uint64_t call_ns) {
+        for (uint64_t id : job.trace_ids) {
+            trace::wait(id, "upload_queue", job.queued_ns, call_ns);
+            trace::flow(id, call_ns, trace::Kind::FlowEnd);
+        }
+    }
+
+    // Puts every block of the locally built DAG, checks the daemon hashed each
+    // to the same CID, and pins the root.
+    bool repair(const UploadJob& job) {
+        std::vector<cid::Block> blocks;
+        try {
+            cid::Cid root = cid::file_dag(cid::read_file_bytes(job.path), cid_version_, &blocks);
+            if (root != job.cid) {
+                logger::error("IPFS", "{} changed on disk since it was sealed", job.path);
+                return false;
+            }
+        } catch (const std::exception& e) {
+            logger::error("IPFS", "Cannot rebuild blocks for {}: {}", job.path, e.what());
+            return false;
+        }
+
+        std::string block_path = job.path + ".block";
+        std::error_code ec;
+        for (const auto& b : blocks) {
+            {
+                std::ofstream out(block_path, std::ios::binary | std::ios::trunc);
+                out.write(reinterpret_cast<const char*>(b.data.data()), b.data.size());
+                if (!out) return false;
+            }
+            const char* codec = b.cid.codec == cid::CODEC_RAW ? "raw" : "dag-pb";
+            std::string got = run_command("ipfs block put --cid-codec=" + std::string(codec) +
+                                          " --mhtype=sha2-256 \"" + block_path + "\"");
+            got.erase(got.find_last_not_of(" \n\r\t") + 1);
+            if (got != b.cid.to_v1_string()) {
+                logger::error("IPFS", "Block put returned {} for {}", got, b.cid.to_v1_string());
+                std::filesystem::remove(block_path, ec);
+                return false;
+            }
+        }
+        std::filesystem::remove(block_path, ec);
+        return run_command_status("ipfs pin add " + job.cid.to_string()) == 0;
+    }
+
+    void publish(const cid::Cid& cid) {
+        std::string head = cid.to_string();
+        uint64_t start_ns = monotonic_ns();
+        bool ok = ipns_publish(ipns_key_, head);
+        timings_.publish.observe_ns(monotonic_ns() - start_ns);
+        trace::batch_slice("ipns_publish", start_ns, monotonic_ns());
+        if (!ok) {
+            logger::error("IPNS", "Failed to update IPNS head for {}.", ipns_key_);
+            return;
+        }
+        logger::info("IPNS", "Head updated to: {}", head);
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.head = head;
+    }
+
+    const int cid_version_;
+    const std::string ipns_key_;
+    Done on_done_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<UploadJob> jobs_;      // front is being uploaded
+    bool stopping_ = false;
+    Stats stats_;
+    Timings timings_;
+    std::thread thread_;              // last: starts after the members it uses
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+
+// Appends JSON escaping of `s` to `out`. Control characters become \uXXXX and
+// malformed UTF-8 is replaced with U+FFFD, so arbitrary log bytes always yield
+// valid JSON.
+inline void append_json_escaped(std::string& out, std::string_view s) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    const auto* p = reinterpret_cast<const unsigned char*>(s.data());
+    const auto* end = p + s.size();
+
+    while (p < end) {
+        // Copy the longest run that needs no escaping in one go.
+        const auto* run = p;
+        while (p < end && *p >= 0x20 && *p < 0x80 && *p != '"' && *p != '\\') ++p;
+        out.append(reinterpret_cast<const char*>(run), p - run);
+        if (p == end) break;
+
+        unsigned char c = *p;
+        if (c < 0x80) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                default: {
+                    char esc[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+                    out.append(esc, sizeof(esc));
+                }
+            }
+            ++p;
+            continue;
+        }
+
+        // Multi-byte sequence: validate length, continuation bytes and range.
+        size_t len = 0;
+        uint32_t cp = 0;
+        if ((c & 0xe0) == 0xc0) { len = 2; cp = c & 0x1f; }
+        else if ((c & 0xf0) == 0xe0) { len = 3; cp = c & 0x0f; }
+        else if ((c & 0xf8) == 0xf0) { len = 4; cp = c & 0x07; }
+
+        bool valid = len != 0 && static_cast<size_t>(end - p) >= len;
+        for (size_t i = 1; valid && i < len; ++i) {
+            if ((p[i] & 0xc0) != 0x80) valid = false;
+            else cp = (cp << 6) | (p[i] & 0x3f);
+        }
+        if (valid) {
+            static constexpr uint32_t MIN_CP[] = {0, 0, 0x80, 0x800, 0x10000};
+            valid = cp >= MIN_CP[len] && cp <= 0x10ffff && (cp < 0xd800 || cp > 0xdfff);
+        }
+
+        if (valid) {
+            out.append(reinterpret_cast<const char*>(p), len);
+            p += len;
+        } else {
+            out += "\xef\xbf\xbd";
+            ++p;
+        }
+    }
+}
+
+// Minimal streaming JSON writer over a caller-owned buffer. It tracks only
+// comma placement; callers are responsible for well-formed nesting.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    void begin_object() { separate(); out_ += '{'; push(); }
+    void end_object() { pop(); out_ += '}'; }
+    void begin_array() { separate(); out_ += '['; push(); }
+    void end_array() { pop(); out_ += ']'; }
+
+    void key(std::string_view k) {
+        separate();
+        out_ += '"';
+        append_json_escaped(out_, k);
+        out_ += "\":";
+        after_key_ = true;
+    }
+
+    void value(std::string_view s) {
+        separate();
+        out_ += '"';
+        append_json_escaped(out_, s);
+        out_ += '"';
+    }
+    void value(const char* s) { value(std::string_view(s)); }
+
+    void value(uint64_t v) { separate(); append_number(v); }
+    void value(uint32_t v) { value(static_cast<uint64_t>(v)); }
+    void value(uint16_t v) { value(static_cast<uint64_t>(v)); }
+    void value(int64_t v) { separate(); append_number(v); }
+    void value(int32_t v) { value(static_cast<int64_t>(v)); }
+    void value(bool v) { separate(); out_ += v ? "true" : "false"; }
+    void null() { separate(); out_ += "null"; }
+
+    // Pre-serialized JSON value, appended verbatim.
+    void raw(std::string_view json) { separate(); out_ += json; }
+
+    template<typename T>
+    void field(std::string_view k, const T& v) { key(k); value(v); }
+
+    // Ends the current top-level value and starts a new NDJSON line.
+    void newline() { out_ += '\n'; depth_ = 0; first_[0] = true; }
+
+    std::string& buffer() { return out_; }
+
+private:
+    static constexpr int MAX_DEPTH = 32;
+
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (!first_[depth_]) out_ += ',';
+        first_[depth_] = false;
+    }
+    void push() {
+        if (depth_ + 1 < MAX_DEPTH) ++depth_;
+        first_[depth_] = true;
+    }
+    void pop() {
+        if (depth_ > 0) --depth_;
+    }
+
+    template<typename T>
+    void append_number(T v) {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out_.append(buf, res.ptr - buf);
+    }
+
+    std::string& out_;
+    int depth_ = 0;
+    bool first_[MAX_DEPTH] = {true};
+    bool after_key_ = false;
+};
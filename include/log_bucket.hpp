@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <iterator>
+#include "config.hpp"
+
+// Per-worker log buckets. Each worker appends only to its own shard, and a
+// collector takes what the shards hold; neither side ever blocks or retries.
+//
+// A shard is a single-producer/single-consumer list of fixed-size chunks.
+// The worker writes an entry into its tail chunk and publishes it with one
+// release store of the chunk's count, with no read-modify-write on the push
+// path. The collector moves entries out up to the published count and hands
+// chunks it has emptied back through a free list, so steady-state pushes
+// never allocate.
+template<typename Entry>
+class ShardedLogBucket {
+public:
+    using Batch = std::vector<Entry>;
+
+    // `chunk_entries` is the number of entries per chunk.
+    ShardedLogBucket(size_t shards, size_t chunk_entries) : shards_(shards), chunk_entries_(chunk_entries) {
+        for (auto& s : shards_) s.tail = s.head = new Chunk(chunk_entries_);
+    }
+
+    ~ShardedLogBucket() {
+        for (auto& s : shards_) {
+            for (Chunk* c = s.head; c;) {
+                Chunk* next = c->next.load(std::memory_order_relaxed);
+                delete c;
+                c = next;
+            }
+            for (Chunk* list : {s.free.load(std::memory_order_relaxed), s.reuse}) {
+                for (Chunk* c = list; c;) {
+                    Chunk* next = c->next.load(std::memory_order_relaxed);
+                    delete c;
+                    c = next;
+                }
+            }
+        }
+    }
+
+    ShardedLogBucket(const ShardedLogBucket&) = delete;
+    ShardedLogBucket& operator=(const ShardedLogBucket&) = delete;
+
+    // Called only by the worker that owns `shard`.
+    void push(size_t shard, Entry&& entry) {
+        Shard& s = shards_[shard];
+        Chunk* c = s.tail;
+        size_t n = c->count.load(std::memory_order_relaxed);   // only we write it
+        if (n == c->capacity) {
+            // Take everything the collector has freed at once.
+            if (!s.reuse) s.reuse = s.free.exchange(nullptr, std::memory_order_acquire);
+            Chunk* fresh = s.reuse;
+            if (fresh) {
+                s.reuse = fresh->next.load(std::memory_order_relaxed);
+                fresh->next.store(nullptr, std::memory_order_relaxed);
+                fresh->count.store(0, std::memory_order_relaxed);
+            } else {
+                fresh = new Chunk(chunk_entries_);
+            }
+            c->next.store(fresh, std::memory_order_release);
+            s.tail = c = fresh;
+            n = 0;
+        }
+        c->items[n] = std::move(entry);
+        c->count.store(n + 1, std::memory_order_release);
+        s.pushed.store(s.pushed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Moves every shard's pending entries into `out`. Only one thread may
+    // collect at a time.
+    size_t collect_into(Batch& out) {
+        size_t taken = 0;
+        for (size_t i = 0; i < shards_.size(); ++i) taken += collect_shard_into(i, out);
+        return taken;
+    }
+
+    // Moves the entries one shard has published so far into `out`, in push
+    // order, and returns their number. Only one thread may collect at a time.
+    size_t collect_shard_into(size_t shard, Batch& out) {
+        Shard& s = shards_[shard];
+        // Only what was published when the collect began, so a busy worker
+        // cannot keep the collector chasing its tail.
+        const uint64_t base = s.taken.load(std::memory_order_relaxed);
+        const uint64_t pushed = s.pushed.load(std::memory_order_relaxed);
+        const size_t limit = pushed > base ? pushed - base : 0;
+        size_t taken = 0;
+        while (taken < limit) {
+            Chunk* c = s.head;
+            size_t count = std::min(c->count.load(std::memory_order_acquire), s.read + (limit - taken));
+            if (s.read < count) {
+                out.insert(out.end(), std::make_move_iterator(&c->items[s.read]),
+                           std::make_move_iterator(&c->items[count]));
+                taken += count - s.read;
+                s.read = count;
+            }
+            if (count < c->capacity) break;
+            // Full: the worker has moved on once it has linked the next chunk.
+            Chunk* next = c->next.load(std::memory_order_acquire);
+            if (!next) break;
+            s.head = next;
+            s.read = 0;
+            recycle(s, c);
+        }
+        s.taken.store(base + taken, std::memory_order_relaxed);
+        return taken;
+    }
+
+    // Approximate number of entries not yet collected; never takes a lock.
+    size_t pending() const {
+        size_t n = 0;
+        for (const auto& s : shards_) {
+            uint64_t taken = s.taken.load(std::memory_order_relaxed);
+            uint64_t pushed = s.pushed.load(std::memory_order_relaxed);
+            if (pushed > taken) n += pushed - taken;
+        }
+        return n;
+    }
+
+    size_t shard_count() const { return shards_.size(); }
+
+private:
+    struct Chunk {
+        explicit Chunk(size_t capacity) : items(new Entry[capacity]), capacity(capacity) {}
+
+        std::unique_ptr<Entry[]> items;
+        const size_t capacity;
+        std::atomic<size_t> count{0};          // entries published by the worker
+        std::atomic<Chunk*> next{nullptr};     // set by the worker once this one is full
+    };
+
+    // The worker's and the collector's fields sit on separate cache lines.
+    struct alignas(Config::QueueConfig::CACHE_LINE_SIZE) Shard {
+        Chunk* tail = nullptr;                 // worker: chunk being appended to
+        Chunk* reuse = nullptr;                // worker: freed chunks taken from `free`
+        std::atomic<uint64_t> pushed{0};       // written by the owning worker only
+
+        alignas(Config::QueueConfig::CACHE_LINE_SIZE) Chunk* head = nullptr;   // collector: oldest chunk
+        size_t read = 0;                       // collector: next entry of head to take
+        std::atomic<uint64_t> taken{0};        // written by the collector only
+        std::atomic<Chunk*> free{nullptr};     // emptied chunks, linked through `next`
+    };
+
+    // Pushes an emptied chunk onto the free list; the worker no longer
+    // touches a chunk it has linked past. The worker only ever takes the whole
+    // list, so there is no ABA.
+    static void recycle(Shard& s, Chunk* c) {
+        Chunk* head = s.free.load(std::memory_order_relaxed);
+        do {
+            c->next.store(head, std::memory_order_relaxed);
+        } while (!s.free.compare_exchange_weak(head, c, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    std::vector<Shard> shards_;
+    size_t chunk_entries_;
+};
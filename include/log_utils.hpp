@@ -1,6 +1,9 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
+#include <iterator>
 #include <vector>
 #include <fstream>
 #include <chrono>
@@ -11,6 +14,8 @@
 #include <cstdio>
 #include "json.hpp"
 #include "config.hpp"
+#include "timestamp.hpp"
+#include "async_logger.hpp"
 
 #include <openssl/evp.h>
 #include <openssl/rand.h>
@@ -22,19 +27,11 @@
 using json = nlohmann::json;
 
 inline std::string current_timestamp() {
-    using namespace std::chrono;
-    auto now = system_clock::now();
-    auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
-
-    std::time_t t = system_clock::to_time_t(now);
-    std::tm tm_utc;
-    gmtime_r(&t, &tm_utc); 
-
-    std::stringstream ss;
-    ss << std::put_time(&tm_utc, "%Y-%m-%dT%H:%M:%S");
-    ss << '.' << std::setw(3) << std::setfill('0') << ms.count() << "Z";
-    return ss.str();
+    std::string ts;
+    append_timestamp(ts, realtime_ns());
+    return ts;
 }
+
 inline std::string read_prev_cid(const std::string& filepath = "") {
     std::string actual_filepath = filepath;
     if (actual_filepath.empty()) {
@@ -78,20 +75,81 @@ inline std::string run_command(const std::string& cmd) {
     return result;
 }
 
-inline std::string ipfs_add(const std::string& filepath) {
+// Runs a command, discarding its output; returns the exit status.
+inline int run_command_status(const std::string& cmd) {
+    std::array<char, 128> buffer;
+    FILE* pipe = popen((cmd + " 2>&1").c_str(), "r");
+    if (!pipe) return -1;
+    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr);
+    return pclose(pipe);
+}
+
+inline std::string get_ipns_id_for_key(const std::string& key_name) {
+    FILE* pipe = popen("ipfs key list -l", "r");
+    if (!pipe) throw std::runtime_error("Failed to run 'ipfs key list -l'");
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+        std::istringstream iss(buffer);
+        std::string peer_id, name;
+        iss >> peer_id >> name;
+        if (name == key_name) {
+            pclose(pipe);
+            return peer_id;
+        }
+    }
+    pclose(pipe);
+    throw std::runtime_error("IPNS key '" + key_name + "' not found.\nTry: ipfs key gen log-agent --type=rsa --size=2048\nipfs daemon --routing=dhtclient\n");
+}
+
+inline std::string resolve_ipns(const std::string& ipns_id) {
+    std::string cmd = "ipfs name resolve --nocache /ipns/" + ipns_id + " --timeout=5s";
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return "null";
+    char buffer[256];
+    std::string result;
+    while (fgets(buffer, sizeof(buffer), pipe)) result += buffer;
+    pclose(pipe);
+    if (result.rfind("/ipfs/", 0) == 0)
+        return result.substr(6);
+    return "null";
+}
+
+// Points the IPNS name of `key_name` at /ipfs/<cid>; returns false on failure.
+inline bool ipns_publish(const std::string& key_name, const std::string& cid) {
+    std::string cmd = "ipfs name publish --key=" + key_name + " --allow-offline --ttl=" +
+                      std::to_string(Config::IPFSConfig::IPNS_TTL_SECONDS) + "s /ipfs/" + cid;
+    return run_command_status(cmd) == 0;
+}
+
+// Raw bytes of one block from the daemon (`ipfs block get`); empty on failure.
+inline std::string ipfs_block_get(const std::string& cid) {
+    std::string data;
+    FILE* pipe = popen(("ipfs block get " + cid + " 2>/dev/null").c_str(), "r");
+    if (!pipe) return data;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) data.append(buffer, n);
+    if (pclose(pipe) != 0) data.clear();
+    return data;
+}
+
+// Adds a file with the importer settings cid.hpp reproduces locally (256 KiB
+// chunks; CIDv1 implies raw leaves) and returns the CID the daemon reports.
+inline std::string ipfs_add(const std::string& filepath, int cid_version = 0) {
     std::string check = run_command("pgrep -x ipfs");
     if (check.empty()) {
-        std::cerr << "[IPFS] Warning: IPFS daemon not running!\n";
+        logger::warn("IPFS", "IPFS daemon not running!");
     }
 
     // Escape the filepath for shell command
     std::string escaped_path = "\"" + filepath + "\"";
-    std::string cmd = "ipfs add -q " + escaped_path;
+    std::string cmd = "ipfs add -q --chunker=size-262144 " +
+                      std::string(cid_version == 1 ? "--cid-version=1 " : "") + escaped_path;
     std::string output = run_command(cmd);
     if (!output.empty()) {
         output.erase(output.find_last_not_of(" \n\r\t") + 1);
     } else {
-        std::cerr << "[IPFS] Error: Could not add file.\n";
+        logger::error("IPFS", "Could not add file: {}", filepath);
     }
 
     return output;
@@ -105,43 +163,38 @@ inline std::vector<uint8_t> generate_random_bytes(size_t size) {
     return buffer;
 }
 
-inline std::vector<uint8_t> aes_gcm_encrypt(const std::string& plaintext,
-                                            const std::vector<uint8_t>& key,
-                                            std::vector<uint8_t>& out_iv,
-                                            std::vector<uint8_t>& out_tag) {
-    const int iv_len = 12;
-    out_iv = generate_random_bytes(iv_len);
-    out_tag.resize(16);
+constexpr size_t AES_GCM_IV_SIZE = 12;
+constexpr size_t AES_GCM_TAG_SIZE = 16;
 
-    std::vector<uint8_t> ciphertext(plaintext.size());
+// AES-256-GCM into a caller-provided buffer of plaintext.size() bytes (GCM
+// ciphertext is as long as the plaintext). A fresh random IV is written to
+// `iv`, the tag to `tag`.
+inline void aes_gcm_encrypt_into(std::string_view plaintext, const uint8_t* key, uint8_t* iv, uint8_t* tag,
+                                 uint8_t* out) {
+    if (!RAND_bytes(iv, AES_GCM_IV_SIZE)) throw std::runtime_error("Failed to generate secure random bytes.");
 
     EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
     if (!ctx) throw std::runtime_error("Failed to create EVP_CIPHER_CTX");
 
-    if (EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) != 1)
-        throw std::runtime_error("AES-GCM init failed");
-
-    EVP_EncryptInit_ex(ctx, nullptr, nullptr, key.data(), out_iv.data());
-
-    int len;
-    int ciphertext_len;
-    if (EVP_EncryptUpdate(ctx, ciphertext.data(), &len,
-                          reinterpret_cast<const unsigned char*>(plaintext.data()),
-                          plaintext.size()) != 1)
-        throw std::runtime_error("AES-GCM update failed");
-
-    ciphertext_len = len;
-
-    if (EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len) != 1)
-        throw std::runtime_error("AES-GCM finalization failed");
-
-    ciphertext_len += len;
-
-    if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, out_tag.data()) != 1)
-        throw std::runtime_error("AES-GCM tag fetch failed");
-
+    int len = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1 &&
+              EVP_EncryptInit_ex(ctx, nullptr, nullptr, key, iv) == 1 &&
+              EVP_EncryptUpdate(ctx, out, &len, reinterpret_cast<const unsigned char*>(plaintext.data()),
+                                static_cast<int>(plaintext.size())) == 1 &&
+              EVP_EncryptFinal_ex(ctx, out + len, &len) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AES_GCM_TAG_SIZE, tag) == 1;
     EVP_CIPHER_CTX_free(ctx);
-    ciphertext.resize(ciphertext_len);
+    if (!ok) throw std::runtime_error("AES-GCM encryption failed");
+}
+
+inline std::vector<uint8_t> aes_gcm_encrypt(const std::string& plaintext,
+                                            const std::vector<uint8_t>& key,
+                                            std::vector<uint8_t>& out_iv,
+                                            std::vector<uint8_t>& out_tag) {
+    out_iv.resize(AES_GCM_IV_SIZE);
+    out_tag.resize(AES_GCM_TAG_SIZE);
+    std::vector<uint8_t> ciphertext(plaintext.size());
+    aes_gcm_encrypt_into(plaintext, key.data(), out_iv.data(), out_tag.data(), ciphertext.data());
     return ciphertext;
 }
 
@@ -180,18 +233,123 @@ inline std::string base64_encode(const std::vector<uint8_t>& data) {
     return encoded;
 }
 
+inline std::vector<uint8_t> base64_decode(const std::string& encoded) {
+    BIO* bio = BIO_new_mem_buf(encoded.data(), static_cast<int>(encoded.size()));
+    BIO* b64 = BIO_new(BIO_f_base64());
+    bio = BIO_push(b64, bio);
+    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
+
+    std::vector<uint8_t> decoded(encoded.size() * 3 / 4 + 3);
+    int len = BIO_read(bio, decoded.data(), static_cast<int>(decoded.size()));
+    BIO_free_all(bio);
+    if (len < 0) throw std::runtime_error("Base64 decoding failed.");
+    decoded.resize(len);
+    return decoded;
+}
+
+// Inverse of aes_gcm_encrypt; throws if the tag does not authenticate.
+inline std::string aes_gcm_decrypt(const std::vector<uint8_t>& ciphertext,
+                                   const std::vector<uint8_t>& key,
+                                   const std::vector<uint8_t>& iv,
+                                   const std::vector<uint8_t>& tag) {
+    std::string plaintext(ciphertext.size(), '\0');
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) throw std::runtime_error("Failed to create EVP_CIPHER_CTX");
+
+    int len = 0;
+    bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, static_cast<int>(iv.size()), nullptr) == 1 &&
+              EVP_DecryptInit_ex(ctx, nullptr, nullptr, key.data(), iv.data()) == 1 &&
+              EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char*>(plaintext.data()), &len,
+                                ciphertext.data(), static_cast<int>(ciphertext.size())) == 1;
+    int plaintext_len = len;
+    ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, static_cast<int>(tag.size()),
+                                   const_cast<uint8_t*>(tag.data())) == 1 &&
+         EVP_DecryptFinal_ex(ctx, reinterpret_cast<unsigned char*>(plaintext.data()) + len, &len) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    if (!ok) throw std::runtime_error("AES-GCM decryption failed.");
+
+    plaintext.resize(plaintext_len + len);
+    return plaintext;
+}
+
+inline std::vector<uint8_t> rsa_decrypt_key(const std::vector<uint8_t>& encrypted, const std::string& privkey_path) {
+    FILE* privkey_file = fopen(privkey_path.c_str(), "rb");
+    if (!privkey_file) throw std::runtime_error("Cannot open RSA private key file.");
+
+    RSA* rsa = PEM_read_RSAPrivateKey(privkey_file, nullptr, nullptr, nullptr);
+    fclose(privkey_file);
+    if (!rsa) throw std::runtime_error("Failed to read RSA private key.");
+
+    std::vector<uint8_t> key(RSA_size(rsa));
+    int len = RSA_private_decrypt(encrypted.size(), encrypted.data(), key.data(), rsa, RSA_PKCS1_OAEP_PADDING);
+    RSA_free(rsa);
+
+    if (len == -1) throw std::runtime_error("RSA decryption failed.");
+    key.resize(len);
+    return key;
+}
+
+// Appends the standard (padded) base64 encoding of [data, data + size).
+template<typename String>
+void append_base64(String& out, const uint8_t* data, size_t size) {
+    size_t at = out.size();
+    out.resize(at + 4 * ((size + 2) / 3) + 1);   // EVP_EncodeBlock adds a NUL
+    int n = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(out.data() + at), data, static_cast<int>(size));
+    out.resize(at + n);
+}
+
+// Formats the encrypted envelope ({"d","k","n","t"}, base64) into `out`, in
+// the layout json::dump(0) gives, so any container or allocator will do.
+template<typename String>
+void format_encrypted_envelope(String& out, const uint8_t* ciphertext, size_t ciphertext_size,
+                               const uint8_t* iv, size_t iv_size, const uint8_t* tag, size_t tag_size,
+                               const uint8_t* encrypted_key, size_t encrypted_key_size) {
+    out.clear();
+    out.reserve(4 * ((ciphertext_size + 2) / 3) + 4 * ((encrypted_key_size + 2) / 3) + 128);
+    out += "{\n\"d\": \"";
+    append_base64(out, ciphertext, ciphertext_size);
+    out += "\",\n\"k\": \"";
+    append_base64(out, encrypted_key, encrypted_key_size);
+    out += "\",\n\"n\": \"";
+    append_base64(out, iv, iv_size);
+    out += "\",\n\"t\": \"";
+    append_base64(out, tag, tag_size);
+    out += "\"\n}";
+}
+
+inline void write_file_bytes(const std::string& path, std::string_view bytes) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) throw std::runtime_error("Cannot write encrypted payload file.");
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    if (fclose(f) != 0 || !ok) throw std::runtime_error("Cannot write encrypted payload file.");
+}
+
 inline void write_minimal_encrypted_json(const std::string& path,
                                          const std::vector<uint8_t>& ciphertext,
                                          const std::vector<uint8_t>& iv,
                                          const std::vector<uint8_t>& tag,
                                          const std::vector<uint8_t>& encrypted_key) {
-    json j;
-    j["d"] = base64_encode(ciphertext);      
-    j["k"] = base64_encode(encrypted_key);    
-    j["n"] = base64_encode(iv);             
-    j["t"] = base64_encode(tag);           
-
-    std::ofstream out(path, std::ios::trunc);
-    if (!out) throw std::runtime_error("Cannot write encrypted payload file.");
-    out << j.dump(0); 
-}
\ No newline at end of file
+    std::string envelope;
+    format_encrypted_envelope(envelope, ciphertext.data(), ciphertext.size(), iv.data(), iv.size(), tag.data(),
+                              tag.size(), encrypted_key.data(), encrypted_key.size());
+    write_file_bytes(path, envelope);
+}
+
+// Opens an envelope written by write_minimal_encrypted_json and returns the
+// plaintext batch.
+inline std::string decrypt_envelope(std::string_view envelope, const std::string& privkey_path) {
+    json j = json::parse(envelope);
+    std::vector<uint8_t> key = rsa_decrypt_key(base64_decode(j.at("k").get<std::string>()), privkey_path);
+    return aes_gcm_decrypt(base64_decode(j.at("d").get<std::string>()), key,
+                           base64_decode(j.at("n").get<std::string>()),
+                           base64_decode(j.at("t").get<std::string>()));
+}
+
+inline std::string read_encrypted_json(const std::string& path, const std::string& privkey_path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Cannot read encrypted payload file.");
+    return decrypt_envelope(std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()),
+                            privkey_path);
+}
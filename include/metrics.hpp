@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "async_logger.hpp"
+#include "config.hpp"
+
+// Counters, gauges and histograms updated with relaxed atomics only, and a
+// registry that renders them in the Prometheus text format. Hot paths touch a
+// metric directly; the registry is only locked to register and to render.
+namespace metrics {
+
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Fixed upper bounds (in the unit the metric is exported in) chosen at
+// construction; observe() is a short scan and two atomic adds.
+class Histogram {
+public:
+    static constexpr size_t MAX_BUCKETS = 20;
+
+    explicit Histogram(std::initializer_list<double> bounds) {
+        if (bounds.size() > MAX_BUCKETS) throw std::invalid_argument("Too many histogram buckets");
+        std::copy(bounds.begin(), bounds.end(), bounds_.begin());
+        size_ = bounds.size();
+    }
+
+    void observe(double v) {
+        size_t i = 0;
+        while (i < size_ && v > bounds_[i]) ++i;
+        counts_[i].fetch_add(1, std::memory_order_relaxed);
+        // Sum kept in integer millionths so it can be an atomic add.
+        sum_micro_.fetch_add(static_cast<uint64_t>(std::max(v, 0.0) * 1e6), std::memory_order_relaxed);
+    }
+
+    void observe_ns(uint64_t ns) { observe(ns / 1e9); }
+
+    size_t size() const { return size_; }
+    double bound(size_t i) const { return bounds_[i]; }
+    uint64_t count(size_t i) const { return counts_[i].load(std::memory_order_relaxed); }   // i == size(): +Inf
+    double sum() const { return sum_micro_.load(std::memory_order_relaxed) / 1e6; }
+
+private:
+    std::array<double, MAX_BUCKETS> bounds_{};
+    std::array<std::atomic<uint64_t>, MAX_BUCKETS + 1> counts_{};
+    std::atomic<uint64_t> sum_micro_{0};
+    size_t size_ = 0;
+};
+
+// Bucket layouts shared by the pipeline metrics.
+inline Histogram seconds_histogram() {
+    return Histogram{1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+}
+inline Histogram bytes_histogram() {
+    return Histogram{1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20};
+}
+
+class Registry {
+public:
+    // `labels` is the inside of the braces, e.g. `stage="encrypt"`; metrics
+    // sharing a name must be registered together so they render as one family.
+    void counter(const std::string& name, const std::string& help, const Counter& c, std::string labels = "") {
+        add(name, help, "counter", std::move(labels), [&c] { return static_cast<double>(c.value()); }, nullptr);
+    }
+
+    // A monotonic count kept elsewhere (e.g. in a stats struct), read at render time.
+    void counter(const std::string& name, const std::string& help, std::function<double()> read,
+                 std::string labels = "") {
+        add(name, help, "counter", std::move(labels), std::move(read), nullptr);
+    }
+
+    // A value read at render time, e.g. a queue depth or a snapshot field.
+    void gauge(const std::string& name, const std::string& help, std::function<double()> read,
+               std::string labels = "") {
+        add(name, help, "gauge", std::move(labels), std::move(read), nullptr);
+    }
+
+    void histogram(const std::string& name, const std::string& help, const Histogram& h, std::string labels = "") {
+        add(name, help, "histogram", std::move(labels), nullptr, &h);
+    }
+
+    std::string render() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string out;
+        char num[64];
+        auto value = [&](double v) {
+            snprintf(num, sizeof(num), "%.10g", v);
+            return std::string(num);
+        };
+        auto braces = [](const std::string& labels, const std::string& extra = "") {
+            std::string all = labels.empty() ? extra : extra.empty() ? labels : labels + "," + extra;
+            return all.empty() ? "" : "{" + all + "}";
+        };
+        const std::string* family = nullptr;
+        for (const auto& m : metrics_) {
+            if (!family || *family != m.name) {
+                out += "# HELP " + m.name + " " + m.help + "\n# TYPE " + m.name + " " + m.type + "\n";
+                family = &m.name;
+            }
+            if (!m.histogram) {
+                out += m.name + braces(m.labels) + " " + value(m.read()) + "\n";
+                continue;
+            }
+            const Histogram& h = *m.histogram;
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i <= h.size(); ++i) {
+                cumulative += h.count(i);
+                std::string le = i < h.size() ? value(h.bound(i)) : "+Inf";
+                out += m.name + "_bucket" + braces(m.labels, "le=\"" + le + "\"") + " " + std::to_string(cumulative) + "\n";
+            }
+            out += m.name + "_sum" + braces(m.labels) + " " + value(h.sum()) + "\n";
+            out += m.name + "_count" + braces(m.labels) + " " + std::to_string(cumulative) + "\n";
+        }
+        return out;
+    }
+
+private:
+    struct Metric {
+        std::string name, help, type, labels;
+        std::function<double()> read;
+        const Histogram* histogram;
+    };
+
+    void add(const std::string& name, const std::string& help, const char* type, std::string labels,
+             std::function<double()> read, const Histogram* h) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        metrics_.push_back(Metric{name, help, type, std::move(labels), std::move(read), h});
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<Metric> metrics_;
+};
+
+// Answers every HTTP request on a Unix socket and/or a loopback TCP port with
+// the registry's current text, e.g.
+//   curl --unix-socket tmp/metrics.sock http://localhost/metrics
+//   curl http://127.0.0.1:<http_port>/metrics
+class Server {
+public:
+    Server(const Registry& registry, const Config::MetricsConfig& config) : registry_(registry) {
+        if (!config.socket_path.empty()) listen_unix(config.socket_path);
+        if (config.http_port > 0) listen_tcp(config.http_port);
+        if (!fds_.empty()) thread_ = std::thread(&Server::run, this);
+    }
+
+    ~Server() {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+        for (int fd : fds_) close(fd);
+        if (!unix_path_.empty()) unlink(unix_path_.c_str());
+    }
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+private:
+    void listen_unix(const std::string& path) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) {
+            logger::error("METRICS", "Socket path too long: {}", path);
+            return;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size());
+        unlink(path.c_str());
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+            logger::error("METRICS", "Cannot listen on {}: {}", path, strerror(errno));
+            if (fd >= 0) close(fd);
+            return;
+        }
+        unix_path_ = path;
+        fds_.push_back(fd);
+        logger::info("METRICS", "Serving metrics on unix:{}", path);
+    }
+
+    void listen_tcp(int port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+            logger::error("METRICS", "Cannot listen on 127.0.0.1:{}: {}", port, strerror(errno));
+            if (fd >= 0) close(fd);
+            return;
+        }
+        fds_.push_back(fd);
+        logger::info("METRICS", "Serving metrics on http://127.0.0.1:{}/metrics", port);
+    }
+
+    void run() {
+        std::vector<pollfd> pfds;
+        for (int fd : fds_) pfds.push_back(pollfd{fd, POLLIN, 0});
+        while (running_) {
+            if (poll(pfds.data(), pfds.size(), Config::MetricsConfig::POLL_MS) <= 0) continue;
+            for (const auto& p : pfds) {
+                if (!(p.revents & POLLIN)) continue;
+                int client = accept4(p.fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0) serve(client);
+            }
+        }
+    }
+
+    // One request per connection; the request itself is not interpreted.
+    void serve(int client) {
+        pollfd p{client, POLLIN, 0};
+        char request[1024];
+        if (poll(&p, 1, Config::MetricsConfig::POLL_MS) > 0) (void)!read(client, request, sizeof(request));
+        std::string body = registry_.render();
+        std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        for (size_t sent = 0; sent < response.size();) {
+            ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += n;
+        }
+        close(client);
+    }
+
+    const Registry& registry_;
+    std::vector<int> fds_;
+    std::string unix_path_;
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+};
+
+} // namespace metrics
@@ -7,19 +7,26 @@
 
 constexpr size_t CACHELINE = Config::QueueConfig::CACHE_LINE_SIZE;
 
+// `seq` says whose turn the slot is: equal to a position p when it is free for
+// the producer that claims p, p + 1 once that item is written, and p + N after
+// the consumer of p has read it (free for the next lap).
 template<typename T>
 struct alignas(CACHELINE) Slot {
-    std::atomic<uint8_t> state; // 0 = empty, 1 = writing, 2 = full, 3 = reading
+    std::atomic<size_t> seq;
     alignas(CACHELINE) T value;
 };
 
-enum SlotState : uint8_t {
-    EMPTY = 0,
-    WRITING = 1,
-    FULL = 2,
-    READING = 3
-};
-
+// Bounded MPMC ring shared between processes. Producers and consumers claim a
+// position by advancing tail/head with a CAS, and only once the slot for it is
+// ready, so an idle consumer never runs ahead of the producers and a full
+// queue never makes a producer skip a slot.
+//
+// A process that dies between claiming a position and storing its slot's seq
+// leaves that slot half-owned, and the ring stops there: consumers wait for
+// an item that is never published, or producers for a slot that is never
+// freed. The producer side is cleared by init(), which the agent runs on
+// every start; the consumer side by release_abandoned(), which the reader
+// runs when it attaches.
 template<typename T, size_t N>
 struct alignas(CACHELINE) MmapQueue {
     static_assert((N & (N - 1)) == 0, "N must be power of 2");
@@ -28,45 +35,111 @@ struct alignas(CACHELINE) MmapQueue {
     char pad1[CACHELINE - sizeof(head)];
     std::atomic<size_t> tail;
     char pad2[CACHELINE - sizeof(tail)];
+    std::atomic<size_t> count;       // filled slots, maintained on successful enqueue/dequeue
+    char pad3[CACHELINE - sizeof(count)];
 
     Slot<T> slots[N];
 
     void init() {
         head.store(0, std::memory_order_relaxed);
         tail.store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
         for (size_t i = 0; i < N; ++i)
-            slots[i].state.store(EMPTY, std::memory_order_relaxed);
+            slots[i].seq.store(i, std::memory_order_relaxed);
     }
 
     bool enqueue(const T& item) {
         for (int i = 0; i < Config::QueueConfig::MAX_RETRY_ATTEMPTS; ++i) {
-            size_t pos = tail.fetch_add(1, std::memory_order_acq_rel) & (N - 1);
-            auto& slot = slots[pos];
-
-            uint8_t expected = EMPTY;
-            if (slot.state.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) {
-                slot.value = item;
-                slot.state.store(FULL, std::memory_order_release);
-                return true;
-            }
+            if (push_once(item)) return true;
             std::this_thread::sleep_for(std::chrono::milliseconds(Config::QueueConfig::YIELD_SLEEP_MS));
         }
         return false;
     }
 
+    // Non-blocking enqueue: fails at once when the queue is full and gives up
+    // after `attempts` tries instead of sleeping.
+    bool try_enqueue(const T& item, int attempts) {
+        for (int i = 0; i < attempts; ++i) {
+            if (push_once(item)) return true;
+            if (count.load(std::memory_order_relaxed) >= N) return false;
+        }
+        return false;
+    }
+
+    // Approximate number of queued items.
+    size_t size_approx() const {
+        size_t n = count.load(std::memory_order_relaxed);
+        return n > N ? N : n;
+    }
+
     bool dequeue(T& out) {
         for (int i = 0; i < Config::QueueConfig::MAX_RETRY_ATTEMPTS; ++i) {
-            size_t pos = head.fetch_add(1, std::memory_order_acq_rel) & (N - 1);
-            auto& slot = slots[pos];
+            if (pop_once(out)) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(Config::QueueConfig::YIELD_SLEEP_MS));
+        }
+        return false;
+    }
 
-            uint8_t expected = FULL;
-            if (slot.state.compare_exchange_strong(expected, READING, std::memory_order_acquire)) {
+    // Non-blocking dequeue: fails at once when the queue is empty, for a
+    // consumer that has other queues to look at.
+    bool try_dequeue(T& out) { return pop_once(out); }
+
+    // Frees the slots behind head that a consumer claimed but never released,
+    // i.e. one that died inside dequeue(); their items are lost. Only safe
+    // while no other consumer uses the queue. `count` may stay one high per
+    // freed slot, which size_approx() tolerates. Returns the slots freed.
+    size_t release_abandoned() {
+        size_t pos = head.load(std::memory_order_acquire);
+        size_t freed = 0;
+        for (size_t p = pos > N ? pos - N : 0; p < pos; ++p) {
+            size_t claimed = p + 1;
+            if (slots[p & (N - 1)].seq.compare_exchange_strong(claimed, p + N, std::memory_order_release)) ++freed;
+        }
+        return freed;
+    }
+
+private:
+    // Returns false if the slot at tail is still occupied (queue full or its
+    // consumer not finished); races with other producers are retried here.
+    bool push_once(const T& item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& slot = slots[pos & (N - 1)];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff < 0) return false;
+            if (diff > 0) {
+                pos = tail.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.value = item;
+                count.fetch_add(1, std::memory_order_relaxed);   // before publishing so a dequeue never underflows it
+                slot.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    // Returns false if the slot at head holds nothing yet (queue empty or its
+    // producer not finished).
+    bool pop_once(T& out) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& slot = slots[pos & (N - 1)];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff < 0) return false;
+            if (diff > 0) {
+                pos = head.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
                 out = slot.value;
-                slot.state.store(EMPTY, std::memory_order_release);
+                count.fetch_sub(1, std::memory_order_relaxed);
+                slot.seq.store(pos + N, std::memory_order_release);
                 return true;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(Config::QueueConfig::YIELD_SLEEP_MS));
         }
-        return false;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <openssl/sha.h>
+#include "async_logger.hpp"
+#include "timestamp.hpp"
+
+// Aho-Corasick automaton over the agent's patterns, kept as one flat image in
+// which every link is an array index. The image is written to a cache file
+// and later mmapped read-only as is, so a start with unchanged patterns does
+// no building at all and agents on one host share the page-cache pages.
+//
+// Image layout (sections 8-byte aligned, native byte order):
+//   AutomatonHeader
+//   State    states[state_count + 1]   edges of state s are [s.edge_begin,
+//                                      (s+1).edge_begin), outputs likewise
+//   uint32_t root_next[256]            complete goto function of the root
+//   uint8_t  edge_labels[edge_count]   sorted within each state
+//   uint32_t edge_targets[edge_count]
+//   uint32_t outputs[output_count]     pattern ids
+//
+// States are numbered breadth first, so the hot upper levels of the trie are
+// packed together and every failure link points to a lower number.
+
+constexpr char AUTOMATON_MAGIC[8] = {'R', 'T', 'S', 'A', 'A', 'C', 'M', '1'};
+constexpr uint32_t AUTOMATON_VERSION = 1;
+constexpr uint32_t AUTOMATON_BYTE_ORDER = 0x01020304;
+
+struct AutomatonHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint8_t key[SHA256_DIGEST_LENGTH];   // PatternAutomaton::key_for() of the patterns
+    uint32_t pattern_count;
+    uint32_t state_count;
+    uint32_t edge_count;
+    uint32_t output_count;
+    uint64_t states_offset;
+    uint64_t root_offset;
+    uint64_t labels_offset;
+    uint64_t targets_offset;
+    uint64_t outputs_offset;
+    uint64_t image_size;
+};
+
+class PatternAutomaton {
+public:
+    using Key = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct State {
+        uint32_t edge_begin;
+        uint32_t out_begin;
+        uint32_t fail;
+        uint32_t dict;   // nearest state on the failure chain with outputs, or NONE
+    };
+
+    // Identifies a pattern list (order matters: it assigns the ids).
+    static Key key_for(const std::vector<std::string>& patterns) {
+        std::string buf;
+        auto append_u32 = [&buf](uint32_t v) { buf.append(reinterpret_cast<const char*>(&v), sizeof(v)); };
+        append_u32(AUTOMATON_VERSION);
+        append_u32(static_cast<uint32_t>(patterns.size()));
+        for (const auto& p : patterns) {
+            append_u32(static_cast<uint32_t>(p.size()));
+            buf += p;
+        }
+        Key key;
+        SHA256(reinterpret_cast<const unsigned char*>(buf.data()), buf.size(), key.data());
+        return key;
+    }
+
+    // Compiles `patterns`; pattern i is reported as id i. Empty patterns never match.
+    static PatternAutomaton build(const std::vector<std::string>& patterns);
+
+    // Maps a cache file written by save() for `pattern_count` patterns.
+    // Returns nothing, with the reason in `why`, when it is missing, from
+    // another version or build, for other patterns, or malformed.
+    static std::optional<PatternAutomaton> open(const std::string& path, const Key& key, uint32_t pattern_count,
+                                                std::string& why);
+
+    // Writes the image to `path` atomically (temporary file, then rename), so
+    // agents that mapped the old file keep a consistent copy.
+    void save(const std::string& path) const {
+        std::string tmp = path + ".tmp." + std::to_string(getpid());
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if (!f) throw std::runtime_error("Cannot create " + tmp + ": " + strerror(errno));
+        bool ok = fwrite(base_, 1, size_, f) == size_;
+        ok = fclose(f) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            unlink(tmp.c_str());
+            throw std::runtime_error("Cannot write " + path);
+        }
+    }
+
+    // The automaton from `cache_path` when it was compiled from these
+    // patterns; otherwise builds it, refreshes the cache and maps that.
+    static PatternAutomaton load_or_build(const std::vector<std::string>& patterns, const std::string& cache_path) {
+        Key key = key_for(patterns);
+        const uint32_t count = static_cast<uint32_t>(patterns.size());
+        uint64_t start_ns = monotonic_ns();
+        std::string why = "no cache configured";
+        if (!cache_path.empty()) {
+            if (auto mapped = open(cache_path, key, count, why)) {
+                logger::info("PATTERNS", "{} patterns ready in {} ms (mapped {})", patterns.size(),
+                             (monotonic_ns() - start_ns) / 1e6, cache_path);
+                return std::move(*mapped);
+            }
+        }
+        PatternAutomaton built = build(patterns);
+        logger::info("PATTERNS", "{} patterns compiled into {} states in {} ms ({})", patterns.size(),
+                     built.state_count(), (monotonic_ns() - start_ns) / 1e6, why);
+        if (cache_path.empty()) return built;
+        try {
+            built.save(cache_path);
+            if (auto mapped = open(cache_path, key, count, why)) return std::move(*mapped);
+        } catch (const std::exception& e) {
+            logger::warn("PATTERNS", "Pattern cache not written: {}", e.what());
+        }
+        return built;
+    }
+
+    // Calls fn(pattern_id) for every occurrence of every pattern in `text`,
+    // in order of the position the occurrence ends at.
+    template<typename Fn>
+    void for_each_match(std::string_view text, Fn&& fn) const {
+        uint32_t s = 0;
+        for (unsigned char c : text) {
+            s = next(s, c);
+            uint32_t u = has_outputs(s) ? s : states_[s].dict;
+            for (; u != NONE; u = states_[u].dict)
+                for (uint32_t i = states_[u].out_begin; i < states_[u + 1].out_begin; ++i) fn(outputs_[i]);
+        }
+    }
+
+    uint32_t pattern_count() const { return header_->pattern_count; }
+    uint32_t state_count() const { return header_->state_count; }
+    size_t image_size() const { return size_; }
+
+private:
+    PatternAutomaton(std::shared_ptr<const void> storage, const uint8_t* base, size_t size)
+        : storage_(std::move(storage)), base_(base), size_(size) {
+        header_ = reinterpret_cast<const AutomatonHeader*>(base_);
+        states_ = reinterpret_cast<const State*>(base_ + header_->states_offset);
+        root_next_ = reinterpret_cast<const uint32_t*>(base_ + header_->root_offset);
+        labels_ = base_ + header_->labels_offset;
+        targets_ = reinterpret_cast<const uint32_t*>(base_ + header_->targets_offset);
+        outputs_ = reinterpret_cast<const uint32_t*>(base_ + header_->outputs_offset);
+    }
+
+    bool has_outputs(uint32_t s) const { return states_[s].out_begin != states_[s + 1].out_begin; }
+
+    uint32_t child(uint32_t s, uint8_t c) const {
+        const uint8_t* first = labels_ + states_[s].edge_begin;
+        const uint8_t* last = labels_ + states_[s + 1].edge_begin;
+        const uint8_t* it = last - first <= 8 ? std::find(first, last, c) : std::lower_bound(first, last, c);
+        return it != last && *it == c ? targets_[it - labels_] : NONE;
+    }
+
+    uint32_t next(uint32_t s, uint8_t c) const {
+        while (s != 0) {
+            uint32_t t = child(s, c);
+            if (t != NONE) return t;
+            s = states_[s].fail;
+        }
+        return root_next_[c];
+    }
+
+    static size_t align8(size_t n) { return (n + 7) & ~size_t{7}; }
+
+    std::shared_ptr<const void> storage_;   // heap image or mapping
+    const uint8_t* base_;
+    size_t size_;
+    const AutomatonHeader* header_;
+    const State* states_;
+    const uint32_t* root_next_;
+    const uint8_t* labels_;
+    const uint32_t* targets_;
+    const uint32_t* outputs_;
+};
+
+inline PatternAutomaton PatternAutomaton::build(const std::vector<std::string>& patterns) {
+    // Insert in sorted order so each pattern only adds the suffix it does not
+    // share with the previous one, and every node's children come out sorted.
+    std::vector<uint32_t> order(patterns.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return patterns[a] < patterns[b]; });
+
+    struct Edge {
+        uint32_t parent;
+        uint32_t child;
+        uint8_t label;
+    };
+    std::vector<Edge> edges;
+    std::vector<std::pair<uint32_t, uint32_t>> ends;   // (node, pattern id)
+    std::vector<uint32_t> path{0};                     // nodes along the previous pattern
+    uint32_t nodes = 1;
+    const std::string* prev = nullptr;
+    for (uint32_t id : order) {
+        const std::string& p = patterns[id];
+        if (p.empty()) continue;
+        size_t common = 0;
+        if (prev)
+            while (common < p.size() && common < prev->size() && p[common] == (*prev)[common]) ++common;
+        path.resize(common + 1);
+        for (size_t i = common; i < p.size(); ++i) {
+            edges.push_back(Edge{path.back(), nodes, static_cast<uint8_t>(p[i])});
+            path.push_back(nodes++);
+        }
+        ends.emplace_back(path.back(), id);
+        prev = &p;
+    }
+    if (nodes > NONE / 2) throw std::length_error("Pattern set too large for the automaton");
+
+    // Children of each node, by label (a stable counting sort by parent).
+    std::vector<uint32_t> child_begin(nodes + 1, 0);
+    for (const auto& e : edges) ++child_begin[e.parent + 1];
+    for (uint32_t n = 0; n < nodes; ++n) child_begin[n + 1] += child_begin[n];
+    std::vector<uint8_t> child_label(edges.size());
+    std::vector<uint32_t> child_node(edges.size());
+    {
+        std::vector<uint32_t> fill(child_begin.begin(), child_begin.end() - 1);
+        for (const auto& e : edges) {
+            child_label[fill[e.parent]] = e.label;
+            child_node[fill[e.parent]++] = e.child;
+        }
+    }
+    auto find_child = [&](uint32_t n, uint8_t c) {
+        auto first = child_label.begin() + child_begin[n], last = child_label.begin() + child_begin[n + 1];
+        auto it = std::lower_bound(first, last, c);
+        return it != last && *it == c ? child_node[it - child_label.begin()] : NONE;
+    };
+
+    std::vector<uint32_t> out_count(nodes, 0);
+    for (const auto& [n, id] : ends) ++out_count[n];
+
+    // Breadth-first: numbering, failure links and dictionary links.
+    std::vector<uint32_t> bfs{0};
+    bfs.reserve(nodes);
+    std::vector<uint32_t> fail(nodes, 0), dict(nodes, NONE);
+    for (size_t i = 0; i < bfs.size(); ++i) {
+        uint32_t s = bfs[i];
+        for (uint32_t k = child_begin[s]; k < child_begin[s + 1]; ++k) {
+            uint32_t t = child_node[k];
+            uint8_t c = child_label[k];
+            uint32_t f = 0;
+            if (s != 0) {
+                f = fail[s];
+                while (f != 0 && find_child(f, c) == NONE) f = fail[f];
+                uint32_t u = find_child(f, c);
+                f = u != NONE ? u : 0;
+            }
+            fail[t] = f;
+            dict[t] = out_count[f] ? f : dict[f];
+            bfs.push_back(t);
+        }
+    }
+    std::vector<uint32_t> rank(nodes);
+    for (uint32_t i = 0; i < nodes; ++i) rank[bfs[i]] = i;
+    std::sort(ends.begin(), ends.end(), [&](const auto& a, const auto& b) {
+        return rank[a.first] != rank[b.first] ? rank[a.first] < rank[b.first] : a.second < b.second;
+    });
+
+    AutomatonHeader h{};
+    memcpy(h.magic, AUTOMATON_MAGIC, sizeof(h.magic));
+    h.version = AUTOMATON_VERSION;
+    h.byte_order = AUTOMATON_BYTE_ORDER;
+    Key key = key_for(patterns);
+    memcpy(h.key, key.data(), key.size());
+    h.pattern_count = static_cast<uint32_t>(patterns.size());
+    h.state_count = nodes;
+    h.edge_count = static_cast<uint32_t>(edges.size());
+    h.output_count = static_cast<uint32_t>(ends.size());
+    h.states_offset = align8(sizeof(AutomatonHeader));
+    h.root_offset = align8(h.states_offset + sizeof(State) * (nodes + 1));
+    h.labels_offset = align8(h.root_offset + sizeof(uint32_t) * 256);
+    h.targets_offset = align8(h.labels_offset + h.edge_count);
+    h.outputs_offset = align8(h.targets_offset + sizeof(uint32_t) * h.edge_count);
+    h.image_size = align8(h.outputs_offset + sizeof(uint32_t) * h.output_count);
+
+    auto image = std::shared_ptr<uint64_t[]>(new uint64_t[h.image_size / 8]());
+    uint8_t* base = reinterpret_cast<uint8_t*>(image.get());
+    memcpy(base, &h, sizeof(h));
+    auto* states = reinterpret_cast<State*>(base + h.states_offset);
+    auto* root_next = reinterpret_cast<uint32_t*>(base + h.root_offset);
+    uint8_t* labels = base + h.labels_offset;
+    auto* targets = reinterpret_cast<uint32_t*>(base + h.targets_offset);
+    auto* outputs = reinterpret_cast<uint32_t*>(base + h.outputs_offset);
+
+    uint32_t edge_pos = 0, out_pos = 0;
+    size_t end_pos = 0;
+    for (uint32_t i = 0; i < nodes; ++i) {
+        uint32_t s = bfs[i];
+        states[i] = State{edge_pos, out_pos, rank[fail[s]], dict[s] == NONE ? NONE : rank[dict[s]]};
+        for (uint32_t k = child_begin[s]; k < child_begin[s + 1]; ++k, ++edge_pos) {
+            labels[edge_pos] = child_label[k];
+            targets[edge_pos] = rank[child_node[k]];
+        }
+        for (; end_pos < ends.size() && ends[end_pos].first == s; ++end_pos) outputs[out_pos++] = ends[end_pos].second;
+    }
+    states[nodes] = State{edge_pos, out_pos, 0, NONE};
+    for (int c = 0; c < 256; ++c) {
+        uint32_t t = find_child(0, static_cast<uint8_t>(c));
+        root_next[c] = t == NONE ? 0 : rank[t];
+    }
+    return PatternAutomaton(std::move(image), base, h.image_size);
+}
+
+inline std::optional<PatternAutomaton> PatternAutomaton::open(const std::string& path, const Key& key,
+                                                              uint32_t pattern_count, std::string& why) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        why = errno == ENOENT ? "no cache yet" : std::string("cannot open cache: ") + strerror(errno);
+        return std::nullopt;
+    }
+    struct stat st;
+    void* addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(AutomatonHeader))
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        why = "cache unreadable";
+        return std::nullopt;
+    }
+    const size_t size = st.st_size;
+    std::shared_ptr<const void> mapping(addr, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+    const auto* base = static_cast<const uint8_t*>(addr);
+    const auto& h = *reinterpret_cast<const AutomatonHeader*>(base);
+
+    if (memcmp(h.magic, AUTOMATON_MAGIC, sizeof(h.magic)) != 0 || h.version != AUTOMATON_VERSION ||
+        h.byte_order != AUTOMATON_BYTE_ORDER) {
+        why = "cache from another version";
+        return std::nullopt;
+    }
+    // The caller's count, not the file's, bounds the ids handed back.
+    if (memcmp(h.key, key.data(), key.size()) != 0 || h.pattern_count != pattern_count) {
+        why = "patterns changed";
+        return std::nullopt;
+    }
+    // Bounds first, then every index, so a damaged file cannot send a lookup
+    // out of the image or round a failure cycle.
+    auto section_ok = [&](uint64_t offset, uint64_t bytes) {
+        return offset % 8 == 0 && offset <= h.image_size && bytes <= h.image_size - offset;
+    };
+    bool ok = h.image_size == size && h.state_count > 0 && h.state_count < NONE &&
+              section_ok(h.states_offset, sizeof(State) * (uint64_t{h.state_count} + 1)) &&
+              section_ok(h.root_offset, sizeof(uint32_t) * 256) && section_ok(h.labels_offset, h.edge_count) &&
+              section_ok(h.targets_offset, sizeof(uint32_t) * uint64_t{h.edge_count}) &&
+              section_ok(h.outputs_offset, sizeof(uint32_t) * uint64_t{h.output_count});
+    if (ok) {
+        PatternAutomaton a(mapping, base, size);
+        const uint32_t n = h.state_count;
+        ok = a.states_[0].edge_begin == 0 && a.states_[0].out_begin == 0 && a.states_[n].edge_begin == h.edge_count &&
+             a.states_[n].out_begin == h.output_count;
+        for (uint32_t s = 0; ok && s < n; ++s) {
+            const State& st = a.states_[s];
+            ok = st.edge_begin <= a.states_[s + 1].edge_begin && st.out_begin <= a.states_[s + 1].out_begin &&
+                 (s == 0 ? st.fail == 0 : st.fail < s) && (st.dict == NONE || st.dict < s);
+        }
+        for (uint32_t e = 0; ok && e < h.edge_count; ++e) ok = a.targets_[e] < n;
+        for (uint32_t o = 0; ok && o < h.output_count; ++o) ok = a.outputs_[o] < h.pattern_count;
+        for (int c = 0; ok && c < 256; ++c) ok = a.root_next_[c] < n;
+        if (ok) return a;
+    }
+    why = "cache damaged";
+    return std::nullopt;
+}
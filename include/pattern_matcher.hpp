@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "async_logger.hpp"
+#include "pattern_automaton.hpp"
+#include "patterns.hpp"
+#include "regex_vm.hpp"
+#include "syslog_header.hpp"
+
+// Matches a parsed syslog line against a mixed list of literal and "re:"
+// regex rules, each scoped to one field of the line (PatternRule::field) and
+// optionally to a program or syslog severity.
+//
+// All literal work is done by one PatternAutomaton. Its atoms are the literal
+// rules plus the required literals factored out of every regex
+// (regex::Regex::required_literals()); a regex is searched only on lines in
+// which one of its literals occurred. Regexes with no required literal (e.g.
+// `re:^\d+$`) are searched on every line, so keep those rare. The automaton
+// scans only the fields some rule is scoped to, which with the default
+// (message) skips the timestamp, host and program.
+class PatternMatcher {
+public:
+    struct Stats {
+        uint64_t lines = 0;
+        uint64_t bytes_scanned = 0;
+        uint64_t regex_searches = 0;
+        uint64_t regex_matches = 0;
+    };
+
+    // Pattern ids are indices into `rules`, of which there may be at most
+    // MAX_PATTERNS. Regexes that do not compile are logged and never match.
+    PatternMatcher(const std::vector<PatternRule>& rules, const std::string& cache_path) {
+        if (rules.size() > MAX_PATTERNS)
+            throw std::invalid_argument(std::to_string(rules.size()) + " pattern rules, at most " +
+                                        std::to_string(MAX_PATTERNS) + " fit in an event");
+        std::vector<std::string> atoms;
+        for (uint32_t id = 0; id < rules.size(); ++id) {
+            const PatternRule& rule = rules[id];
+            scopes_.push_back(Scope{rule.field, rule.app, rule.max_syslog_severity});
+            if (!is_regex_pattern(rule.text)) {
+                atoms.push_back(rule.text);
+                atom_owner_.push_back(id);
+                atom_regex_.push_back(NONE);
+                scanned_[rule.field] = true;
+                continue;
+            }
+            try {
+                regexes_.emplace_back(std::string_view(rule.text).substr(REGEX_PATTERN_PREFIX.size()));
+            } catch (const std::exception& e) {
+                logger::error("PATTERNS", "Pattern {} skipped: {}", id, e.what());
+                continue;
+            }
+            const uint32_t r = static_cast<uint32_t>(regex_owner_.size());
+            regex_owner_.push_back(id);
+            const auto& literals = regexes_.back().required_literals();
+            if (literals.empty()) unfiltered_.push_back(r);
+            else scanned_[rule.field] = true;
+            for (const auto& lit : literals) {
+                atoms.push_back(lit);
+                atom_owner_.push_back(id);
+                atom_regex_.push_back(r);
+            }
+        }
+        regex_stamp_.assign(regexes_.size(), 0);
+        automaton_.emplace(PatternAutomaton::load_or_build(atoms, cache_path));
+        if (!regexes_.empty())
+            logger::info("PATTERNS", "{} regexes: {} prefiltered by literals, {} run on every line", regexes_.size(),
+                         regexes_.size() - unfiltered_.size(), unfiltered_.size());
+    }
+
+    // Calls fn(pattern_id) for every literal occurrence in the rule's field of
+    // the line, then once for each regex rule that matches its field.
+    template<typename Fn>
+    void for_each_match(const SyslogHeader& h, Fn&& fn) {
+        ++stats_.lines;
+        if (++stamp_ == 0) {
+            std::fill(regex_stamp_.begin(), regex_stamp_.end(), 0);
+            stamp_ = 1;
+        }
+        candidates_.clear();
+        for (size_t f = 0; f < SYSLOG_FIELD_COUNT; ++f) {
+            if (!scanned_[f]) continue;
+            std::string_view text = h.field(static_cast<SyslogField>(f));
+            stats_.bytes_scanned += text.size();
+            automaton_->for_each_match(text, [&](uint32_t atom) {
+                uint32_t id = atom_owner_[atom];
+                if (scopes_[id].field != f || !admits(id, h)) return;
+                uint32_t r = atom_regex_[atom];
+                if (r == NONE) {
+                    fn(id);
+                } else if (regex_stamp_[r] != stamp_) {
+                    regex_stamp_[r] = stamp_;
+                    candidates_.push_back(r);
+                }
+            });
+        }
+        for (uint32_t r : unfiltered_)
+            if (admits(regex_owner_[r], h)) candidates_.push_back(r);
+        for (uint32_t r : candidates_) {
+            uint32_t id = regex_owner_[r];
+            ++stats_.regex_searches;
+            if (regexes_[r].search(h.field(scopes_[id].field))) {
+                ++stats_.regex_matches;
+                fn(id);
+            }
+        }
+    }
+
+    template<typename Fn>
+    void for_each_match(std::string_view line, Fn&& fn) {
+        for_each_match(parse_syslog_header(line), fn);
+    }
+
+    size_t regex_count() const { return regexes_.size(); }
+    size_t unfiltered_count() const { return unfiltered_.size(); }
+    const Stats& stats() const { return stats_; }
+
+private:
+    static constexpr uint32_t NONE = PatternAutomaton::NONE;
+
+    struct Scope {
+        SyslogField field;
+        std::string app;
+        int max_syslog_severity;
+    };
+
+    bool admits(uint32_t id, const SyslogHeader& h) const {
+        const Scope& s = scopes_[id];
+        if (!s.app.empty() && h.app != s.app) return false;
+        return s.max_syslog_severity >= 7 || (h.priority >= 0 && h.syslog_severity() <= s.max_syslog_severity);
+    }
+
+    std::optional<PatternAutomaton> automaton_;
+    std::vector<Scope> scopes_;          // by pattern id
+    bool scanned_[SYSLOG_FIELD_COUNT] = {};
+    std::vector<uint32_t> atom_owner_;   // atom -> pattern id
+    std::vector<uint32_t> atom_regex_;   // atom -> regex index, NONE for literal patterns
+    std::vector<regex::Regex> regexes_;
+    std::vector<uint32_t> regex_owner_;  // regex index -> pattern id
+    std::vector<uint32_t> unfiltered_;   // regexes without a required literal
+
+    std::vector<uint32_t> regex_stamp_;  // line a regex last became a candidate on
+    std::vector<uint32_t> candidates_;
+    uint32_t stamp_ = 0;
+    Stats stats_;
+};
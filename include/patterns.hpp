@@ -1,27 +1,111 @@
 #pragma once
 
 #include <vector>
+#include <stdexcept>
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <utility>
+#include "event.hpp"
+#include "syslog_header.hpp"
 #include "config.hpp"
 
-inline std::vector<std::string> load_patterns(const std::string &filepath = "")
+struct PatternRule {
+    std::string text;
+    uint8_t severity = SEVERITY_NORMAL;   // Severity
+    SyslogField field = FIELD_MESSAGE;    // part of the line the text is searched in
+    std::string app;                      // only lines from this program; empty = any
+    int max_syslog_severity = 7;          // only lines with a PRI at least this severe; 7 = any line
+};
+
+inline SyslogField default_pattern_field() {
+    static bool warned = false;
+    SyslogField f = FIELD_MESSAGE;
+    if (!syslog_field_from_string(Config::patterns.default_field, f) && !std::exchange(warned, true))
+        std::cerr << "Warning: unknown patterns.default_field '" << Config::patterns.default_field
+                  << "', searching the message.\n";
+    return f;
+}
+
+// Applies one "@key=value" scope qualifier; false when it is not one.
+inline bool parse_pattern_scope(std::string_view q, PatternRule& rule) {
+    if (q.substr(0, 5) == "@app=" && q.size() > 5) {
+        rule.app = std::string(q.substr(5));
+        return true;
+    }
+    if (q.substr(0, 4) == "@in=") return syslog_field_from_string(q.substr(4), rule.field);
+    if (q.substr(0, 6) == "@sev<=") return syslog_severity_from_string(q.substr(6), rule.max_syslog_severity);
+    return false;
+}
+
+// A pattern text starting with "re:" is a regular expression (regex_vm.hpp
+// syntax) rather than a literal; the prefix stays in the text so the reader
+// can name the rule.
+constexpr std::string_view REGEX_PATTERN_PREFIX = "re:";
+
+inline bool is_regex_pattern(std::string_view text) { return text.substr(0, REGEX_PATTERN_PREFIX.size()) == REGEX_PATTERN_PREFIX; }
+
+// Splits an optional leading "[severity]" tag and then any scope qualifiers
+// off a pattern line:
+//   @app=NAME       only lines logged by program NAME
+//   @in=FIELD       search message (default: patterns.default_field), line,
+//                   host or app
+//   @sev<=LEVEL     only lines whose PRI is LEVEL (emerg ... debug) or more
+//                   severe; lines without a PRI never match
+// e.g. "[high] @app=sshd re:Failed password for \S+". An unknown tag or
+// qualifier is kept as part of the pattern text.
+inline PatternRule parse_pattern_rule(const std::string& line)
 {
-    std::vector<std::string> patterns;
-    
+    PatternRule rule;
+    rule.text = line;
+    rule.field = default_pattern_field();
+    size_t start = 0;
+    if (!line.empty() && line[0] == '[') {
+        size_t close = line.find(']');
+        uint8_t severity;
+        if (close == std::string::npos) return rule;
+        if (!severity_from_string(std::string_view(line).substr(1, close - 1), severity)) {
+            std::cerr << "Warning: unknown severity in pattern '" << line << "', treating it as literal text.\n";
+            return rule;
+        }
+        rule.severity = severity;
+        start = line.find_first_not_of(' ', close + 1);
+    }
+    while (start != std::string::npos && line[start] == '@') {
+        size_t end = line.find(' ', start);
+        std::string_view q = std::string_view(line).substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (!parse_pattern_scope(q, rule)) {
+            std::cerr << "Warning: unknown qualifier '" << q << "' in pattern '" << line << "', treating it as literal text.\n";
+            break;
+        }
+        start = end == std::string::npos ? end : line.find_first_not_of(' ', end);
+    }
+    rule.text = start == std::string::npos ? std::string() : line.substr(start);
+    return rule;
+}
+
+// Throws when the file holds more than MAX_PATTERNS rules, whose ids would
+// not fit in an event.
+inline std::vector<PatternRule> load_pattern_rules(const std::string &filepath = "")
+{
+    std::vector<PatternRule> rules;
+    auto add = [&rules](const std::string& line) {
+        PatternRule rule = parse_pattern_rule(line);
+        if (!rule.text.empty()) rules.push_back(std::move(rule));
+    };
+
     // Use config path if no filepath provided
     std::string actual_filepath = filepath;
     if (actual_filepath.empty()) {
         actual_filepath = Config::patterns.pattern_file_path;
     }
-    
+
     std::ifstream file(actual_filepath);
     if (!file)
     {
         std::cerr << "Warning: patterns file '" << actual_filepath << "' not found. Using default patterns.\n";
-        patterns = Config::patterns.default_patterns;
-        return patterns;
+        for (const auto& p : Config::patterns.default_patterns) add(p);
+        return rules;
     }
 
     std::string line;
@@ -29,14 +113,25 @@ inline std::vector<std::string> load_patterns(const std::string &filepath = "")
     {
         if (!line.empty())
         {
-            patterns.push_back(line);
+            add(line);
         }
     }
 
-    if (patterns.empty())
+    if (rules.empty())
     {
         std::cerr << "Warning: patterns file '" << actual_filepath << "' is empty. Using default patterns.\n";
-        patterns = Config::patterns.default_patterns;
+        for (const auto& p : Config::patterns.default_patterns) add(p);
     }
+    if (rules.size() > MAX_PATTERNS)
+        throw std::runtime_error("patterns file '" + actual_filepath + "' has " + std::to_string(rules.size()) +
+                                 " rules, at most " + std::to_string(MAX_PATTERNS) + " are supported");
+    return rules;
+}
+
+// Pattern texts without severity tags, indexed like load_pattern_rules().
+inline std::vector<std::string> load_patterns(const std::string &filepath = "")
+{
+    std::vector<std::string> patterns;
+    for (auto& rule : load_pattern_rules(filepath)) patterns.push_back(std::move(rule.text));
     return patterns;
-}
\ No newline at end of file
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "event.hpp"
+#include "shared_memory.hpp"
+#include "thread_profile.hpp"
+#include "async_logger.hpp"
+#include "config.hpp"
+
+constexpr std::string_view QUEUE_SEGMENT_SUFFIX = ".queue";
+
+// The queue this process produces into: queue_file_path, or its own segment
+// in queue_dir named after the agent (default: the host name).
+inline std::string agent_queue_path() {
+    const auto& c = Config::shared_memory;
+    if (c.queue_dir.empty()) return c.queue_file_path;
+    std::string name = c.agent_name;
+    if (name.empty()) {
+        char host[256] = {};
+        name = gethostname(host, sizeof(host) - 1) == 0 && host[0] ? host : "agent";
+    }
+    return c.queue_dir + "/" + name + std::string(QUEUE_SEGMENT_SUFFIX);
+}
+
+// An exclusive flock on the queue file, held by its producer for as long as
+// it writes into it. A second agent that resolves to the same path (two
+// agents on one host without agent_name) fails here instead of
+// re-initialising a queue the first one is still using. Take it before
+// SharedMemory creates or sizes the file.
+class QueueOwnerLock {
+public:
+    explicit QueueOwnerLock(const std::string& path) {
+        fd_ = ::open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, Config::SharedMemoryConfig::FILE_PERMISSIONS);
+        if (fd_ < 0) throw std::runtime_error("Cannot open queue " + path + ": " + strerror(errno));
+        if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+            int err = errno;
+            ::close(fd_);
+            if (err == EWOULDBLOCK)
+                throw std::runtime_error("Queue " + path + " is in use by another agent or replay (under queue_dir, "
+                                         "give each agent its own shared_memory.agent_name)");
+            throw std::runtime_error("Cannot lock queue " + path + ": " + strerror(err));
+        }
+    }
+    ~QueueOwnerLock() { ::close(fd_); }
+    QueueOwnerLock(const QueueOwnerLock&) = delete;
+    QueueOwnerLock& operator=(const QueueOwnerLock&) = delete;
+
+private:
+    int fd_;
+};
+
+// The agent queues a reader drains. Without queue_dir that is
+// queue_file_path, attached once. With it, every "<agent>.queue" file in the
+// directory: scan() attaches new segments, and a segment whose file was
+// removed or replaced is drained and then detached. Workers hold a
+// snapshot() while they dequeue, so a detached segment is unmapped only once
+// the last worker has let go of it.
+//
+// scan() runs on one thread; snapshot() and the stats may be read from any.
+class QueueSegments {
+public:
+    struct Segment {
+        Segment(const std::string& path, const std::string* agent) : shm(path, false), queue(shm.get()), agent(agent) {}
+
+        SharedMemory<QueueType> shm;
+        QueueType* queue;
+        const std::string* agent;   // interned agent name; nullptr without queue_dir
+        std::string path;
+        dev_t dev = 0;
+        ino_t ino = 0;
+        bool draining = false;      // file gone; detached once empty
+    };
+    using Snapshot = std::vector<std::shared_ptr<Segment>>;
+
+    struct Stats {
+        std::atomic<uint64_t> attached{0};
+        std::atomic<uint64_t> detached{0};
+    };
+
+    QueueSegments() : current_(std::make_shared<const Snapshot>()) {}
+
+    // Attaches queue_file_path, throwing if it cannot, or creates and scans
+    // queue_dir.
+    void open() {
+        dir_ = Config::shared_memory.queue_dir;
+        if (dir_.empty()) {
+            auto seg = std::make_shared<Segment>(Config::shared_memory.queue_file_path, nullptr);
+            seg->path = Config::shared_memory.queue_file_path;
+            prepare(*seg);
+            current_.store(std::make_shared<const Snapshot>(Snapshot{seg}), std::memory_order_release);
+            stats_.attached.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::filesystem::create_directories(dir_);
+        scan();
+    }
+
+    void scan() {
+        if (dir_.empty()) return;
+        auto current = snapshot();
+        Snapshot next;
+        bool changed = false;
+        for (const auto& seg : *current) {
+            struct stat st;
+            bool present = stat(seg->path.c_str(), &st) == 0 && st.st_dev == seg->dev && st.st_ino == seg->ino;
+            if (!present && !seg->draining) {
+                // Wait one more scan before detaching: the agent may still
+                // be writing its last events.
+                seg->draining = true;
+                logger::info("QUEUE", "Agent {} left, draining {} events", *seg->agent, seg->queue->size_approx());
+            } else if (seg->draining && seg->queue->size_approx() == 0) {
+                logger::info("QUEUE", "Detached agent {}", *seg->agent);
+                stats_.detached.fetch_add(1, std::memory_order_relaxed);
+                changed = true;
+                continue;
+            }
+            next.push_back(seg);
+        }
+
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+            const auto& path = entry.path();
+            if (path.extension() != QUEUE_SEGMENT_SUFFIX) continue;
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) continue;
+            bool known = false;
+            for (const auto& seg : next)
+                known |= !seg->draining && seg->dev == st.st_dev && seg->ino == st.st_ino;
+            if (known) continue;
+            // An agent sizes its segment right after creating it.
+            if (static_cast<size_t>(st.st_size) != sizeof(QueueType)) {
+                if (rejected_.insert(path.string()).second)
+                    logger::warn("QUEUE", "Ignoring {}: {} bytes, expected {}", path.string(), st.st_size,
+                                 sizeof(QueueType));
+                continue;
+            }
+            try {
+                auto seg = std::make_shared<Segment>(path.string(), intern(path.stem().string()));
+                seg->path = path.string();
+                seg->dev = st.st_dev;
+                seg->ino = st.st_ino;
+                prepare(*seg);
+                next.push_back(std::move(seg));
+                rejected_.erase(path.string());
+                stats_.attached.fetch_add(1, std::memory_order_relaxed);
+                changed = true;
+                logger::info("QUEUE", "Attached agent {} ({} segments)", *next.back()->agent, next.size());
+            } catch (const std::exception& e) {
+                logger::warn("QUEUE", "Attaching {} failed: {}", path.string(), e.what());
+            }
+        }
+        if (ec) logger::warn("QUEUE", "Scanning {} failed: {}", dir_, ec.message());
+        if (changed || next.size() != current->size())
+            current_.store(std::make_shared<const Snapshot>(std::move(next)), std::memory_order_release);
+    }
+
+    std::shared_ptr<const Snapshot> snapshot() const { return current_.load(std::memory_order_acquire); }
+
+    // Events waiting in all attached segments.
+    size_t backlog() const {
+        size_t n = 0;
+        for (const auto& seg : *snapshot()) n += seg->queue->size_approx();
+        return n;
+    }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    // This reader is the segment's only consumer, so a slot still claimed by
+    // a consumer belongs to a reader that died mid-dequeue.
+    static void prepare(Segment& seg) {
+        if (Config::threads.prefault_queue) thread_profile::prefault(seg.queue, sizeof(QueueType));
+        if (size_t freed = seg.queue->release_abandoned())
+            logger::warn("QUEUE", "Freed {} slots left claimed by a previous reader in {}", freed, seg.path);
+    }
+
+    // Names outlive their segments: records in flight point at them.
+    const std::string* intern(const std::string& name) {
+        for (const auto& n : names_)
+            if (n == name) return &n;
+        return &names_.emplace_back(name);
+    }
+
+    std::string dir_;
+    std::atomic<std::shared_ptr<const Snapshot>> current_;
+    std::deque<std::string> names_;
+    std::unordered_set<std::string> rejected_;
+    Stats stats_;
+};
@@ -0,0 +1,540 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A small regular-expression engine for syslog rules: the pattern is compiled
+// to a Thompson NFA and searched with a Pike VM, so time is linear in the line
+// length times the program size and no input can make it backtrack.
+//
+// Syntax: literals, `.`, `[...]` / `[^...]` with ranges, `\d \w \s` and their
+// negations, `\t \n \r \xHH`, escaped punctuation, `^` `$`, `(...)`, `(?:...)`,
+// `|`, and the quantifiers `* + ? {m} {m,} {m,n}` (a trailing `?` is accepted
+// and ignored: only whether a line matches matters). Matching is on bytes and
+// case sensitive. Backreferences, lookaround and word boundaries are rejected.
+//
+// required_literals() factors the pattern into strings at least one of which
+// every match contains, for the literal prefilter (see PatternMatcher).
+namespace regex {
+
+using ByteSet = std::array<uint64_t, 4>;
+
+inline void set_add(ByteSet& s, uint8_t c) { s[c >> 6] |= uint64_t{1} << (c & 63); }
+inline bool set_has(const ByteSet& s, uint8_t c) { return (s[c >> 6] >> (c & 63)) & 1; }
+inline size_t set_count(const ByteSet& s) {
+    size_t n = 0;
+    for (uint64_t w : s) n += __builtin_popcountll(w);
+    return n;
+}
+
+namespace detail {
+
+constexpr int REPEAT_LIMIT = 1000;
+constexpr size_t PROGRAM_LIMIT = 20000;   // instructions
+constexpr size_t MAX_EXACT = 16;          // strings tracked per node while factoring
+constexpr size_t MAX_CLASS_EXACT = 4;     // classes up to this size expand into literals
+constexpr size_t MAX_REQUIRED = 64;
+
+struct Node {
+    enum Kind : uint8_t { Empty, Byte, Set, Begin, End, Concat, Alt, Repeat };
+    explicit Node(Kind k = Empty) : kind(k) {}
+    Kind kind;
+    uint8_t byte = 0;
+    ByteSet set{};
+    int min = 0, max = 0;   // Repeat; max -1 = unbounded
+    std::vector<Node> children;
+};
+
+class Parser {
+public:
+    explicit Parser(std::string_view p) : p_(p) {}
+
+    Node parse() {
+        Node n = alternation();
+        if (pos_ < p_.size()) fail("unmatched ')'");
+        return n;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::invalid_argument("regex '" + std::string(p_) + "': " + what + " at offset " + std::to_string(pos_));
+    }
+    bool more() const { return pos_ < p_.size(); }
+    bool eat(char c) {
+        if (!more() || p_[pos_] != c) return false;
+        ++pos_;
+        return true;
+    }
+
+    Node alternation() {
+        Node first = concat();
+        if (!more() || p_[pos_] != '|') return first;
+        Node alt{Node::Alt};
+        alt.children.push_back(std::move(first));
+        while (eat('|')) alt.children.push_back(concat());
+        return alt;
+    }
+
+    Node concat() {
+        Node c{Node::Concat};
+        while (more() && p_[pos_] != '|' && p_[pos_] != ')') c.children.push_back(repeat());
+        if (c.children.empty()) return Node{Node::Empty};
+        if (c.children.size() == 1) return std::move(c.children[0]);
+        return c;
+    }
+
+    Node repeat() {
+        Node atom = this->atom();
+        for (;;) {
+            int min, max;
+            if (eat('*')) min = 0, max = -1;
+            else if (eat('+')) min = 1, max = -1;
+            else if (eat('?')) min = 0, max = 1;
+            else if (!braces(min, max)) break;
+            eat('?');
+            Node r{Node::Repeat};
+            r.min = min;
+            r.max = max;
+            r.children.push_back(std::move(atom));
+            atom = std::move(r);
+        }
+        return atom;
+    }
+
+    // {m}, {m,} or {m,n}; anything else leaves `{` to be read as a literal.
+    bool braces(int& min, int& max) {
+        if (!more() || p_[pos_] != '{') return false;
+        size_t p = pos_ + 1;
+        auto number = [&](int& out) {
+            size_t start = p;
+            out = 0;
+            while (p < p_.size() && p_[p] >= '0' && p_[p] <= '9' && out <= REPEAT_LIMIT) out = out * 10 + (p_[p++] - '0');
+            return p > start;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (p < p_.size() && p_[p] == ',') {
+            ++p;
+            if (!number(max)) max = -1;
+        }
+        if (p >= p_.size() || p_[p] != '}') return false;
+        pos_ = p + 1;
+        if (min > REPEAT_LIMIT || max > REPEAT_LIMIT || (max != -1 && max < min)) fail("bad repetition count");
+        return true;
+    }
+
+    Node atom() {
+        char c = p_[pos_++];
+        switch (c) {
+            case '(': {
+                if (p_.substr(pos_, 2) == "?:") pos_ += 2;
+                else if (more() && p_[pos_] == '?') fail("unsupported group");
+                Node n = alternation();
+                if (!eat(')')) fail("missing ')'");
+                return n;
+            }
+            case '.': {
+                Node n{Node::Set};
+                n.set = {~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}, ~uint64_t{0}};
+                n.set[0] &= ~(uint64_t{1} << '\n');
+                return n;
+            }
+            case '^': return Node{Node::Begin};
+            case '$': return Node{Node::End};
+            case '[': return byte_class();
+            case '\\': return escape();
+            case '*':
+            case '+':
+            case '?': --pos_; fail("nothing to repeat");
+            default: {
+                Node n{Node::Byte};
+                n.byte = static_cast<uint8_t>(c);
+                return n;
+            }
+        }
+    }
+
+    // After a backslash: a single byte or a class.
+    Node escape() {
+        if (!more()) fail("trailing backslash");
+        char c = p_[pos_++];
+        Node n{Node::Set};
+        auto range = [&n](int lo, int hi) {
+            for (int b = lo; b <= hi; ++b) set_add(n.set, static_cast<uint8_t>(b));
+        };
+        switch (c) {
+            case 'd': case 'D': range('0', '9'); break;
+            case 'w': case 'W': range('0', '9'); range('a', 'z'); range('A', 'Z'); set_add(n.set, '_'); break;
+            case 's': case 'S': for (char s : {' ', '\t', '\n', '\r', '\f', '\v'}) set_add(n.set, s); break;
+            default: {
+                Node b{Node::Byte};
+                if (c == 't') b.byte = '\t';
+                else if (c == 'n') b.byte = '\n';
+                else if (c == 'r') b.byte = '\r';
+                else if (c == 'x') b.byte = hex_byte();
+                else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+                    fail(std::string("unsupported escape \\") + c);
+                else b.byte = static_cast<uint8_t>(c);
+                return b;
+            }
+        }
+        if (c == 'D' || c == 'W' || c == 'S')
+            for (auto& w : n.set) w = ~w;
+        return n;
+    }
+
+    uint8_t hex_byte() {
+        int v = 0;
+        for (int i = 0; i < 2; ++i) {
+            if (!more() || !isxdigit(static_cast<unsigned char>(p_[pos_]))) fail("bad \\x escape");
+            char h = p_[pos_++];
+            v = v * 16 + (h <= '9' ? h - '0' : (h | 0x20) - 'a' + 10);
+        }
+        return static_cast<uint8_t>(v);
+    }
+
+    Node byte_class() {
+        Node n{Node::Set};
+        bool negate = eat('^');
+        bool first = true;
+        while (more() && (p_[pos_] != ']' || first)) {
+            first = false;
+            ByteSet item{};
+            int lo = -1;
+            if (p_[pos_] == '\\') {
+                ++pos_;
+                Node e = escape();
+                if (e.kind == Node::Set) {
+                    for (size_t i = 0; i < 4; ++i) n.set[i] |= e.set[i];
+                    continue;
+                }
+                lo = e.byte;
+            } else {
+                lo = static_cast<uint8_t>(p_[pos_++]);
+            }
+            int hi = lo;
+            if (pos_ + 1 < p_.size() && p_[pos_] == '-' && p_[pos_ + 1] != ']') {
+                ++pos_;
+                if (p_[pos_] == '\\') {
+                    ++pos_;
+                    Node e = escape();
+                    if (e.kind != Node::Byte) fail("bad class range");
+                    hi = e.byte;
+                } else {
+                    hi = static_cast<uint8_t>(p_[pos_++]);
+                }
+                if (hi < lo) fail("bad class range");
+            }
+            for (int b = lo; b <= hi; ++b) set_add(item, static_cast<uint8_t>(b));
+            for (size_t i = 0; i < 4; ++i) n.set[i] |= item[i];
+        }
+        if (!eat(']')) fail("missing ']'");
+        if (negate)
+            for (auto& w : n.set) w = ~w;
+        return n;
+    }
+
+    std::string_view p_;
+    size_t pos_ = 0;
+};
+
+// --- Literal factoring ---
+
+struct Info {
+    std::optional<std::vector<std::string>> exact;   // every string the node can match, when few
+    std::vector<std::string> required;               // one of these is in every match; empty = unknown
+};
+
+inline bool has_empty(const std::vector<std::string>& v) {
+    return std::any_of(v.begin(), v.end(), [](const std::string& s) { return s.empty(); });
+}
+
+inline size_t min_length(const std::vector<std::string>& v) {
+    size_t m = SIZE_MAX;
+    for (const auto& s : v) m = std::min(m, s.size());
+    return v.empty() ? 0 : m;
+}
+
+// Longer shortest literal first (more selective), then fewer alternatives.
+inline bool more_selective(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    if (a.empty() || has_empty(a)) return false;
+    if (b.empty()) return true;
+    if (min_length(a) != min_length(b)) return min_length(a) > min_length(b);
+    return a.size() < b.size();
+}
+
+inline std::vector<std::string> unique(std::vector<std::string> v) {
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    return v;
+}
+
+inline std::vector<std::string> cross(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    std::vector<std::string> out;
+    for (const auto& x : a)
+        for (const auto& y : b) out.push_back(x + y);
+    return unique(std::move(out));
+}
+
+// The best requirement a node offers on its own.
+inline std::vector<std::string> requirement(const Info& i) {
+    if (i.exact && !has_empty(*i.exact) && more_selective(*i.exact, i.required)) return *i.exact;
+    return i.required;
+}
+
+inline Info analyze(const Node& n) {
+    Info out;
+    switch (n.kind) {
+        case Node::Empty:
+        case Node::Begin:
+        case Node::End:
+            out.exact = std::vector<std::string>{""};
+            break;
+        case Node::Byte:
+            out.exact = std::vector<std::string>{std::string(1, static_cast<char>(n.byte))};
+            break;
+        case Node::Set:
+            if (set_count(n.set) <= MAX_CLASS_EXACT) {
+                out.exact.emplace();
+                for (int b = 0; b < 256; ++b)
+                    if (set_has(n.set, static_cast<uint8_t>(b))) out.exact->push_back(std::string(1, static_cast<char>(b)));
+            }
+            break;
+        case Node::Concat: {
+            // Adjacent exact parts combine into longer literals; the most
+            // selective run or child requirement wins.
+            std::optional<std::vector<std::string>> run = std::vector<std::string>{""};
+            bool split = false;
+            auto consider = [&out](const std::vector<std::string>& cand) {
+                if (more_selective(cand, out.required)) out.required = cand;
+            };
+            for (const auto& child : n.children) {
+                Info ci = analyze(child);
+                if (run && ci.exact && run->size() * ci.exact->size() <= MAX_EXACT) {
+                    run = cross(*run, *ci.exact);
+                    continue;
+                }
+                if (run) consider(*run);
+                consider(ci.required);
+                run = ci.exact;
+                split = true;
+            }
+            if (run) consider(*run);
+            if (!split) out.exact = run;
+            break;
+        }
+        case Node::Alt: {
+            std::vector<std::string> exact, required;
+            bool all_exact = true, all_required = true;
+            for (const auto& child : n.children) {
+                Info ci = analyze(child);
+                if (ci.exact) exact.insert(exact.end(), ci.exact->begin(), ci.exact->end());
+                else all_exact = false;
+                std::vector<std::string> r = requirement(ci);
+                if (r.empty()) all_required = false;
+                else required.insert(required.end(), r.begin(), r.end());
+            }
+            if (all_exact && (exact = unique(std::move(exact))).size() <= MAX_EXACT) out.exact = exact;
+            if (all_required && (required = unique(std::move(required))).size() <= MAX_REQUIRED) out.required = required;
+            break;
+        }
+        case Node::Repeat: {
+            Info ci = analyze(n.children[0]);
+            // Up to `min` consecutive copies of the child, as far as MAX_EXACT
+            // allows; `copies` says how many were crossed.
+            std::vector<std::string> run{""};
+            int copies = 0;
+            if (ci.exact)
+                for (; copies < n.min && run.size() * ci.exact->size() <= MAX_EXACT; ++copies) run = cross(run, *ci.exact);
+            if (n.min >= 1) {
+                // Every match holds `min` copies, so any shorter run of them too.
+                out.required = requirement(ci);
+                if (copies >= 1 && !has_empty(run) && more_selective(run, out.required)) out.required = run;
+            }
+            if (ci.exact && n.min == 0 && n.max == 1 && ci.exact->size() + 1 <= MAX_EXACT) {
+                out.exact = *ci.exact;
+                out.exact->push_back("");
+                out.exact = unique(std::move(*out.exact));
+            } else if (ci.exact && n.min == n.max && copies == n.min) {
+                // Only a full set of copies is every string the node matches.
+                out.exact = run;
+            }
+            break;
+        }
+    }
+    return out;
+}
+
+} // namespace detail
+
+class Regex {
+public:
+    explicit Regex(std::string_view pattern) : pattern_(pattern) {
+        detail::Node root = detail::Parser(pattern).parse();
+        detail::Info info = detail::analyze(root);
+        required_ = detail::requirement(info);
+        emit(root);
+        push(Inst{Op::Match});
+        anchored_ = !prog_.empty() && prog_[0].op == Op::Begin;
+        mark_.assign(prog_.size(), 0);
+    }
+
+    const std::string& pattern() const { return pattern_; }
+
+    // Strings of which every match contains at least one; empty when the
+    // pattern can match without any fixed text (e.g. `\d+`).
+    const std::vector<std::string>& required_literals() const { return required_; }
+
+    size_t program_size() const { return prog_.size(); }
+
+    // True when the pattern matches anywhere in `text`. Not reentrant: the
+    // thread lists are reused between calls.
+    bool search(std::string_view text) const {
+        clist_.clear();
+        next_generation();
+        for (size_t i = 0;; ++i) {
+            if ((!anchored_ || i == 0) && add(clist_, 0, i, text)) return true;
+            if (i == text.size() || (clist_.empty() && anchored_)) return false;
+            if (clist_.empty()) {
+                next_generation();
+                continue;
+            }
+            const uint8_t c = static_cast<uint8_t>(text[i]);
+            nlist_.clear();
+            next_generation();
+            for (uint32_t pc : clist_) {
+                const Inst& in = prog_[pc];
+                bool step = in.op == Op::Byte ? in.byte == c : set_has(sets_[in.arg], c);
+                if (step && add(nlist_, pc + 1, i + 1, text)) return true;
+            }
+            std::swap(clist_, nlist_);
+        }
+    }
+
+private:
+    enum class Op : uint8_t { Byte, Set, Split, Jmp, Begin, End, Match };
+    struct Inst {
+        Op op;
+        uint8_t byte = 0;
+        uint32_t arg = 0;    // Set: index into sets_; Split/Jmp: target
+        uint32_t alt = 0;    // Split: second target
+
+        Inst(Op o, uint8_t b = 0, uint32_t a = 0) : op(o), byte(b), arg(a) {}
+    };
+
+    uint32_t pc() const { return static_cast<uint32_t>(prog_.size()); }
+
+    uint32_t push(Inst in) {
+        if (prog_.size() >= detail::PROGRAM_LIMIT) throw std::invalid_argument("regex '" + pattern_ + "' is too large");
+        prog_.push_back(in);
+        return pc() - 1;
+    }
+
+    void emit(const detail::Node& n) {
+        using detail::Node;
+        switch (n.kind) {
+            case Node::Empty: break;
+            case Node::Byte: push(Inst{Op::Byte, n.byte}); break;
+            case Node::Set:
+                sets_.push_back(n.set);
+                push(Inst{Op::Set, 0, static_cast<uint32_t>(sets_.size() - 1)});
+                break;
+            case Node::Begin: push(Inst{Op::Begin}); break;
+            case Node::End: push(Inst{Op::End}); break;
+            case Node::Concat:
+                for (const auto& c : n.children) emit(c);
+                break;
+            case Node::Alt: {
+                std::vector<uint32_t> exits;
+                for (size_t i = 0; i < n.children.size(); ++i) {
+                    if (i + 1 == n.children.size()) {
+                        emit(n.children[i]);
+                        break;
+                    }
+                    uint32_t split = push(Inst{Op::Split});
+                    prog_[split].arg = pc();
+                    emit(n.children[i]);
+                    exits.push_back(push(Inst{Op::Jmp}));
+                    prog_[split].alt = pc();
+                }
+                for (uint32_t j : exits) prog_[j].arg = pc();
+                break;
+            }
+            case Node::Repeat: {
+                const Node& child = n.children[0];
+                for (int i = 0; i < n.min; ++i) emit(child);
+                if (n.max == -1) {
+                    uint32_t loop = push(Inst{Op::Split});
+                    prog_[loop].arg = pc();
+                    emit(child);
+                    push(Inst{Op::Jmp, 0, loop});
+                    prog_[loop].alt = pc();
+                } else {
+                    std::vector<uint32_t> skips;
+                    for (int i = n.min; i < n.max; ++i) {
+                        skips.push_back(push(Inst{Op::Split}));
+                        prog_[skips.back()].arg = pc();
+                        emit(child);
+                    }
+                    for (uint32_t s : skips) prog_[s].alt = pc();
+                }
+                break;
+            }
+        }
+    }
+
+    void next_generation() const {
+        if (++generation_ == 0) {
+            std::fill(mark_.begin(), mark_.end(), 0);
+            generation_ = 1;
+        }
+    }
+
+    // Adds the thread at `start` and everything reachable from it without
+    // consuming input; returns true on reaching Match.
+    bool add(std::vector<uint32_t>& list, uint32_t start, size_t pos, std::string_view text) const {
+        stack_.clear();
+        stack_.push_back(start);
+        while (!stack_.empty()) {
+            uint32_t p = stack_.back();
+            stack_.pop_back();
+            if (mark_[p] == generation_) continue;
+            mark_[p] = generation_;
+            const Inst& in = prog_[p];
+            switch (in.op) {
+                case Op::Match: return true;
+                case Op::Jmp: stack_.push_back(in.arg); break;
+                case Op::Split:
+                    stack_.push_back(in.alt);
+                    stack_.push_back(in.arg);
+                    break;
+                case Op::Begin:
+                    if (pos == 0) stack_.push_back(p + 1);
+                    break;
+                case Op::End:
+                    if (pos == text.size()) stack_.push_back(p + 1);
+                    break;
+                default: list.push_back(p);
+            }
+        }
+        return false;
+    }
+
+    std::string pattern_;
+    std::vector<Inst> prog_;
+    std::vector<ByteSet> sets_;
+    std::vector<std::string> required_;
+    bool anchored_ = false;
+
+    mutable std::vector<uint32_t> clist_, nlist_, stack_, mark_;
+    mutable uint32_t generation_ = 0;
+};
+
+} // namespace regex
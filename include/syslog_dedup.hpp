@@ -0,0 +1,225 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "config.hpp"
+
+// Reduces a syslog line to its template: every alphanumeric token that is a
+// number or a hex string (with at least one digit) becomes '#', and digit runs
+// inside other tokens are masked too, so timestamps, PIDs, IPs, addresses and
+// counters all collapse ("sshd[812]: from 10.0.4.17" -> "sshd[#]: from #.#.#.#").
+inline void syslog_template(std::string_view line, std::string& out) {
+    auto is_alnum = [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); };
+    auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+    auto is_hex = [&](char c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); };
+
+    out.clear();
+    size_t i = 0;
+    while (i < line.size()) {
+        if (!is_alnum(line[i])) {
+            out += line[i++];
+            continue;
+        }
+        size_t end = i;
+        bool digit = false, hex = true;
+        while (end < line.size() && is_alnum(line[end])) {
+            digit |= is_digit(line[end]);
+            hex &= is_hex(line[end]) || (end == i + 1 && (line[end] == 'x' || line[end] == 'X') && line[i] == '0');
+            ++end;
+        }
+        if (digit && hex) {
+            out += '#';
+        } else {
+            for (size_t j = i; j < end; ++j) {
+                if (!is_digit(line[j])) out += line[j];
+                else if (j == i || !is_digit(line[j - 1])) out += '#';
+            }
+        }
+        i = end;
+    }
+}
+
+// Storm suppression for matched syslog lines. Lines are grouped by template
+// and by the set of patterns they hit, so a line that hits other or more
+// patterns than an earlier one with the same template (an IOC address in an
+// otherwise routine message) is never folded into it. The first line of a
+// group is emitted verbatim and opens a window; further lines of the group in
+// that window are only counted and reported as one summary when it closes. A
+// group stays suppressed while its windows keep seeing repeats and is
+// forgotten (least recently used first) once more than `capacity` groups are
+// tracked; pending counts are flushed on eviction so totals stay exact.
+//
+// Open windows are also kept in expiry order, so flush_expired() and
+// next_deadline_ms() only look at windows that are due. `now` must not go
+// backwards between calls.
+class SyslogDedup {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Summary {
+        std::string templ;
+        std::vector<uint16_t> pattern_ids;   // patterns the first line matched
+        uint64_t count = 0;            // suppressed repeats in this window
+        uint64_t last_offset = 0;      // syslog offset of the last repeat
+        Clock::duration span{};        // first to last suppressed line
+    };
+
+    SyslogDedup(std::chrono::milliseconds window = std::chrono::milliseconds(Config::SystemMonitorConfig::DEDUP_WINDOW_MS),
+                size_t capacity = Config::SystemMonitorConfig::DEDUP_CAPACITY)
+        : window_(window), capacity_(capacity) {}
+
+    // Records one matched line and the ids of the patterns it hit. Returns true
+    // if the caller should emit it as-is, false if it was counted as a repeat.
+    template<typename Emit>
+    bool add(std::string_view line, uint64_t offset, const uint16_t* pattern_ids, size_t pattern_count,
+             Clock::time_point now, Emit&& emit) {
+        make_key(line, pattern_ids, pattern_count);
+        auto found = index_.find(scratch_);
+        if (found == index_.end()) {
+            if (lru_.size() >= capacity_) evict(emit);
+            lru_.push_front(Entry{scratch_, std::vector<uint16_t>(pattern_ids, pattern_ids + pattern_count),
+                                  now, {}, {}, 0, 0, false});
+            index_.emplace(lru_.front().key, lru_.begin());
+            open_window(lru_.front(), now);
+            return true;
+        }
+
+        auto it = found->second;
+        lru_.splice(lru_.begin(), lru_, it);
+        Entry& e = *it;
+        if (e.active && now - e.window_start >= window_) close(e, now, emit);
+        if (!e.active) {
+            open_window(e, now);
+            return true;
+        }
+        if (e.repeats == 0) e.first_ts = now;
+        e.last_ts = now;
+        e.last_offset = offset;
+        ++e.repeats;
+        return false;
+    }
+
+    // Closes every window older than the dedup window, emitting a summary for
+    // each template that saw repeats.
+    template<typename Emit>
+    void flush_expired(Clock::time_point now, Emit&& emit) {
+        // A window reopened by close() goes to the back with window_start =
+        // now, and a second close() ends it, so this stops.
+        while (expiry_head_ && now - expiry_head_->window_start >= window_) close(*expiry_head_, now, emit);
+    }
+
+    // Emits every pending summary regardless of window age (shutdown).
+    template<typename Emit>
+    void flush_all(Emit&& emit) {
+        for (auto& e : lru_) {
+            if (e.repeats > 0) emit(take_summary(e));
+        }
+        lru_.clear();
+        index_.clear();
+        expiry_head_ = expiry_tail_ = nullptr;
+    }
+
+    // Milliseconds until the oldest open window closes, capped at `cap`.
+    int next_deadline_ms(Clock::time_point now, int cap) const {
+        auto best = std::chrono::milliseconds(cap);
+        if (expiry_head_) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(expiry_head_->window_start + window_ - now);
+            best = std::min(best, std::max(left, std::chrono::milliseconds(0)));
+        }
+        return static_cast<int>(best.count());
+    }
+
+    size_t size() const { return lru_.size(); }
+
+private:
+    struct Entry {
+        std::string key;               // make_key(): pattern ids, then the template
+        std::vector<uint16_t> pattern_ids;
+        Clock::time_point window_start;
+        Clock::time_point first_ts;
+        Clock::time_point last_ts;
+        uint64_t repeats;
+        uint64_t last_offset;
+        bool active;                   // window open, and linked into the expiry list
+        Entry* expiry_prev = nullptr;
+        Entry* expiry_next = nullptr;
+    };
+
+    // Windows all last window_ and open at non-decreasing times, so appending
+    // each (re)opened window keeps the list in expiry order.
+    void open_window(Entry& e, Clock::time_point now) {
+        if (e.active) unlink_expiry(e);
+        e.active = true;
+        e.window_start = now;
+        e.expiry_prev = expiry_tail_;
+        (expiry_tail_ ? expiry_tail_->expiry_next : expiry_head_) = &e;
+        expiry_tail_ = &e;
+    }
+
+    void unlink_expiry(Entry& e) {
+        (e.expiry_prev ? e.expiry_prev->expiry_next : expiry_head_) = e.expiry_next;
+        (e.expiry_next ? e.expiry_next->expiry_prev : expiry_tail_) = e.expiry_prev;
+        e.expiry_prev = e.expiry_next = nullptr;
+    }
+
+    static size_t key_ids_size(size_t pattern_count) { return sizeof(uint16_t) * (pattern_count + 1); }
+
+    // The count and the sorted ids, fixed width so no template can alias
+    // them, followed by the line's template.
+    void make_key(std::string_view line, const uint16_t* pattern_ids, size_t pattern_count) {
+        sorted_ids_.assign(pattern_ids, pattern_ids + pattern_count);
+        std::sort(sorted_ids_.begin(), sorted_ids_.end());
+        const uint16_t count = static_cast<uint16_t>(pattern_count);
+        scratch_.assign(reinterpret_cast<const char*>(&count), sizeof(count));
+        scratch_.append(reinterpret_cast<const char*>(sorted_ids_.data()), sizeof(uint16_t) * pattern_count);
+        syslog_template(line, templ_);
+        scratch_ += templ_;
+    }
+
+    template<typename Emit>
+    void close(Entry& e, Clock::time_point now, Emit&& emit) {
+        if (e.repeats == 0) {
+            e.active = false;
+            unlink_expiry(e);
+            return;
+        }
+        emit(take_summary(e));
+        open_window(e, now);
+    }
+
+    template<typename Emit>
+    void evict(Emit&& emit) {
+        Entry& victim = lru_.back();
+        if (victim.repeats > 0) emit(take_summary(victim));
+        if (victim.active) unlink_expiry(victim);
+        index_.erase(victim.key);
+        lru_.pop_back();
+    }
+
+    Summary take_summary(Entry& e) {
+        Summary s;
+        s.templ = e.key.substr(key_ids_size(e.pattern_ids.size()));
+        s.pattern_ids = e.pattern_ids;
+        s.count = e.repeats;
+        s.last_offset = e.last_offset;
+        s.span = e.last_ts - e.first_ts;
+        e.repeats = 0;
+        return s;
+    }
+
+    std::chrono::milliseconds window_;
+    size_t capacity_;
+    std::list<Entry> lru_;                                          // most recent first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;   // views into lru_ entries
+    Entry* expiry_head_ = nullptr;                                  // open windows, next to close first
+    Entry* expiry_tail_ = nullptr;
+    std::string scratch_;
+    std::string templ_;
+    std::vector<uint16_t> sorted_ids_;
+};
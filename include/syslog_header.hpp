@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "event.hpp"
+
+// Splits a syslog line into its header fields and message without copying:
+// every field is a view into the line. Understands RFC 5424
+// (`<PRI>1 TIMESTAMP HOST APP PROCID MSGID [SD] MSG`) and RFC 3164 / the
+// traditional file format (`[<PRI>]Mmm dd hh:mm:ss HOST TAG[PID]: MSG`, also
+// with an RFC 3339 timestamp as rsyslog writes it). A line in neither format
+// is all message.
+
+enum SyslogField : uint8_t {
+    FIELD_LINE = 0,      // the whole line
+    FIELD_MESSAGE,
+    FIELD_HOST,
+    FIELD_APP
+};
+
+constexpr size_t SYSLOG_FIELD_COUNT = 4;
+
+inline bool syslog_field_from_string(std::string_view name, SyslogField& out) {
+    if (name == "line") out = FIELD_LINE;
+    else if (name == "message") out = FIELD_MESSAGE;
+    else if (name == "host") out = FIELD_HOST;
+    else if (name == "app") out = FIELD_APP;
+    else return false;
+    return true;
+}
+
+// RFC 5424 severity names (0 = emerg ... 7 = debug).
+inline bool syslog_severity_from_string(std::string_view name, int& out) {
+    static constexpr std::string_view names[] = {"emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"};
+    for (int i = 0; i < 8; ++i)
+        if (name == names[i]) {
+            out = i;
+            return true;
+        }
+    if (name.size() == 1 && name[0] >= '0' && name[0] <= '7') {
+        out = name[0] - '0';
+        return true;
+    }
+    return false;
+}
+
+struct SyslogHeader {
+    std::string_view line;
+    std::string_view timestamp;
+    std::string_view host;
+    std::string_view app;
+    std::string_view pid;
+    std::string_view message;
+    int16_t priority = -1;   // facility * 8 + severity, -1 when the line has no PRI
+    bool parsed = false;     // false: only `line` and `message` (the whole line) are set
+
+    int syslog_severity() const { return priority < 0 ? -1 : priority & 7; }
+
+    std::string_view field(SyslogField f) const {
+        switch (f) {
+            case FIELD_MESSAGE: return message;
+            case FIELD_HOST: return host;
+            case FIELD_APP: return app;
+            default: return line;
+        }
+    }
+};
+
+namespace syslog_detail {
+
+inline bool digit(char c) { return c >= '0' && c <= '9'; }
+
+// Up to the next space; consumes the token and the space.
+inline std::string_view next_token(std::string_view& p) {
+    size_t sp = p.find(' ');
+    std::string_view tok = p.substr(0, sp);
+    p.remove_prefix(sp == std::string_view::npos ? p.size() : sp + 1);
+    return tok;
+}
+
+inline std::string_view nil(std::string_view tok) { return tok == "-" ? std::string_view() : tok; }
+
+// Skips RFC 5424 STRUCTURED-DATA ("-" or one or more [id k="v" ...]).
+inline bool skip_structured_data(std::string_view& p) {
+    if (!p.empty() && p[0] == '-') {
+        p.remove_prefix(1);
+    } else {
+        while (!p.empty() && p[0] == '[') {
+            size_t i = 1;
+            bool quoted = false;
+            for (; i < p.size(); ++i) {
+                if (p[i] == '\\') ++i;
+                else if (p[i] == '"') quoted = !quoted;
+                else if (p[i] == ']' && !quoted) break;
+            }
+            if (i >= p.size()) return false;
+            p.remove_prefix(i + 1);
+        }
+    }
+    if (!p.empty() && p[0] == ' ') p.remove_prefix(1);
+    return true;
+}
+
+} // namespace syslog_detail
+
+inline SyslogHeader parse_syslog_header(std::string_view line) {
+    using namespace syslog_detail;
+    SyslogHeader h;
+    h.line = line;
+    h.message = line;
+    std::string_view p = line;
+
+    if (p.size() > 2 && p[0] == '<') {
+        size_t close = p.find('>');
+        if (close >= 2 && close <= 4 && std::all_of(p.begin() + 1, p.begin() + close, digit)) {
+            int pri = 0;
+            for (size_t i = 1; i < close; ++i) pri = pri * 10 + (p[i] - '0');
+            if (pri <= 191) {
+                h.priority = static_cast<int16_t>(pri);
+                p.remove_prefix(close + 1);
+            }
+        }
+    }
+
+    if (h.priority >= 0 && p.size() > 2 && p[0] == '1' && p[1] == ' ') {
+        p.remove_prefix(2);
+        h.timestamp = nil(next_token(p));
+        h.host = nil(next_token(p));
+        h.app = nil(next_token(p));
+        h.pid = nil(next_token(p));
+        next_token(p);   // MSGID
+        if (!skip_structured_data(p)) return h;
+        if (p.substr(0, 3) == "\xEF\xBB\xBF") p.remove_prefix(3);
+        h.message = p;
+        h.parsed = true;
+        return h;
+    }
+
+    // "Oct 18 10:00:00 " or "2026-10-18T10:00:00.123456+00:00 "
+    if (p.size() > 16 && p[3] == ' ' && p[6] == ' ' && p[9] == ':' && p[12] == ':' && p[15] == ' ') {
+        h.timestamp = p.substr(0, 15);
+        p.remove_prefix(16);
+    } else if (p.size() > 20 && digit(p[0]) && digit(p[3]) && p[4] == '-' && p[7] == '-' && p[10] == 'T') {
+        h.timestamp = next_token(p);
+    } else {
+        return h;
+    }
+    h.host = next_token(p);
+
+    // TAG ends at '[', ':' or a space; a line without one is all message.
+    size_t end = p.find_first_of("[: ");
+    if (end != std::string_view::npos && p[end] != ' ') {
+        h.app = p.substr(0, end);
+        p.remove_prefix(end);
+        if (p[0] == '[') {
+            size_t close = p.find(']');
+            if (close != std::string_view::npos) {
+                h.pid = p.substr(1, close - 1);
+                p.remove_prefix(close + 1);
+            }
+        }
+        if (!p.empty() && p[0] == ':') p.remove_prefix(1);
+        if (!p.empty() && p[0] == ' ') p.remove_prefix(1);
+    }
+    h.message = p;
+    h.parsed = true;
+    return h;
+}
+
+// Records where the header fields of `h` sit in the copy of h.line held by
+// `s`, for the reader. Fields cut off by the TEXT_SIZE limit are dropped.
+inline void store_syslog_fields(SyslogPayload& s, const SyslogHeader& h) {
+    s.has_priority = h.priority >= 0;
+    s.priority = static_cast<uint8_t>(std::max<int16_t>(h.priority, 0));
+    auto span = [&](std::string_view f) {
+        TextSpan t{};
+        if (f.empty()) return t;
+        size_t off = f.data() - h.line.data();
+        if (off + f.size() > s.line_len) return t;
+        t.off = static_cast<uint16_t>(off);
+        t.len = static_cast<uint16_t>(f.size());
+        return t;
+    };
+    s.timestamp = span(h.timestamp);
+    s.host = span(h.host);
+    s.app = span(h.app);
+    s.pid = span(h.pid);
+    // A truncated message keeps what fits.
+    size_t msg_off = h.message.data() - h.line.data();
+    s.message = TextSpan{};
+    if (h.parsed && msg_off < s.line_len)
+        s.message = TextSpan{static_cast<uint16_t>(msg_off), static_cast<uint16_t>(s.line_len - msg_off)};
+}
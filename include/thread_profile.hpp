@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "async_logger.hpp"
+#include "config.hpp"
+
+// Applies a Config::ThreadProfile to the calling thread (CPU set, scheduling
+// policy, NUMA node) and locks and prefaults memory, so capture and the
+// reader's hot threads are neither preempted by nor paging behind the
+// workloads they watch. Every step is best effort: what the host does not
+// allow is logged and skipped, and the thread runs on with default settings.
+namespace thread_profile {
+
+namespace detail {
+
+// From <linux/mempolicy.h>; libnuma is not required.
+constexpr int MPOL_PREFERRED = 1;
+constexpr unsigned MPOL_MF_MOVE = 1 << 1;
+constexpr int MAX_NODES = 1024;
+
+struct NodeMask {
+    unsigned long bits[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+    explicit NodeMask(int node) { bits[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long))); }
+};
+
+} // namespace detail
+
+// "0-3,8" -> {0, 1, 2, 3, 8}; an empty list means no restriction.
+inline std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    const char* p = text.c_str();
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p) throw std::invalid_argument("Bad CPU list '" + text + "'");
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1) throw std::invalid_argument("Bad CPU list '" + text + "'");
+            p = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE)
+            throw std::invalid_argument("Bad CPU range in '" + text + "'");
+        for (long c = first; c <= last; ++c) cpus.push_back(static_cast<int>(c));
+        if (*p == ',') ++p;
+        else if (*p) throw std::invalid_argument("Bad CPU list '" + text + "'");
+    }
+    return cpus;
+}
+
+inline int policy_from_string(const std::string& name) {
+    if (name.empty() || name == "other") return SCHED_OTHER;
+    if (name == "fifo") return SCHED_FIFO;
+    if (name == "rr") return SCHED_RR;
+    throw std::invalid_argument("Unknown scheduling policy '" + name + "'");
+}
+
+// NUMA node of a CPU from sysfs, -1 when unknown (or not a NUMA system).
+inline int numa_node_of_cpu(int cpu) {
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* d = opendir(dir.c_str());
+    if (!d) return -1;
+    int node = -1;
+    while (dirent* e = readdir(d)) {
+        if (sscanf(e->d_name, "node%d", &node) == 1) break;
+        node = -1;
+    }
+    closedir(d);
+    return node < detail::MAX_NODES ? node : -1;
+}
+
+// Node of the first CPU in the profile, -1 when it has none or is unknown.
+inline int profile_node(const Config::ThreadProfile& p) {
+    try {
+        std::vector<int> cpus = parse_cpu_list(p.cpus);
+        return cpus.empty() ? -1 : numa_node_of_cpu(cpus.front());
+    } catch (const std::exception&) {
+        return -1;
+    }
+}
+
+// Pins, schedules and places the calling thread as `p` says. Returns true when
+// every requested setting took effect.
+inline bool apply(const char* role, const Config::ThreadProfile& p) {
+    std::vector<int> cpus;
+    int policy;
+    try {
+        cpus = parse_cpu_list(p.cpus);
+        policy = policy_from_string(p.policy);
+    } catch (const std::exception& e) {
+        logger::error("SCHED", "{} profile ignored: {}", role, e.what());
+        return false;
+    }
+    if (cpus.empty() && policy == SCHED_OTHER && !p.numa_local) return true;
+
+    bool ok = true;
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cpus) CPU_SET(c, &set);
+        if (int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); rc != 0) {
+            logger::warn("SCHED", "{} thread: cannot pin to CPUs {}: {}", role, p.cpus, strerror(rc));
+            ok = false;
+        }
+    }
+    if (policy != SCHED_OTHER) {
+        sched_param sp{};
+        sp.sched_priority = std::clamp(p.priority, sched_get_priority_min(policy), sched_get_priority_max(policy));
+        if (int rc = pthread_setschedparam(pthread_self(), policy, &sp); rc != 0) {
+            logger::warn("SCHED", "{} thread: cannot set {} priority {}: {} (needs CAP_SYS_NICE or an rtprio limit)",
+                         role, p.policy, sp.sched_priority, strerror(rc));
+            ok = false;
+        }
+    }
+    if (p.numa_local) {
+        int node = cpus.empty() ? -1 : numa_node_of_cpu(cpus.front());
+        detail::NodeMask mask(std::max(node, 0));
+        if (node < 0) {
+            logger::warn("SCHED", "{} thread: numa_local needs cpus on a known NUMA node", role);
+            ok = false;
+        } else if (syscall(SYS_set_mempolicy, detail::MPOL_PREFERRED, mask.bits, detail::MAX_NODES + 1) != 0) {
+            logger::warn("SCHED", "{} thread: cannot prefer NUMA node {}: {}", role, node, strerror(errno));
+            ok = false;
+        }
+    }
+    logger::info("SCHED", "{} thread {}: cpus {}, policy {} {}{}", role, static_cast<int>(syscall(SYS_gettid)),
+                 p.cpus.empty() ? "any" : p.cpus, p.policy, p.priority, p.numa_local ? ", NUMA-local" : "");
+    return ok;
+}
+
+// Asks for the pages of [addr, addr + len) to come from `node`, moving those
+// this process already faulted in.
+inline bool bind_to_node(void* addr, size_t len, int node) {
+    if (node < 0) return false;
+    detail::NodeMask mask(node);
+    if (syscall(SYS_mbind, addr, len, detail::MPOL_PREFERRED, mask.bits, detail::MAX_NODES + 1,
+                detail::MPOL_MF_MOVE) != 0) {
+        logger::warn("SCHED", "Cannot place shared memory on NUMA node {}: {}", node, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Faults in every page of a mapping now rather than on the hot path.
+inline void prefault(void* addr, size_t len) {
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(addr, len, MADV_POPULATE_WRITE) == 0) return;
+#endif
+    // Older kernels: touch a byte per page. Reads only, since the mapping may
+    // already be shared with a running peer.
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const volatile char* p = static_cast<const char*>(addr);
+    for (size_t off = 0; off < len; off += page) (void)p[off];
+}
+
+// Locks what is mapped now and, when the memlock limit cannot bite (unlimited,
+// or root), everything mapped later too; with a finite limit MCL_FUTURE would
+// turn later allocations into ENOMEM instead.
+inline bool lock_memory() {
+    rlimit rl{};
+    getrlimit(RLIMIT_MEMLOCK, &rl);
+    bool future = rl.rlim_cur == RLIM_INFINITY || geteuid() == 0;
+    if (mlockall(MCL_CURRENT | (future ? MCL_FUTURE : 0)) != 0) {
+        logger::warn("SCHED", "mlockall failed: {} (raise RLIMIT_MEMLOCK or grant CAP_IPC_LOCK)", strerror(errno));
+        return false;
+    }
+    logger::info("SCHED", "Memory locked{}", future ? "" : " (current mappings only)");
+    return true;
+}
+
+} // namespace thread_profile
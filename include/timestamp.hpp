@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+inline uint64_t clock_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+inline uint64_t realtime_ns() { return clock_ns(CLOCK_REALTIME); }
+inline uint64_t monotonic_ns() { return clock_ns(CLOCK_MONOTONIC); }
+
+// Formats ISO-8601 UTC timestamps with millisecond precision
+// (2025-01-31T12:34:56.789Z). The "YYYY-MM-DDTHH:MM:SS" prefix is rendered
+// once per second and cached; within the same second only the milliseconds
+// are written.
+class TimestampFormatter {
+public:
+    static constexpr size_t LENGTH = 24;
+
+    // Writes exactly LENGTH bytes to `out` (no terminator).
+    void format(char* out, uint64_t realtime_ns) {
+        uint64_t sec = realtime_ns / 1'000'000'000ULL;
+        unsigned ms = static_cast<unsigned>((realtime_ns / 1'000'000ULL) % 1000);
+        if (sec != cached_sec_) refresh(sec);
+
+        memcpy(out, prefix_, PREFIX_LENGTH);
+        out[19] = '.';
+        out[20] = static_cast<char>('0' + ms / 100);
+        out[21] = static_cast<char>('0' + ms / 10 % 10);
+        out[22] = static_cast<char>('0' + ms % 10);
+        out[23] = 'Z';
+    }
+
+    void append(std::string& out, uint64_t realtime_ns) {
+        char buf[LENGTH];
+        format(buf, realtime_ns);
+        out.append(buf, LENGTH);
+    }
+
+private:
+    static constexpr size_t PREFIX_LENGTH = 19;
+
+    void refresh(uint64_t sec) {
+        std::time_t t = static_cast<std::time_t>(sec);
+        std::tm tm_utc;
+        gmtime_r(&t, &tm_utc);
+        char buf[80];
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d",
+                 tm_utc.tm_year + 1900, tm_utc.tm_mon + 1, tm_utc.tm_mday,
+                 tm_utc.tm_hour, tm_utc.tm_min, tm_utc.tm_sec);
+        memcpy(prefix_, buf, PREFIX_LENGTH);
+        cached_sec_ = sec;
+    }
+
+    uint64_t cached_sec_ = UINT64_MAX;
+    char prefix_[PREFIX_LENGTH] = {};
+};
+
+// Appends the timestamp using a per-thread formatter cache.
+inline void append_timestamp(std::string& out, uint64_t realtime_ns) {
+    thread_local TimestampFormatter formatter;
+    formatter.append(out, realtime_ns);
+}
+
+inline void append_timestamp(std::string& out, std::chrono::system_clock::time_point tp) {
+    append_timestamp(out, static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count()));
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "json.hpp"
+#include "timestamp.hpp"
+
+// Sampled lifecycle tracing of individual events, written as Chrome trace
+// JSON (opens in Perfetto and chrome://tracing).
+//
+// The agent gives one in every `sample_every` admitted events a non-zero
+// RawEvent::trace_id, tagged with its pid so that several agents feeding one
+// reader (queue_dir) never hand out the same id; every stage that handles a
+// traced event records a span for it into a per-thread buffer, and a flow
+// arrow with the trace id links the spans across threads and processes. All
+// timestamps are CLOCK_MONOTONIC, so the agent's and reader's files line up
+// once merged (tracemerge).
+//
+// With sampling off nothing is allocated and sample() is one relaxed load;
+// the other entry points return at once for trace id 0. Traced events from an
+// agent are only recorded by a reader that has tracing on as well.
+namespace trace {
+
+enum class Kind : uint8_t {
+    Slice,       // work on this thread, [start, end]
+    Wait,        // time spent queued between stages (an async span)
+    FlowStart,   // flow points bind to the slice enclosing `start` on this thread
+    FlowStep,
+    FlowEnd
+};
+
+struct Record {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    const char* name;     // string literal
+    uint64_t trace_id;    // 0 for batch-level slices
+    Kind kind;
+};
+
+namespace detail {
+
+struct ThreadBuffer {
+    int tid;
+    std::string name;
+    std::vector<Record> records;          // sized once; never reallocated
+    std::atomic<size_t> count{0};         // published records
+    uint64_t dropped = 0;
+};
+
+inline std::atomic<uint32_t> g_sample_every{0};
+inline std::atomic<uint32_t> g_next_id{1};
+inline uint64_t g_id_tag = 0;                 // pid << 32
+inline std::atomic<uint64_t> g_admitted{0};
+inline size_t g_buffer_records = 0;
+inline std::string g_process_name;
+inline std::mutex g_buffers_mutex;
+inline std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+inline thread_local ThreadBuffer* t_buffer = nullptr;
+inline thread_local const char* t_name = nullptr;
+
+inline ThreadBuffer* buffer() {
+    if (t_buffer) return t_buffer;
+    auto b = std::make_unique<ThreadBuffer>();
+    b->tid = static_cast<int>(syscall(SYS_gettid));
+    b->name = t_name ? t_name : "thread";
+    b->records.resize(g_buffer_records);
+    std::lock_guard<std::mutex> lock(g_buffers_mutex);
+    g_buffers.push_back(std::move(b));
+    t_buffer = g_buffers.back().get();
+    return t_buffer;
+}
+
+inline void append(const Record& r) {
+    ThreadBuffer* b = buffer();
+    size_t n = b->count.load(std::memory_order_relaxed);
+    if (n >= b->records.size()) {
+        ++b->dropped;
+        return;
+    }
+    b->records[n] = r;
+    b->count.store(n + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+inline bool enabled() { return detail::g_sample_every.load(std::memory_order_relaxed) != 0; }
+
+// Turns tracing on for this process (sample_every 0 leaves it off).
+inline void init(const char* process_name, uint32_t sample_every, size_t buffer_records) {
+    detail::g_process_name = process_name;
+    detail::g_id_tag = static_cast<uint64_t>(getpid()) << 32;
+    detail::g_buffer_records = buffer_records;
+    detail::g_sample_every.store(sample_every, std::memory_order_relaxed);
+}
+
+// Names the calling thread in the trace; cheap enough to call unconditionally.
+inline void set_thread_name(const char* name) {
+    detail::t_name = name;
+    if (detail::t_buffer) detail::t_buffer->name = name;
+}
+
+// A new trace id for one in every sample_every calls, else 0.
+inline uint64_t sample() {
+    uint32_t every = detail::g_sample_every.load(std::memory_order_relaxed);
+    if (every == 0) return 0;
+    if (detail::g_admitted.fetch_add(1, std::memory_order_relaxed) % every != 0) return 0;
+    uint32_t id = detail::g_next_id.fetch_add(1, std::memory_order_relaxed);
+    if (id == 0) id = detail::g_next_id.fetch_add(1, std::memory_order_relaxed);
+    return detail::g_id_tag | id;
+}
+
+// A slice of work on the calling thread for one traced event, joined to the
+// event's flow.
+inline void span(uint64_t trace_id, const char* name, uint64_t start_ns, uint64_t end_ns,
+                 Kind flow = Kind::FlowStep) {
+    if (trace_id == 0 || !enabled()) return;
+    detail::append(Record{start_ns, end_ns, name, trace_id, Kind::Slice});
+    detail::append(Record{start_ns, start_ns, "event", trace_id, flow});
+}
+
+// Time a traced event spent waiting between stages.
+inline void wait(uint64_t trace_id, const char* name, uint64_t start_ns, uint64_t end_ns) {
+    if (trace_id == 0 || !enabled()) return;
+    detail::append(Record{start_ns, end_ns, name, trace_id, Kind::Wait});
+}
+
+// Work done for a batch of events on the calling thread. flow() then joins
+// each traced event in the batch to it.
+inline void batch_slice(const char* name, uint64_t start_ns, uint64_t end_ns) {
+    if (!enabled()) return;
+    detail::append(Record{start_ns, end_ns, name, 0, Kind::Slice});
+}
+
+inline void flow(uint64_t trace_id, uint64_t at_ns, Kind kind = Kind::FlowStep) {
+    if (trace_id == 0 || !enabled()) return;
+    detail::append(Record{at_ns, at_ns, "event", trace_id, kind});
+}
+
+// Writes everything recorded so far by every thread of this process.
+inline void write_file(const std::string& path) {
+    if (!enabled()) return;
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) throw std::runtime_error("Cannot write trace file " + path);
+    const int pid = static_cast<int>(getpid());
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+    bool first = true;
+    auto sep = [&] {
+        fputs(first ? "\n" : ",\n", f);
+        first = false;
+    };
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+    sep();
+    fprintf(f, R"({"ph":"M","name":"process_name","pid":%d,"args":{"name":%s}})", pid,
+            nlohmann::json(detail::g_process_name).dump().c_str());
+    std::lock_guard<std::mutex> lock(detail::g_buffers_mutex);
+    uint64_t dropped = 0;
+    for (const auto& b : detail::g_buffers) {
+        sep();
+        fprintf(f, R"({"ph":"M","name":"thread_name","pid":%d,"tid":%d,"args":{"name":%s}})", pid, b->tid,
+                nlohmann::json(b->name).dump().c_str());
+        dropped += b->dropped;
+        size_t n = b->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i) {
+            const Record& r = b->records[i];
+            sep();
+            switch (r.kind) {
+                case Kind::Slice:
+                    fprintf(f, R"({"ph":"X","cat":"rtsa","name":"%s","pid":%d,"tid":%d,"ts":%.3f,"dur":%.3f)", r.name,
+                            pid, b->tid, us(r.start_ns), us(r.end_ns - r.start_ns));
+                    if (r.trace_id) fprintf(f, R"(,"args":{"trace_id":%)" PRIu64 "}", r.trace_id);
+                    fputs("}", f);
+                    break;
+                case Kind::Wait:
+                    fprintf(f,
+                            R"({"ph":"b","cat":"wait","name":"%s","id2":{"global":"%)" PRIu64 R"("},"pid":%d,"tid":%d,"ts":%.3f},)"
+                            "\n"
+                            R"({"ph":"e","cat":"wait","name":"%s","id2":{"global":"%)" PRIu64 R"("},"pid":%d,"tid":%d,"ts":%.3f})",
+                            r.name, r.trace_id, pid, b->tid, us(r.start_ns), r.name, r.trace_id, pid, b->tid,
+                            us(r.end_ns));
+                    break;
+                default: {
+                    char ph = r.kind == Kind::FlowStart ? 's' : r.kind == Kind::FlowEnd ? 'f' : 't';
+                    fprintf(f,
+                            R"({"ph":"%c","cat":"flow","name":"event","id2":{"global":"%)" PRIu64 R"("},"bp":"e","pid":%d,"tid":%d,"ts":%.3f})",
+                            ph, r.trace_id, pid, b->tid, us(r.start_ns));
+                }
+            }
+        }
+    }
+    fprintf(f, "\n],\"metadata\":{\"dropped_records\":%" PRIu64 "}}\n", dropped);
+    fclose(f);
+}
+
+// Writes <dir>/<process>-<pid>.json and returns its path ("" when tracing is off).
+inline std::string write_process_file(const std::string& dir) {
+    if (!enabled()) return "";
+    std::filesystem::create_directories(dir);
+    std::string path = dir + "/" + detail::g_process_name + "-" + std::to_string(getpid()) + ".json";
+    write_file(path);
+    return path;
+}
+
+// Concatenates the events of several trace files (e.g. agent and reader)
+// into one.
+inline void merge_files(const std::string& out_path, const std::vector<std::string>& inputs) {
+    nlohmann::json merged = {{"displayTimeUnit", "ns"}, {"traceEvents", nlohmann::json::array()}};
+    uint64_t dropped = 0;
+    for (const auto& path : inputs) {
+        FILE* f = fopen(path.c_str(), "r");
+        if (!f) throw std::runtime_error("Cannot read trace file " + path);
+        nlohmann::json j = nlohmann::json::parse(f, nullptr, true);
+        fclose(f);
+        for (auto& ev : j.at("traceEvents")) merged["traceEvents"].push_back(std::move(ev));
+        if (j.contains("metadata")) dropped += j["metadata"].value("dropped_records", uint64_t{0});
+    }
+    merged["metadata"] = {{"dropped_records", dropped}};
+    FILE* f = fopen(out_path.c_str(), "w");
+    if (!f) throw std::runtime_error("Cannot write trace file " + out_path);
+    std::string text = merged.dump();
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+}
+
+} // namespace trace
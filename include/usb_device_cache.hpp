@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "event.hpp"
+#include "config.hpp"
+
+// What identifies a USB device: its ids and sysfs strings (empty if absent).
+struct UsbDeviceInfo {
+    bool has_ids = false;
+    uint16_t vendor = 0;
+    uint16_t product = 0;
+    std::string serial;
+    std::string manufacturer;
+    std::string product_name;
+};
+
+// Log line for a USB event, "add 046d:c52b /dev/bus/usb/001/002 (cached)";
+// `log(fmt, args...)` is logger::info under the "USB" tag.
+template<typename Log>
+void describe_usb_event(Log&& log, const char* action, const UsbDeviceInfo& info, bool cached,
+                        const char* devnode) {
+    if (info.has_ids) {
+        char ids[10];
+        log("{} {} {}{}", action, format_usb_ids(ids, info.vendor, info.product), devnode ? devnode : "",
+            cached ? " (cached)" : "");
+    } else {
+        log("{} -:- {}", action, devnode ? devnode : "");
+    }
+}
+
+// USB device attributes by devpath (e.g. "/devices/pci0000:00/0000:00:14.0/usb1/1-2"),
+// filled from the startup enumeration and from "add" events. Other events for
+// a known device take its attributes from here rather than reading sysfs
+// again, and "remove" events, for which sysfs is already gone, take them
+// before the device is forgotten. Past `capacity` devices new ones are not
+// remembered and their events read sysfs as before.
+class UsbDeviceCache {
+public:
+    struct Stats {
+        uint64_t sysfs_reads = 0;    // devices whose attributes were read
+        uint64_t hits = 0;
+        uint64_t misses = 0;         // removes of devices never seen
+    };
+
+    explicit UsbDeviceCache(size_t capacity = Config::SystemMonitorConfig::USB_CACHE_CAPACITY)
+        : capacity_(capacity) {}
+
+    // From the startup enumeration.
+    void remember(const std::string& devpath, UsbDeviceInfo info) {
+        ++stats_.sysfs_reads;
+        store(devpath, std::move(info));
+    }
+
+    // Fills `out` for an event on `devpath` and returns true if it came from
+    // the cache. `read(UsbDeviceInfo&)` reads the attributes from sysfs; it
+    // is called for "add" (a new device may reuse the devpath) and for other
+    // actions on unknown devices, never for "remove": a remove of an unknown
+    // device leaves `out` as it was.
+    template<typename Read>
+    bool resolve(UsbAction action, const std::string& devpath, UsbDeviceInfo& out, Read&& read) {
+        if (action != USB_ACTION_ADD) {
+            auto it = devices_.find(devpath);
+            if (it != devices_.end()) {
+                ++stats_.hits;
+                if (action == USB_ACTION_REMOVE) {
+                    out = std::move(it->second);
+                    devices_.erase(it);
+                } else {
+                    out = it->second;
+                }
+                return true;
+            }
+            if (action == USB_ACTION_REMOVE) {
+                ++stats_.misses;
+                return false;
+            }
+        }
+        ++stats_.sysfs_reads;
+        read(out);
+        store(devpath, out);
+        return false;
+    }
+
+    size_t size() const { return devices_.size(); }
+    const Stats& stats() const { return stats_; }
+
+private:
+    void store(const std::string& devpath, UsbDeviceInfo info) {
+        auto it = devices_.find(devpath);
+        if (it != devices_.end()) it->second = std::move(info);
+        else if (devices_.size() < capacity_) devices_.emplace(devpath, std::move(info));
+    }
+
+    std::unordered_map<std::string, UsbDeviceInfo> devices_;
+    size_t capacity_;
+    Stats stats_;
+};
+
+// Copies `info` into the event; strings that no longer fit in
+// USB_STRINGS_SIZE are dropped.
+inline void store_usb_info(UsbPayload& u, const UsbDeviceInfo& info, bool cached) {
+    u.has_ids = info.has_ids;
+    u.vendor = info.vendor;
+    u.product = info.product;
+    u.cached = cached;
+    u.strings_len = 0;
+    auto put = [&](std::string_view s) {
+        TextSpan t{};
+        if (s.empty() || s.size() > USB_STRINGS_SIZE - u.strings_len) return t;
+        memcpy(u.strings + u.strings_len, s.data(), s.size());
+        t.off = u.strings_len;
+        t.len = static_cast<uint16_t>(s.size());
+        u.strings_len += t.len;
+        return t;
+    };
+    u.serial = put(info.serial);
+    u.manufacturer = put(info.manufacturer);
+    u.product_name = put(info.product_name);
+}
@@ -7,6 +7,7 @@
 #include <csignal>
 #include <unistd.h>
 #include <unordered_map>
+#include <algorithm>
 #include <fcntl.h>
 #include <sys/inotify.h>
 #include <sys/stat.h>
@@ -15,24 +16,24 @@
 #include <cerrno>
 #include <libudev.h>
 #include <dirent.h>
+#include <filesystem>
 #include <systemd/sd-daemon.h>
 
-#include "aho_corasick.hpp"
-#include "mmap_queue.hpp"
+#include "event.hpp"
 #include "shared_memory.hpp"
+#include "queue_segments.hpp"
 #include "patterns.hpp"
+#include "pattern_matcher.hpp"
+#include "syslog_header.hpp"
+#include "delete_rollup.hpp"
+#include "usb_device_cache.hpp"
+#include "syslog_dedup.hpp"
+#include "async_logger.hpp"
+#include "admission.hpp"
+#include "trace.hpp"
+#include "thread_profile.hpp"
 #include "config.hpp"
 
-constexpr size_t QUEUE_SIZE = Config::QueueConfig::DEFAULT_QUEUE_SIZE;
-constexpr size_t TEXT_SIZE = Config::QueueConfig::DEFAULT_TEXT_SIZE;
-
-struct RawEvent {
-    uint8_t type; // 0 = SYSLOG_LINE, 1 = USB_EVENT, 2 = FILE_DELETE
-    uint64_t event_id;
-    char text[TEXT_SIZE];
-};
-using QueueType = MmapQueue<RawEvent, QUEUE_SIZE>;
-
 std::atomic<bool> g_running(true);
 std::atomic<uint64_t> g_event_counter(0);
 
@@ -41,11 +42,22 @@ void signal_handler(int) {
 }
 
 void syslog_monitor(QueueType* queue) {
+    trace::set_thread_name("syslog");
+    thread_profile::apply("syslog", Config::threads.capture);
     const std::string& SYSLOG_PATH = Config::system_monitor.syslog_path;
 
-    auto patterns = load_patterns();
-    aho_corasick::trie trie;
-    for (const auto& pat : patterns) trie.insert(pat);
+    std::vector<PatternRule> rules;
+    try {
+        rules = load_pattern_rules();
+    } catch (const std::exception& e) {
+        logger::error("PATTERNS", "{}", e.what());
+        g_running = false;
+        return;
+    }
+    std::vector<uint8_t> severities;   // by pattern id
+    for (const auto& rule : rules) severities.push_back(rule.severity);
+    PatternMatcher matcher(rules, Config::patterns.automaton_cache_path);
+    std::vector<uint32_t> hits;
 
     int fd = open(SYSLOG_PATH.c_str(), O_RDONLY);
     if (fd < 0) return;
@@ -57,10 +69,34 @@ void syslog_monitor(QueueType* queue) {
     int inotify_fd = inotify_init1(IN_NONBLOCK);
     int wd = inotify_add_watch(inotify_fd, SYSLOG_PATH.c_str(), IN_MODIFY);
 
+    AdmissionGate gate(queue, SOURCE_SYSLOG, Config::admission.syslog, g_event_counter);
+    SyslogDedup dedup;
+    const bool dedup_enabled = Config::system_monitor.syslog_dedup;
+    auto emit_repeat = [&gate, &severities](const SyslogDedup::Summary& s) {
+        RawEvent ev{};
+        ev.type = SYSLOG_REPEAT;
+        ev.severity = SEVERITY_LOW;
+        for (uint16_t id : s.pattern_ids) ev.severity = std::max(ev.severity, severities[id]);
+        stamp_capture(ev);
+        auto& r = ev.repeat;
+        r.last_offset = s.last_offset;
+        r.count = static_cast<uint32_t>(s.count);
+        r.span_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(s.span).count());
+        r.pattern_count = static_cast<uint16_t>(s.pattern_ids.size());
+        std::copy_n(s.pattern_ids.begin(), std::min(s.pattern_ids.size(), MAX_MATCHED_PATTERNS), r.pattern_ids);
+        r.templ_len = copy_field(r.templ, TEXT_SIZE, s.templ.data(), s.templ.size());
+        logger::info("SYSLOG", "repeated {} times in {} ms: {}", s.count, r.span_ms, s.templ);
+        gate.submit_summary(ev);
+    };
+
     char buf[Config::SystemMonitorConfig::SYSLOG_BUFFER_SIZE];
     while (g_running) {
         pollfd pfd{inotify_fd, POLLIN, 0};
-        if (poll(&pfd, 1, Config::WorkerConfig::MONITOR_POLL_MS) <= 0) continue;
+        int timeout = dedup.next_deadline_ms(SyslogDedup::Clock::now(), Config::WorkerConfig::MONITOR_POLL_MS);
+        int ready = poll(&pfd, 1, timeout);
+        dedup.flush_expired(SyslogDedup::Clock::now(), emit_repeat);
+        gate.maybe_report();
+        if (ready <= 0) continue;
 
         ssize_t inotify_bytes = read(inotify_fd, buf, sizeof(buf));
         if (inotify_bytes < 0) continue;
@@ -68,6 +104,7 @@ void syslog_monitor(QueueType* queue) {
         fstat(fd, &st);
         if (st.st_size <= last_offset) continue;
 
+        off_t chunk_offset = last_offset;
         size_t to_read = st.st_size - last_offset;
         lseek(fd, last_offset, SEEK_SET);
         std::string data(to_read, '\0');
@@ -75,75 +112,224 @@ void syslog_monitor(QueueType* queue) {
         if (syslog_bytes < 0) continue;
         last_offset = st.st_size;
 
+        auto now = SyslogDedup::Clock::now();
         size_t pos = 0;
         while (pos < data.size()) {
             size_t nl = data.find('\n', pos);
             if (nl == std::string::npos) break;
-            std::string line = data.substr(pos, nl - pos);
+            std::string_view line(data.data() + pos, nl - pos);
             pos = nl + 1;
 
-            if (!trie.parse_text(line).empty()) {
+            const SyslogHeader header = parse_syslog_header(line);
+            hits.clear();
+            matcher.for_each_match(header, [&hits](uint32_t id) { hits.push_back(id); });
+            if (!hits.empty()) {
                 RawEvent ev{};
-                ev.type = 0;
-                ev.event_id = g_event_counter.fetch_add(1);
-                strncpy(ev.text, line.c_str(), TEXT_SIZE - 1);
-                std::cout << "[SYSLOG] " << ev.text << "\n";
-                while (!queue->enqueue(ev)) std::this_thread::yield();
+                ev.type = SYSLOG_LINE;
+                ev.severity = SEVERITY_LOW;
+                stamp_capture(ev);
+                ev.syslog.offset = chunk_offset + (pos - line.size() - 1);
+                for (uint32_t hit : hits) {
+                    uint16_t id = static_cast<uint16_t>(hit);
+                    ev.severity = std::max(ev.severity, severities[id]);
+                    size_t kept = std::min<size_t>(ev.syslog.pattern_count, MAX_MATCHED_PATTERNS);
+                    if (std::find(ev.syslog.pattern_ids, ev.syslog.pattern_ids + kept, id) != ev.syslog.pattern_ids + kept)
+                        continue;
+                    if (kept < MAX_MATCHED_PATTERNS) ev.syslog.pattern_ids[kept] = id;
+                    ++ev.syslog.pattern_count;
+                }
+                if (dedup_enabled &&
+                    !dedup.add(line, ev.syslog.offset, ev.syslog.pattern_ids,
+                               std::min<size_t>(ev.syslog.pattern_count, MAX_MATCHED_PATTERNS), now, emit_repeat))
+                    continue;
+
+                ev.syslog.line_len = copy_field(ev.syslog.line, TEXT_SIZE, line.data(), line.size());
+                store_syslog_fields(ev.syslog, header);
+                logger::info("SYSLOG", "{}", std::string_view(ev.syslog.line, ev.syslog.line_len));
+                gate.submit(ev);
             }
         }
     }
 
+    dedup.flush_all(emit_repeat);
+    gate.maybe_report(true);
+
     inotify_rm_watch(inotify_fd, wd);
     close(inotify_fd);
     close(fd);
 }
 
+void emit_usb_event(AdmissionGate& gate, const char* action, const UsbDeviceInfo& info, bool cached,
+                    const char* devnode) {
+    RawEvent ev{};
+    ev.type = USB_EVENT;
+    ev.severity = SEVERITY_NORMAL;
+    stamp_capture(ev);
+    ev.usb.action = usb_action_from_string(action);
+    store_usb_info(ev.usb, info, cached);
+    if (devnode) copy_field(ev.usb.devnode, USB_DEVNODE_SIZE, devnode);
+    describe_usb_event([](const char* fmt, const auto&... args) { logger::info("USB", fmt, args...); },
+                       action, info, cached, devnode);
+    gate.submit(ev);
+}
+
+// One sysfs read of each identifying attribute.
+UsbDeviceInfo read_usb_attributes(struct udev_device* dev) {
+    UsbDeviceInfo info;
+    info.has_ids = parse_usb_id(udev_device_get_sysattr_value(dev, "idVendor"), info.vendor) &&
+                   parse_usb_id(udev_device_get_sysattr_value(dev, "idProduct"), info.product);
+    auto attr = [dev](const char* name) {
+        const char* v = udev_device_get_sysattr_value(dev, name);
+        return v ? std::string(v) : std::string();
+    };
+    info.serial = attr("serial");
+    info.manufacturer = attr("manufacturer");
+    info.product_name = attr("product");
+    return info;
+}
+
+// A remove uevent for a device the cache never saw still carries
+// PRODUCT=<vendor>/<product>/<bcdDevice> (hex, no leading zeros).
+UsbDeviceInfo usb_info_from_uevent(struct udev_device* dev) {
+    UsbDeviceInfo info;
+    const char* p = udev_device_get_property_value(dev, "PRODUCT");
+    unsigned vendor, product;
+    if (p && sscanf(p, "%x/%x/", &vendor, &product) == 2 && vendor <= 0xffff && product <= 0xffff) {
+        info.has_ids = true;
+        info.vendor = static_cast<uint16_t>(vendor);
+        info.product = static_cast<uint16_t>(product);
+    }
+    return info;
+}
+
+// Devices present at startup, so their eventual removal is enriched too.
+void enumerate_usb_devices(struct udev* udev, UsbDeviceCache& cache) {
+    struct udev_enumerate* en = udev_enumerate_new(udev);
+    if (!en) return;
+    udev_enumerate_add_match_subsystem(en, "usb");
+    udev_enumerate_add_match_property(en, "DEVTYPE", "usb_device");
+    udev_enumerate_scan_devices(en);
+    struct udev_list_entry* entry;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(en)) {
+        struct udev_device* dev = udev_device_new_from_syspath(udev, udev_list_entry_get_name(entry));
+        if (!dev) continue;
+        if (const char* devpath = udev_device_get_devpath(dev)) cache.remember(devpath, read_usb_attributes(dev));
+        udev_device_unref(dev);
+    }
+    udev_enumerate_unref(en);
+    logger::info("USB", "{} devices present at startup", cache.size());
+}
+
 void usb_monitor(QueueType* queue) {
+    trace::set_thread_name("usb");
+    thread_profile::apply("usb", Config::threads.capture);
     struct udev* udev = udev_new();
     struct udev_monitor* mon = udev_monitor_new_from_netlink(udev, "udev");
     udev_monitor_filter_add_match_subsystem_devtype(mon, "usb", "usb_device");
     udev_monitor_enable_receiving(mon);
     int fd = udev_monitor_get_fd(mon);
+    AdmissionGate gate(queue, SOURCE_USB, Config::admission.usb, g_event_counter);
+    UsbDeviceCache cache;
+    enumerate_usb_devices(udev, cache);
 
     while (g_running) {
         pollfd pfd{fd, POLLIN, 0};
-        if (poll(&pfd, 1, Config::WorkerConfig::MONITOR_POLL_MS) <= 0) continue;
-
-        struct udev_device* dev = udev_monitor_receive_device(mon);
-        if (!dev) continue;
-
-        const char* action = udev_device_get_action(dev);
-        const char* vendor = udev_device_get_sysattr_value(dev, "idVendor");
-        const char* product = udev_device_get_sysattr_value(dev, "idProduct");
-        const char* devnode = udev_device_get_devnode(dev);
-
-        if (action) {
-            std::string msg = "USB device ";
-            msg += action;
-            if (vendor && product) msg += " (Vendor: " + std::string(vendor) + ", Product: " + std::string(product) + ")";
-            if (devnode) msg += " at " + std::string(devnode);
-
-            RawEvent ev{};
-            ev.type = 1;
-            ev.event_id = g_event_counter.fetch_add(1);
-            strncpy(ev.text, msg.c_str(), TEXT_SIZE - 1);
-            std::cout << "[USB] " << ev.text << "\n";
-            while (!queue->enqueue(ev)) std::this_thread::yield();
+        int ready = poll(&pfd, 1, Config::WorkerConfig::MONITOR_POLL_MS);
+        gate.maybe_report();
+        if (ready <= 0) continue;
+
+        // The monitor socket is non-blocking: take everything queued (a dock
+        // brings a burst of devices) before polling again.
+        while (struct udev_device* dev = udev_monitor_receive_device(mon)) {
+            const char* action = udev_device_get_action(dev);
+            const char* devpath = udev_device_get_devpath(dev);
+            if (action && devpath) {
+                UsbAction a = usb_action_from_string(action);
+                UsbDeviceInfo info;
+                bool cached = cache.resolve(a, devpath, info,
+                                            [dev](UsbDeviceInfo& out) { out = read_usb_attributes(dev); });
+                if (!cached && a == USB_ACTION_REMOVE) info = usb_info_from_uevent(dev);
+                emit_usb_event(gate, action, info, cached, udev_device_get_devnode(dev));
+            }
+            udev_device_unref(dev);
         }
-
-        udev_device_unref(dev);
     }
 
+    const auto& st = cache.stats();
+    logger::info("USB", "Attribute cache: {} devices, {} sysfs reads, {} hits, {} unknown removes", cache.size(),
+                 st.sysfs_reads, st.hits, st.misses);
     udev_monitor_unref(mon);
     udev_unref(udev);
 }
 
+// Synthetic USB source: one "<action> <vendor> <product> <devnode> [<devpath>]"
+// line per event, "-" for a missing field. With a devpath, events go through
+// the attribute cache as udev ones do, the line's ids standing in for sysfs.
+// Reopened whenever the writer goes away.
+void usb_fifo_monitor(QueueType* queue) {
+    trace::set_thread_name("usb");
+    thread_profile::apply("usb", Config::threads.capture);
+    const std::string& path = Config::system_monitor.usb_fifo_path;
+    if (mkfifo(path.c_str(), 0600) < 0 && errno != EEXIST) {
+        logger::error("USB", "mkfifo {} failed: {}", path, strerror(errno));
+        return;
+    }
+
+    AdmissionGate gate(queue, SOURCE_USB, Config::admission.usb, g_event_counter);
+    UsbDeviceCache cache;
+    std::string pending;
+    char buf[4096];
+    int fd = -1;
+    while (g_running) {
+        gate.maybe_report();
+        if (fd < 0) {
+            fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+            if (fd < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(Config::WorkerConfig::MONITOR_POLL_MS));
+                continue;
+            }
+        }
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, Config::WorkerConfig::MONITOR_POLL_MS) <= 0) continue;
+
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n == 0 || errno != EAGAIN) {
+                close(fd);
+                fd = -1;
+            }
+            continue;
+        }
+        pending.append(buf, n);
+
+        size_t start = 0;
+        for (size_t nl; (nl = pending.find('\n', start)) != std::string::npos; start = nl + 1) {
+            char action[32], vendor[16], product[16], devnode[USB_DEVNODE_SIZE], devpath[256];
+            std::string line = pending.substr(start, nl - start);
+            int fields = sscanf(line.c_str(), "%31s %15s %15s %63s %255s", action, vendor, product, devnode, devpath);
+            if (fields < 4) continue;
+            auto field = [](const char* v) -> const char* { return strcmp(v, "-") == 0 ? nullptr : v; };
+            UsbDeviceInfo from_line;
+            from_line.has_ids = parse_usb_id(field(vendor), from_line.vendor) &&
+                                parse_usb_id(field(product), from_line.product);
+            UsbDeviceInfo info = from_line;
+            bool cached = fields == 5 && cache.resolve(usb_action_from_string(action), devpath, info,
+                                                       [&](UsbDeviceInfo& out) { out = from_line; });
+            emit_usb_event(gate, action, info, cached, field(devnode));
+        }
+        pending.erase(0, start);
+    }
+    if (fd >= 0) close(fd);
+}
+
 void file_delete_monitor(QueueType* queue) {
+    trace::set_thread_name("delete");
+    thread_profile::apply("delete", Config::threads.capture);
     const std::vector<std::string>& watch_paths = Config::file_monitor.watch_paths;
 
     int inotify_fd = inotify_init1(IN_NONBLOCK);
     if (inotify_fd < 0) {
-        std::cerr << "inotify init failed\n";
+        logger::error("DELETE", "inotify init failed: {}", strerror(errno));
         return;
     }
 
@@ -154,44 +340,87 @@ void file_delete_monitor(QueueType* queue) {
         if (wd >= 0) {
             wd_to_path[wd] = path;
         } else {
-            std::cerr << "Failed to watch: " << path << " (" << strerror(errno) << ")\n";
+            logger::warn("DELETE", "Failed to watch: {} ({})", path, strerror(errno));
         }
     }
 
+    AdmissionGate gate(queue, SOURCE_FILE, Config::admission.file, g_event_counter);
+    DeleteRollup rollup;
+    const std::string no_dir;
+    auto emit_summary = [&gate](const DeleteRollup::Summary& s) {
+        RawEvent e{};
+        e.type = FILE_ROLLUP;
+        e.severity = SEVERITY_NORMAL;
+        stamp_capture(e);
+        auto& r = e.rollup;
+        r.count = static_cast<uint32_t>(s.count);
+        r.deleted = static_cast<uint32_t>(s.deleted);
+        r.moved = static_cast<uint32_t>(s.moved);
+        r.span_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(s.span).count());
+
+        // Directory first, then as many sampled names as fit.
+        auto append = [&r](const std::string& name) {
+            if (r.names_len + name.size() + 1 > TEXT_SIZE) return false;
+            r.names_len += copy_field(r.names + r.names_len, TEXT_SIZE - r.names_len, name.data(), name.size()) + 1;
+            return true;
+        };
+        append(s.dir);
+        for (const auto& n : s.first_names) {
+            if (!append(n)) break;
+            ++r.first_count;
+        }
+        for (const auto& n : s.last_names) {
+            if (!append(n)) break;
+            ++r.last_count;
+        }
+
+        logger::info("DELETE", "{} events rolled up in {} over {} ms", s.count, s.dir, r.span_ms);
+        gate.submit_summary(e);
+    };
+
     char buf[Config::FileMonitorConfig::INOTIFY_BUFFER_SIZE];
     while (g_running) {
         pollfd pfd{inotify_fd, POLLIN, 0};
-        if (poll(&pfd, 1, Config::WorkerConfig::MONITOR_POLL_MS) <= 0) continue;
+        int timeout = rollup.next_deadline_ms(DeleteRollup::Clock::now(), Config::WorkerConfig::MONITOR_POLL_MS);
+        int ready = poll(&pfd, 1, timeout);
+        rollup.flush_expired(DeleteRollup::Clock::now(), emit_summary);
+        gate.maybe_report();
+        if (ready <= 0) continue;
 
         ssize_t len = read(inotify_fd, buf, sizeof(buf));
         if (len <= 0) continue;
 
+        auto now = DeleteRollup::Clock::now();
         for (ssize_t i = 0; i < len;) {
     struct inotify_event* ev = (struct inotify_event*)&buf[i];
     if ((ev->mask & IN_DELETE || ev->mask & IN_MOVED_FROM) && ev->len > 0) {
         auto it = wd_to_path.find(ev->wd);
-        std::string full_path = (it != wd_to_path.end())
-            ? it->second + "/" + std::string(ev->name)
-            : std::string(ev->name);
-
-        std::string msg;
-        if (ev->mask & IN_DELETE) {
-            msg = "Deleted file: " + full_path;
-        } else if (ev->mask & IN_MOVED_FROM) {
-            msg = "Moved out file: " + full_path;
+        const std::string& dir = (it != wd_to_path.end()) ? it->second : no_dir;
+        bool moved = !(ev->mask & IN_DELETE);
+        if (rollup.add(ev->wd, dir, ev->name, moved, now)) {
+            RawEvent e{};
+            e.type = FILE_DELETE;
+            e.severity = SEVERITY_NORMAL;
+            stamp_capture(e);
+            e.file.mask = ev->mask;
+            e.file.wd = ev->wd;
+            if (!dir.empty()) {
+                e.file.path_len = copy_field(e.file.path, TEXT_SIZE - 1, dir.data(), dir.size());
+                e.file.path[e.file.path_len++] = '/';
+            }
+            e.file.name_offset = e.file.path_len;
+            e.file.path_len += copy_field(e.file.path + e.file.path_len, TEXT_SIZE - e.file.path_len, ev->name);
+            logger::info("DELETE", "{}", std::string_view(e.file.path, e.file.path_len));
+            gate.submit(e);
         }
-
-        RawEvent e{};
-        e.type = 2;
-        e.event_id = g_event_counter.fetch_add(1);
-        strncpy(e.text, msg.c_str(), TEXT_SIZE - 1);
-        std::cout << "[DELETE] " << e.text << "\n";
-        while (!queue->enqueue(e)) std::this_thread::yield();
     }
     i += sizeof(struct inotify_event) + ev->len;
 }
     }
 
+    rollup.flush_all(emit_summary);
+    gate.maybe_report(true);
+
     for (const auto& [wd, _] : wd_to_path) {
         inotify_rm_watch(inotify_fd, wd);
     }
@@ -205,17 +434,28 @@ int main() {
     // Initialize configuration
     Config::initialize_config();
     Config::load_config_from_file();
+    logger::start("agent");
+    trace::init("agent", Config::trace.sample_every, Config::TraceConfig::BUFFER_RECORDS);
     
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     sd_notify(0, "READY=1");
 
-    SharedMemory<QueueType> shm(Config::shared_memory.queue_file_path, true);
+    if (!Config::shared_memory.queue_dir.empty()) std::filesystem::create_directories(Config::shared_memory.queue_dir);
+    const std::string queue_path = agent_queue_path();
+    QueueOwnerLock queue_lock(queue_path);
+    SharedMemory<QueueType> shm(queue_path, true);
     QueueType* queue = shm.get();
+    // Place and fault in the queue before init() writes every slot, so its
+    // pages come from the capture threads' node and the monitors never fault.
+    if (Config::threads.capture.numa_local)
+        thread_profile::bind_to_node(queue, sizeof(QueueType), thread_profile::profile_node(Config::threads.capture));
+    if (Config::threads.prefault_queue) thread_profile::prefault(queue, sizeof(QueueType));
     queue->init();
+    if (Config::threads.lock_memory) thread_profile::lock_memory();
 
     std::thread t1(syslog_monitor, queue);
-    std::thread t2(usb_monitor, queue);
+    std::thread t2(Config::system_monitor.usb_source == "fifo" ? usb_fifo_monitor : usb_monitor, queue);
     std::thread t3(file_delete_monitor, queue);
 
     while (g_running) {
@@ -226,7 +466,13 @@ int main() {
     t1.join();
     t2.join();
     t3.join();
-
-    std::cout << "Agent stopped.\n";
+    // Under queue_dir the reader drains the segment once it is gone, then
+    // detaches it.
+    if (!Config::shared_memory.queue_dir.empty()) unlink(queue_path.c_str());
+
+    std::string trace_path = trace::write_process_file(Config::trace.dir);
+    if (!trace_path.empty()) logger::info("AGENT", "Trace written to {}", trace_path);
+    logger::info("AGENT", "Agent stopped.");
+    logger::stop();
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -0,0 +1,266 @@
+// Bulk transfer of the log chain as a CARv1 archive.
+//
+//   chaincar export <file.car> [--head CID | --key NAME] [--stop-at CID]
+//                   [--limit N] [--jobs N] [--from DIR]
+//       Walk the chain from the IPNS head of key NAME (default: the configured
+//       key) or from CID, newest first, and write every block of every batch
+//       to <file.car>. Batches link to their predecessor inside the encrypted
+//       payload, so each one is decrypted with the configured private key to
+//       find the next. Blocks of a batch are fetched in parallel (--jobs,
+//       default 8) from the daemon, or from a blockstore directory written by
+//       `import --blockstore`. Stops at the start of the chain, at --stop-at
+//       (exclusive, for incremental exports) or after --limit batches. The
+//       archive roots are the batch CIDs, newest first.
+//   chaincar import <file.car> [--blockstore DIR] [--no-pin]
+//       Check every block against its CID and that every root is present,
+//       then load the archive into the daemon (`ipfs dag import`, pinning the
+//       roots unless --no-pin) or into DIR, one file per block named by its
+//       CIDv1.
+//   chaincar info <file.car>
+//       Print the roots, block count and size of an archive after checking it.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include "car.hpp"
+#include "cid.hpp"
+#include "log_utils.hpp"
+#include "config.hpp"
+
+namespace fs = std::filesystem;
+
+// Fetches blocks by CID, from the daemon or a blockstore directory, verifying
+// each against its CID.
+class BlockFetcher {
+public:
+    BlockFetcher(int jobs, std::string blockstore) : jobs_(std::max(1, jobs)), blockstore_(std::move(blockstore)) {}
+
+    // Fetches all of `cids` with up to `jobs` requests in flight; throws if any
+    // block cannot be fetched or does not match.
+    std::vector<std::string> fetch(const std::vector<cid::Cid>& cids) const {
+        std::vector<std::string> out(cids.size());
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::string error;
+        std::mutex error_mutex;
+        auto work = [&] {
+            for (size_t i; !failed && (i = next.fetch_add(1)) < cids.size();) {
+                try {
+                    out[i] = fetch_one(cids[i]);
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!failed.exchange(true)) error = e.what();
+                }
+            }
+        };
+        size_t threads = std::min<size_t>(jobs_, cids.size());
+        if (threads <= 1) {
+            work();
+        } else {
+            std::vector<std::thread> pool;
+            for (size_t t = 0; t < threads; ++t) pool.emplace_back(work);
+            for (auto& t : pool) t.join();
+        }
+        if (failed) throw std::runtime_error(error);
+        return out;
+    }
+
+private:
+    std::string fetch_one(const cid::Cid& c) const {
+        for (int attempt = 0; attempt < Config::IPFSConfig::BLOCK_GET_ATTEMPTS; ++attempt) {
+            std::string data = blockstore_.empty() ? ipfs_block_get(c.to_string())
+                                                   : cid::read_file_bytes(blockstore_ + "/" + c.to_v1_string());
+            if (cid::verify_block(c, reinterpret_cast<const uint8_t*>(data.data()), data.size())) return data;
+            if (!blockstore_.empty()) break;
+        }
+        throw std::runtime_error("Cannot fetch block " + c.to_string());
+    }
+
+    int jobs_;
+    std::string blockstore_;
+};
+
+// prev_cid from a decrypted batch of either format: the NDJSON header line,
+// or the JSON object (which is a single line).
+std::string batch_prev_cid(const std::string& plaintext) {
+    json header = json::parse(plaintext.substr(0, plaintext.find('\n')), nullptr, false);
+    if (header.is_discarded() || !header.is_object()) throw std::runtime_error("Batch has no JSON header");
+    auto it = header.find("prev_cid");
+    return it != header.end() && it->is_string() ? it->get<std::string>() : "null";
+}
+
+// Writes every block of the batch at `root` to `writer`, a level of the DAG at
+// a time, and returns the batch file reassembled from them.
+std::string export_batch(const cid::Cid& root, const BlockFetcher& fetcher, car::Writer& writer) {
+    auto key = [](const cid::Cid& c) {
+        std::vector<uint8_t> b = c.bytes();
+        return std::string(b.begin(), b.end());
+    };
+    std::unordered_map<std::string, std::string> blocks;   // one batch: at most batch.max_bytes of file
+    std::vector<cid::Cid> level{root};
+    while (!level.empty()) {
+        std::vector<std::string> data = fetcher.fetch(level);
+        std::vector<cid::Cid> children;
+        for (size_t i = 0; i < level.size(); ++i) {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(data[i].data());
+            if (!blocks.emplace(key(level[i]), data[i]).second) continue;   // repeated chunk
+            writer.add(level[i], bytes, data[i].size());
+            for (const auto& child : cid::block_links(level[i], bytes, data[i].size()))
+                if (!blocks.count(key(child))) children.push_back(child);
+        }
+        level.swap(children);
+    }
+
+    std::string file;
+    auto append = [&](auto& self, const cid::Cid& c) -> void {
+        const std::string& data = blocks.at(key(c));
+        const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+        file += cid::block_file_data(c, bytes, data.size());
+        for (const auto& child : cid::block_links(c, bytes, data.size())) self(self, child);
+    };
+    append(append, root);
+    return file;
+}
+
+int export_chain(const std::string& path, std::string head, const std::string& key_name, const std::string& stop_at,
+                 uint64_t limit, int jobs, const std::string& blockstore) {
+    if (head.empty()) {
+        head = resolve_ipns(get_ipns_id_for_key(key_name));
+        if (head == "null") throw std::runtime_error("IPNS key '" + key_name + "' does not resolve");
+    }
+    const std::string privkey = Config::encryption.private_key_path;
+    BlockFetcher fetcher(jobs, blockstore);
+    car::Writer writer(path);
+    std::vector<cid::Cid> roots;
+    std::unordered_set<std::string> seen;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::string cur = head; cur != "null" && cur != stop_at && (limit == 0 || roots.size() < limit);) {
+        if (!seen.insert(cur).second) throw std::runtime_error("Chain loops back to " + cur);
+        cid::Cid root = cid::Cid::from_string(cur);
+        std::string file = export_batch(root, fetcher, writer);
+        roots.push_back(root);
+        cur = batch_prev_cid(decrypt_envelope(file, privkey));
+        if (roots.size() % 100 == 0) std::cerr << "  " << roots.size() << " batches, " << writer.blocks() << " blocks\n";
+    }
+    writer.finish(roots);
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Exported " << roots.size() << " batches (" << writer.blocks() << " blocks, " << writer.bytes()
+              << " bytes) from " << head << " to " << path << " in " << secs << " s\n";
+    return 0;
+}
+
+int import_car(const std::string& path, const std::string& blockstore, bool pin) {
+    car::Reader reader(path);
+    std::unordered_set<std::string> missing;
+    for (const auto& r : reader.roots()) missing.insert(r.to_v1_string());
+    if (!blockstore.empty()) fs::create_directories(blockstore);
+
+    cid::Cid c;
+    std::vector<uint8_t> data;
+    uint64_t blocks = 0, bytes = 0, written = 0;
+    while (reader.next(c, data)) {
+        ++blocks;
+        bytes += data.size();
+        std::string name = c.to_v1_string();
+        missing.erase(name);
+        if (blockstore.empty()) continue;
+        fs::path target = fs::path(blockstore) / name;
+        if (fs::exists(target)) continue;
+        fs::path tmp = target;
+        tmp += ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if (!out) throw std::runtime_error("Cannot write " + tmp.string());
+        }
+        fs::rename(tmp, target);
+        ++written;
+    }
+    if (!missing.empty()) throw std::runtime_error(path + " lacks " + std::to_string(missing.size()) + " of its roots");
+
+    if (blockstore.empty()) {
+        std::string cmd = "ipfs dag import --pin-roots=" + std::string(pin ? "true" : "false") + " \"" + path + "\"";
+        if (run_command_status(cmd) != 0) throw std::runtime_error("ipfs dag import failed for " + path);
+        std::cout << "Imported " << reader.roots().size() << " batches (" << blocks << " blocks, " << bytes
+                  << " bytes) into the daemon" << (pin ? ", roots pinned" : "") << "\n";
+    } else {
+        std::cout << "Imported " << reader.roots().size() << " batches (" << blocks << " blocks, " << bytes
+                  << " bytes, " << written << " new) into " << blockstore << "\n";
+    }
+    return 0;
+}
+
+int info(const std::string& path) {
+    car::Reader reader(path);
+    cid::Cid c;
+    std::vector<uint8_t> data;
+    uint64_t blocks = 0, bytes = 0;
+    while (reader.next(c, data)) {
+        ++blocks;
+        bytes += data.size();
+    }
+    std::cout << path << ": " << reader.roots().size() << " roots, " << blocks << " blocks, " << bytes
+              << " bytes, all verified\n";
+    for (const auto& r : reader.roots()) std::cout << "  " << r.to_string() << "\n";
+    return 0;
+}
+
+void usage() {
+    std::cout << "Usage:\n"
+                 "  chaincar export <file.car> [--head CID | --key NAME] [--stop-at CID] [--limit N] [--jobs N]\n"
+                 "                  [--from DIR]\n"
+                 "  chaincar import <file.car> [--blockstore DIR] [--no-pin]\n"
+                 "  chaincar info <file.car>\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    std::string cmd = argv[1];
+    std::string path = argv[2];
+    std::string head, key_name, stop_at, blockstore;
+    uint64_t limit = 0;
+    int jobs = Config::IPFSConfig::EXPORT_FETCH_JOBS;
+    bool pin = true;
+
+    for (int i = 3; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--head" && has_value) head = argv[++i];
+        else if (a == "--key" && has_value) key_name = argv[++i];
+        else if (a == "--stop-at" && has_value) stop_at = argv[++i];
+        else if (a == "--limit" && has_value) limit = std::stoull(argv[++i]);
+        else if (a == "--jobs" && has_value) jobs = std::stoi(argv[++i]);
+        else if ((a == "--from" || a == "--blockstore") && has_value) blockstore = argv[++i];
+        else if (a == "--no-pin") pin = false;
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    Config::initialize_config();
+    Config::load_config_from_file();
+    if (key_name.empty()) key_name = Config::ipfs.ipns_key_name;
+
+    try {
+        if (cmd == "export") return export_chain(path, head, key_name, stop_at, limit, jobs, blockstore);
+        if (cmd == "import") return import_car(path, blockstore, pin);
+        if (cmd == "info") return info(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    usage();
+    return 1;
+}
@@ -0,0 +1,526 @@
+// End-to-end load generator for agent -> reader.
+//
+// Builds a self-contained work directory (config, keys, patterns, a local
+// stand-in for the ipfs CLI), starts the agent and reader in it, and feeds them
+// synthetic syslog lines, file deletions and USB events at fixed rates. Every
+// generated event carries a "LGSEQ<seq>T<ns>" token; after the run the
+// published batches are decrypted and matched back to compute delivery and
+// event-to-batch latency. --ramp doubles the syslog rate until delivery or
+// latency fails, reporting the highest rate that held.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <csignal>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <openssl/rsa.h>
+#include <openssl/pem.h>
+#include <openssl/bn.h>
+#include "log_utils.hpp"
+#include "cid.hpp"
+#include "timestamp.hpp"
+#include "trace.hpp"
+#include "config.hpp"
+
+namespace fs = std::filesystem;
+
+struct Options {
+    double syslog_rate = 1000;          // syslog lines per second
+    double match_ratio = 0.1;           // fraction of lines that hit a pattern
+    uint64_t templates = 0;             // distinct matched-line templates, 0 = every line distinct
+    std::string severity;               // severity tag for the matched pattern, empty = untagged
+    double file_rate = 5;               // file create+delete pairs per second
+    double usb_rate = 1;                // USB events per second
+    int duration_s = 10;
+    bool ramp = false;
+    double ramp_max = 1'000'000;
+    int latency_budget_ms = (Config::WorkerConfig::TIME_THRESHOLD_SECONDS + 2) * 1000;
+    std::string workdir = "/tmp/rt-sysagent-loadgen";
+    std::string bin_dir;
+    std::string self;                   // this executable, run by the ipfs shim
+    uint32_t trace_every = 0;           // trace one in N events through agent and reader
+    bool chains = false;                // one chain per source instead of one for all
+    bool keep = false;
+};
+
+struct StageResult {
+    double syslog_rate = 0;
+    uint64_t sent_syslog = 0, sent_files = 0, sent_usb = 0;
+    uint64_t got_syslog = 0, got_files = 0, got_usb = 0, rolled_up = 0, repeated = 0;
+    uint64_t shed = 0;                  // syslog events dropped by admission control
+    uint64_t batches = 0;
+    uint64_t manifests = 0;             // chain head manifests, with --chains
+    std::vector<uint64_t> latencies_ns;
+
+    // Lines folded into SYSLOG_REPEAT summaries count as delivered.
+    double delivery() const {
+        return sent_syslog ? static_cast<double>(got_syslog + repeated) / sent_syslog : 1.0;
+    }
+    double pct_ms(double p) const {
+        if (latencies_ns.empty()) return 0;
+        size_t idx = std::min(latencies_ns.size() - 1, static_cast<size_t>(p / 100.0 * latencies_ns.size()));
+        return latencies_ns[idx] / 1e6;
+    }
+};
+
+// Minimal ipfs CLI covering what the reader runs: add, block put, pin add,
+// name publish/resolve, key list and a "daemon" so the pgrep check passes.
+// Added files are kept in ipfs-store/ named by their real CID (computed by
+// `loadgen --print-cid`, so the reader's verification passes); their mtime is
+// the arrival time.
+const char* IPFS_SHIM = R"SH(#!/bin/sh
+STORE="$(dirname "$0")/../ipfs-store"
+case "$1" in
+    daemon)
+        mkdir -p "$STORE"
+        while :; do sleep 1; done ;;
+    add)
+        version=0
+        for arg; do
+            [ "$arg" = "--cid-version=1" ] && version=1
+            file="$arg"
+        done
+        cid="$("@LOADGEN@" --print-cid "$file" "$version")" || exit 1
+        cp "$file" "$STORE/.$cid" && mv "$STORE/.$cid" "$STORE/$cid" && echo "$cid" ;;
+    block|pin)
+        exit 1 ;;
+    name)
+        [ "$2" = "publish" ] && { echo "Published"; exit 0; }
+        exit 1 ;;
+    key)
+        for k in log-agent log-agent-syslog log-agent-usb log-agent-file log-agent-manifest; do
+            echo "k51loadgen$k $k"
+        done ;;
+esac
+exit 0
+)SH";
+
+void write_file(const fs::path& path, const std::string& content) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot write " + path.string());
+    out << content;
+}
+
+void generate_keys(const fs::path& keys) {
+    fs::create_directories(keys);
+    if (fs::exists(keys / "private_key.pem") && fs::exists(keys / "public_key.pem")) return;
+
+    RSA* rsa = RSA_new();
+    BIGNUM* e = BN_new();
+    BN_set_word(e, RSA_F4);
+    if (RSA_generate_key_ex(rsa, 2048, e, nullptr) != 1) throw std::runtime_error("RSA key generation failed.");
+    BN_free(e);
+
+    FILE* priv = fopen((keys / "private_key.pem").c_str(), "wb");
+    FILE* pub = fopen((keys / "public_key.pem").c_str(), "wb");
+    if (!priv || !pub) throw std::runtime_error("Cannot write RSA keys.");
+    PEM_write_RSAPrivateKey(priv, rsa, nullptr, nullptr, 0, nullptr, nullptr);
+    PEM_write_RSA_PUBKEY(pub, rsa);
+    fclose(priv);
+    fclose(pub);
+    RSA_free(rsa);
+}
+
+// Written into every work directory loadgen creates; only a directory that
+// carries it is ever deleted.
+constexpr const char* WORKDIR_MARKER = ".rt-sysagent-loadgen";
+
+// True if `dir` is `other` or one of its parents.
+bool contains(const fs::path& dir, const fs::path& other) {
+    auto d = dir.begin(), o = other.begin();
+    for (; d != dir.end() && o != other.end(); ++d, ++o)
+        if (*d != *o) return false;
+    return d == dir.end() || (std::next(d) == dir.end() && d->empty());   // trailing slash
+}
+
+// Refuses `/`, $HOME, the project root and anything above them, and any
+// existing non-empty directory loadgen did not create.
+void check_workdir(const fs::path& dir) {
+    fs::path target = fs::weakly_canonical(fs::absolute(dir));
+    std::vector<fs::path> protected_paths = {"/", Config::get_project_root()};
+    if (const char* home = getenv("HOME"); home && *home) protected_paths.emplace_back(home);
+    for (const auto& p : protected_paths)
+        if (contains(target, fs::weakly_canonical(p)))
+            throw std::runtime_error("Refusing to use " + target.string() + " as the work directory: it contains " +
+                                     p.string());
+    if (fs::exists(target) && !fs::is_empty(target) && !fs::exists(target / WORKDIR_MARKER))
+        throw std::runtime_error(target.string() + " is not empty and was not created by loadgen");
+}
+
+void remove_workdir(const fs::path& dir) {
+    if (fs::exists(dir / WORKDIR_MARKER)) fs::remove_all(dir);
+}
+
+void prepare_workdir(const fs::path& dir, const fs::path& keys_src, const std::string& severity,
+                     const fs::path& loadgen, uint32_t trace_every, bool chains) {
+    check_workdir(dir);
+    remove_workdir(dir);
+    fs::create_directories(dir);
+    write_file(dir / WORKDIR_MARKER, "");
+    for (const char* sub : {"config", "tmp", "logs", "bin", "watch", "ipfs-store"}) fs::create_directories(dir / sub);
+    if (fs::exists(keys_src / "private_key.pem")) fs::copy(keys_src, dir / "keys");
+    else generate_keys(dir / "keys");
+
+    std::string shim = IPFS_SHIM;
+    shim.replace(shim.find("@LOADGEN@"), 9, loadgen.string());
+    write_file(dir / "bin" / "ipfs", shim);
+    fs::permissions(dir / "bin" / "ipfs", fs::perms::owner_all);
+    write_file(dir / "syslog", "");
+    write_file(dir / "tmp" / "pattern.txt", (severity.empty() ? "" : "[" + severity + "] ") + "segfault\n");
+    mkfifo((dir / "tmp" / "usb_events.fifo").c_str(), 0600);
+
+    json config;
+    config["system_monitor"] = {{"syslog_path", (dir / "syslog").string()}, {"usb_source", "fifo"}};
+    config["file_monitor"] = {{"watch_paths", {(dir / "watch").string()}}};
+    config["logging"] = {{"level", "warn"}};
+    if (trace_every) config["trace"] = {{"sample_every", trace_every}};
+    if (chains) config["chains"] = {{"enabled", true}, {"manifest_interval_s", 1}};
+    write_file(dir / "config" / "settings.json", config.dump(2));
+}
+
+pid_t spawn(const fs::path& dir, const std::string& exe, const std::vector<std::string>& args, const std::string& log) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    if (chdir(dir.c_str()) != 0) _exit(127);
+    std::string path = (dir / "bin").string() + ":" + (getenv("PATH") ? getenv("PATH") : "/usr/bin:/bin");
+    setenv("PATH", path.c_str(), 1);
+    int fd = open((dir / log).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+    std::vector<char*> argv{const_cast<char*>(exe.c_str())};
+    for (const auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    execv(exe.c_str(), argv.data());
+    _exit(127);
+}
+
+void stop_process(pid_t pid, int timeout_ms) {
+    if (pid <= 0) return;
+    kill(pid, SIGTERM);
+    for (int waited = 0; waited < timeout_ms; waited += 50) {
+        if (waitpid(pid, nullptr, WNOHANG) == pid) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+// Calls emit(seq) at `rate` per second until `running` clears, catching up in
+// bursts when the thread falls behind.
+template<typename Emit>
+uint64_t paced(double rate, const std::atomic<bool>& running, Emit&& emit) {
+    if (rate <= 0) return 0;
+    uint64_t start = monotonic_ns();
+    uint64_t sent = 0;
+    while (running.load(std::memory_order_relaxed)) {
+        uint64_t due = static_cast<uint64_t>((monotonic_ns() - start) / 1e9 * rate);
+        if (due > sent) {
+            emit(sent, due);
+            sent = due;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return sent;
+}
+
+// Letters-only name for n, so it survives the agent's template masking.
+std::string alpha(uint64_t n) {
+    std::string s;
+    do {
+        s += static_cast<char>('a' + n % 26);
+        n /= 26;
+    } while (n);
+    return s;
+}
+
+std::string token(uint64_t seq) {
+    return "LGSEQ" + std::to_string(seq) + "T" + std::to_string(realtime_ns());
+}
+
+// Finds the LGSEQ token in `text`; returns the embedded send time or 0.
+uint64_t parse_token(const std::string& text) {
+    size_t pos = text.find("LGSEQ");
+    if (pos == std::string::npos) return 0;
+    size_t t = text.find('T', pos + 5);
+    if (t == std::string::npos) return 0;
+    return strtoull(text.c_str() + t + 1, nullptr, 10);
+}
+
+void collect_results(const fs::path& dir, StageResult& r) {
+    const std::string privkey = (dir / "keys" / "private_key.pem").string();
+    for (const auto& entry : fs::directory_iterator(dir / "ipfs-store")) {
+        if (entry.path().filename().string()[0] == '.') continue;
+        struct stat st;
+        if (stat(entry.path().c_str(), &st) != 0) continue;
+        uint64_t arrived = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1'000'000'000ULL + st.st_mtim.tv_nsec;
+
+        std::vector<json> events;
+        try {
+            // Manifests are stored in the clear.
+            std::string text = cid::read_file_bytes(entry.path().string());
+            if (text.find("\"prev_manifest\"") != std::string::npos) {
+                ++r.manifests;
+                continue;
+            }
+            std::string plaintext = read_encrypted_json(entry.path().string(), privkey);
+            if (plaintext.rfind("{\"timestamp\"", 0) == 0 && plaintext.find("\"logs\"") != std::string::npos) {
+                json batch = json::parse(plaintext);
+                for (const auto& s : batch["logs"]) events.push_back(json::parse(s.get<std::string>()));
+            } else {
+                std::istringstream lines(plaintext);
+                std::string line;
+                std::getline(lines, line);   // header
+                while (std::getline(lines, line))
+                    if (!line.empty()) events.push_back(json::parse(line));
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "skipping " << entry.path() << ": " << e.what() << "\n";
+            continue;
+        }
+        ++r.batches;
+
+        for (const auto& ev : events) {
+            std::string type = ev.value("type", "");
+            std::string message = ev.value("message", "");
+            if (type == "FILE_ROLLUP") {
+                r.rolled_up += ev.value("count", 0u) / 2;
+                continue;
+            }
+            if (type == "SYSLOG_REPEAT") {
+                r.repeated += ev.value("count", 0u);
+                continue;
+            }
+            if (type == "ADMISSION") {
+                if (ev.value("source", "") == "syslog")
+                    r.shed += ev.value("dropped_rate", 0ul) + ev.value("dropped_quota", 0ul) + ev.value("dropped_full", 0ul);
+                continue;
+            }
+            uint64_t sent = parse_token(message);
+            if (!sent) continue;
+            if (type == "SYSLOG") ++r.got_syslog;
+            else if (type == "USB") ++r.got_usb;
+            else if (type == "FILE") ++r.got_files;
+            if (arrived > sent) r.latencies_ns.push_back(arrived - sent);
+        }
+    }
+    std::sort(r.latencies_ns.begin(), r.latencies_ns.end());
+}
+
+// Merges the agent's and reader's trace files into `out`.
+void merge_traces(const fs::path& dir, const std::string& out) {
+    std::vector<std::string> inputs;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir / "tmp" / "trace", ec))
+        if (entry.path().extension() == ".json") inputs.push_back(entry.path().string());
+    if (inputs.empty()) {
+        std::cerr << "No trace files were written\n";
+        return;
+    }
+    std::sort(inputs.begin(), inputs.end());
+    trace::merge_files(out, inputs);
+    std::cout << "Trace of " << inputs.size() << " processes written to " << out << "\n";
+}
+
+StageResult run_stage(const Options& opt, double syslog_rate, const fs::path& dir) {
+    prepare_workdir(dir, fs::path(Config::get_project_root()) / "keys", opt.severity, opt.self, opt.trace_every,
+                    opt.chains);
+
+    pid_t ipfs = spawn(dir, (dir / "bin" / "ipfs").string(), {"daemon"}, "logs/ipfs.out");
+    pid_t agent = spawn(dir, opt.bin_dir + "/agent", {}, "logs/agent.out");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));   // agent creates the queue
+    pid_t reader = spawn(dir, opt.bin_dir + "/reader", {}, "logs/reader.out");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    StageResult r;
+    r.syslog_rate = syslog_rate;
+    std::atomic<bool> running(true);
+
+    std::thread syslog_thread([&] {
+        int fd = open((dir / "syslog").c_str(), O_WRONLY | O_APPEND);
+        uint64_t matched = 0;
+        std::string chunk;
+        r.sent_syslog = 0;
+        paced(syslog_rate, running, [&](uint64_t from, uint64_t to) {
+            chunk.clear();
+            for (uint64_t seq = from; seq < to; ++seq) {
+                // Spread matches evenly: line seq matches when the running
+                // total crosses an integer.
+                bool match = static_cast<uint64_t>((seq + 1) * opt.match_ratio) > matched;
+                chunk += "Oct 18 10:00:00 loadgen app[42]: ";
+                if (match) {
+                    ++matched;
+                    uint64_t variant = opt.templates ? matched % opt.templates : matched;
+                    chunk += "segfault in " + alpha(variant) + " at 0 ip 0000 " + token(seq) + "\n";
+                } else {
+                    chunk += "request served in 3ms seq=" + std::to_string(seq) + "\n";
+                }
+            }
+            ssize_t ignored = write(fd, chunk.data(), chunk.size());
+            (void)ignored;
+        });
+        r.sent_syslog = matched;
+        close(fd);
+    });
+
+    std::thread file_thread([&] {
+        r.sent_files = paced(opt.file_rate, running, [&](uint64_t from, uint64_t to) {
+            for (uint64_t seq = from; seq < to; ++seq) {
+                fs::path f = dir / "watch" / token(seq);
+                write_file(f, "x");
+                fs::remove(f);
+            }
+        });
+    });
+
+    std::thread usb_thread([&] {
+        int fd = open((dir / "tmp" / "usb_events.fifo").c_str(), O_RDWR | O_NONBLOCK);
+        r.sent_usb = paced(opt.usb_rate, running, [&](uint64_t from, uint64_t to) {
+            std::string lines;
+            // Plug/unplug pairs; the removes carry no ids, as sysfs is gone by then.
+            for (uint64_t seq = from; seq < to; ++seq) {
+                std::string devpath = " /devices/usb1/1-" + std::to_string(seq / 2 % 8);
+                lines += seq % 2 ? "remove - - /dev/" + token(seq) + devpath + "\n"
+                                 : "add 046d c52b /dev/" + token(seq) + devpath + "\n";
+            }
+            ssize_t ignored = write(fd, lines.data(), lines.size());
+            (void)ignored;
+        });
+        // Keep the FIFO open until the agent has drained it.
+        std::this_thread::sleep_for(std::chrono::milliseconds(Config::WorkerConfig::MONITOR_POLL_MS * 2));
+        close(fd);
+    });
+
+    std::this_thread::sleep_for(std::chrono::seconds(opt.duration_s));
+    running = false;
+    syslog_thread.join();
+    file_thread.join();
+    usb_thread.join();
+
+    // Let the time threshold flush the tail, then stop producer before consumer.
+    std::this_thread::sleep_for(std::chrono::seconds(Config::WorkerConfig::TIME_THRESHOLD_SECONDS + 2));
+    stop_process(agent, 5000);
+    stop_process(reader, 10000);
+    stop_process(ipfs, 100);
+
+    collect_results(dir, r);
+    if (opt.trace_every) merge_traces(dir, opt.workdir + "-trace.json");
+    if (!opt.keep) remove_workdir(dir);
+    return r;
+}
+
+void print_stage(const StageResult& r) {
+    printf("%10.0f lines/s | syslog %6lu+%lu repeats/%-6lu (%5.1f%%, %lu shed) files %lu/%lu (+%lu rolled up) usb %lu/%lu | "
+           "%lu batches, %lu manifests | latency ms p50 %.0f p90 %.0f p99 %.0f max %.0f\n",
+           r.syslog_rate, r.got_syslog, r.repeated, r.sent_syslog, r.delivery() * 100, r.shed, r.got_files, r.sent_files, r.rolled_up,
+           r.got_usb, r.sent_usb, r.batches, r.manifests, r.pct_ms(50), r.pct_ms(90), r.pct_ms(99), r.pct_ms(100));
+    fflush(stdout);
+}
+
+void usage() {
+    std::cout << "Usage: loadgen [options]\n"
+                 "  --rate N            syslog lines per second (default 1000)\n"
+                 "  --match-ratio R     fraction of lines matching a pattern (default 0.1)\n"
+                 "  --templates N       distinct matched-line templates (default 0: all distinct)\n"
+                 "  --severity NAME     tag the matched pattern low|normal|high|critical\n"
+                 "  --file-rate N       file create/delete pairs per second (default 5)\n"
+                 "  --usb-rate N        USB events per second (default 1)\n"
+                 "  --duration S        seconds of load per run (default 10)\n"
+                 "  --ramp              double --rate until delivery or latency fails\n"
+                 "  --ramp-max N        stop ramping at this rate (default 1000000)\n"
+                 "  --latency-budget MS p99 event-to-batch latency allowed while ramping\n"
+                 "  --workdir DIR       scratch directory, new or from an earlier run (default /tmp/rt-sysagent-loadgen)\n"
+                 "  --bin-dir DIR       where agent and reader live (default: next to loadgen)\n"
+                 "  --trace N           trace one in N events; writes <workdir>-trace.json\n"
+                 "  --chains            one chain per source, linked by a manifest\n"
+                 "  --keep              keep the work directory for inspection\n";
+}
+
+int main(int argc, char** argv) {
+    // Used by the ipfs shim.
+    if (argc == 4 && std::string(argv[1]) == "--print-cid") {
+        try {
+            std::cout << cid::file_dag(cid::read_file_bytes(argv[2]), atoi(argv[3])).to_string() << "\n";
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    Options opt;
+    char self[PATH_MAX] = {};
+    if (readlink("/proc/self/exe", self, sizeof(self) - 1) > 0) {
+        opt.bin_dir = fs::path(self).parent_path().string();
+        opt.self = self;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument("missing value for " + a);
+            return argv[++i];
+        };
+        try {
+            if (a == "--rate") opt.syslog_rate = std::stod(next());
+            else if (a == "--match-ratio") opt.match_ratio = std::stod(next());
+            else if (a == "--templates") opt.templates = std::stoull(next());
+            else if (a == "--severity") opt.severity = next();
+            else if (a == "--file-rate") opt.file_rate = std::stod(next());
+            else if (a == "--usb-rate") opt.usb_rate = std::stod(next());
+            else if (a == "--duration") opt.duration_s = std::stoi(next());
+            else if (a == "--ramp") opt.ramp = true;
+            else if (a == "--ramp-max") opt.ramp_max = std::stod(next());
+            else if (a == "--latency-budget") opt.latency_budget_ms = std::stoi(next());
+            else if (a == "--workdir") opt.workdir = next();
+            else if (a == "--bin-dir") opt.bin_dir = next();
+            else if (a == "--trace") opt.trace_every = static_cast<uint32_t>(std::stoul(next()));
+            else if (a == "--chains") opt.chains = true;
+            else if (a == "--keep") opt.keep = true;
+            else {
+                usage();
+                return a == "--help" ? 0 : 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    try {
+        if (!opt.ramp) {
+            StageResult r = run_stage(opt, opt.syslog_rate, opt.workdir);
+            print_stage(r);
+            return r.got_syslog > 0 || r.sent_syslog == 0 ? 0 : 1;
+        }
+
+        double best = 0;
+        for (double rate = opt.syslog_rate; rate <= opt.ramp_max; rate *= 2) {
+            StageResult r = run_stage(opt, rate, opt.workdir);
+            print_stage(r);
+            bool ok = r.delivery() >= 0.999 && r.pct_ms(99) <= opt.latency_budget_ms;
+            if (!ok) break;
+            best = rate;
+        }
+        printf("max sustainable: %.0f lines/s (%.0f matched events/s) within p99 %d ms\n", best,
+               best * opt.match_ratio, opt.latency_budget_ms);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
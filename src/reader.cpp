@@ -10,163 +10,709 @@
 #include <sstream>
 #include <cstdio>
 #include <array>
-#include "shared_memory.hpp"
-#include "mmap_queue.hpp"
+#include <algorithm>
+#include <memory>
+#include <cctype>
+#include "queue_segments.hpp"
+#include "event.hpp"
+#include "event_format.hpp"
+#include "patterns.hpp"
 #include "log_utils.hpp"
-#include "json.hpp"
+#include "log_bucket.hpp"
+#include "batch_controller.hpp"
+#include "ipfs_uploader.hpp"
+#include "metrics.hpp"
+#include "cid.hpp"
+#include "batch_arena.hpp"
+#include "trace.hpp"
+#include "thread_profile.hpp"
+#include "async_logger.hpp"
 #include "config.hpp"
 
-using json = nlohmann::json;
 
-constexpr size_t QUEUE_SIZE = Config::QueueConfig::DEFAULT_QUEUE_SIZE;
-constexpr size_t TEXT_SIZE = Config::QueueConfig::DEFAULT_TEXT_SIZE;
 constexpr int NUM_WORKERS = Config::WorkerConfig::DEFAULT_NUM_WORKERS;
 constexpr int LOG_THRESHOLD = Config::WorkerConfig::LOG_THRESHOLD;
-constexpr int TIME_THRESHOLD_SECONDS = Config::WorkerConfig::TIME_THRESHOLD_SECONDS;
 constexpr int WORKER_SLEEP_MS = Config::WorkerConfig::WORKER_SLEEP_MS;
 constexpr int FLUSHER_SLEEP_MS = Config::WorkerConfig::FLUSHER_SLEEP_MS;
 
 
 std::atomic<bool> g_running(true);
-std::mutex log_mutex;
-std::mutex cid_mutex;
-std::vector<json> log_bucket;
-std::string g_prev_cid = "null";
-std::string g_ipns_id = "";
-std::chrono::steady_clock::time_point last_push_time;
-
-struct RawEvent {
-    uint8_t type; // 0 = SYSLOG_LINE, 1 = USB_EVENT
-    uint64_t event_id;
-    char text[TEXT_SIZE];
+std::vector<std::string> g_pattern_names;
+QueueSegments g_segments;
+
+// Earliest deadline of any uncollected event, per worker shard.
+struct alignas(Config::QueueConfig::CACHE_LINE_SIZE) FlushDeadline {
+    std::atomic<int64_t> ns{INT64_MAX};
+};
+
+// One hash-linked chain of batches and the IPNS name of its head. Chains
+// share nothing: each has its own bucket, flush, seal arena, batch controller
+// and uploader, so they seal and upload in parallel.
+//
+// Flush state: whoever wins `flushing` owns `unsent`, the serialization
+// buffers, the seal arena and the controller's update side until it clears
+// the flag; the counter and the deadlines let workers evaluate the triggers
+// without a lock.
+struct Chain {
+    Chain(std::string name, std::string ipns_key) : name(std::move(name)), ipns_key(std::move(ipns_key)) {}
+
+    const std::string name;          // empty for the single chain
+    const std::string ipns_key;
+    std::string ipns_id;
+    std::string resolved_head = "null";   // published head at startup
+
+    std::mutex cid_mutex;
+    ShardedLogBucket<LogRecord> bucket{NUM_WORKERS, LOG_THRESHOLD * 2};
+    std::string prev_cid = "null";
+
+    std::atomic<bool> flushing{false};
+    std::vector<LogRecord> unsent;
+    std::string batch_buf;
+    std::string event_buf;
+    std::string scratch_buf;
+    BatchArena seal_arena;
+    std::atomic<size_t> unsent_count{0};
+    std::array<FlushDeadline, NUM_WORKERS> shard_deadlines;
+    std::atomic<int64_t> unsent_deadline_ns{INT64_MAX};   // written only by the flush
+    std::atomic<bool> critical_pending{false};   // a critical event waits in the bucket
+    std::unique_ptr<BatchController> controller;
+    std::unique_ptr<IpfsUploader> uploader;
+
+    // Prefix for log lines, so the single chain logs as before.
+    std::string tag() const { return name.empty() ? "" : "[" + name + "] "; }
+
+    std::string upload_dir() const {
+        return Config::dirs.get_tmp_path() + "/upload" + (name.empty() ? "" : "/" + name);
+    }
+
+    // Last head published to IPNS, in this run or before it.
+    std::string head() const {
+        std::string h = uploader->stats().head;
+        return h.empty() ? resolved_head : h;
+    }
+};
+std::vector<std::unique_ptr<Chain>> g_chains;
+std::array<Chain*, SOURCE_FILE + 1> g_chain_by_source{};
+
+// The manifest linking every chain head; only with chains enabled. Owned by
+// the manifest publisher thread while it runs, by main before and after.
+struct Manifest {
+    std::string ipns_key;
+    std::string prev = "null";
+    std::vector<std::string> heads;    // as of the last published manifest
+    metrics::Counter published;
 };
-using QueueType = MmapQueue<RawEvent, QUEUE_SIZE>;
+Manifest g_manifest;
+
+// Pipeline counters and per-stage timings, served by metrics::Server.
+struct ReaderMetrics {
+    metrics::Counter events;                 // dequeued
+    metrics::Counter batches_sealed;
+    metrics::Counter seal_failures;
+    metrics::Counter flush_contended;        // flush attempts that found another flush running
+    metrics::Counter backpressure_waits;     // worker passes skipped while uploads were backed up
+    metrics::Histogram queue_wait = metrics::seconds_histogram();      // capture -> dequeue
+    metrics::Histogram serialize = metrics::seconds_histogram();
+    metrics::Histogram encrypt = metrics::seconds_histogram();         // AES-GCM + RSA + write
+    metrics::Histogram cid = metrics::seconds_histogram();
+    metrics::Histogram cid_lock_wait = metrics::seconds_histogram();
+    metrics::Histogram stored = metrics::seconds_histogram();          // collect -> upload verified
+    metrics::Histogram batch_bytes = metrics::bytes_histogram();
+    // Events the agent shed, from its ADMISSION_REPORT events: [source][reason].
+    std::array<std::array<metrics::Counter, 4>, 3> shed;
+};
+ReaderMetrics g_metrics;
+metrics::Registry g_registry;
 
 void signal_handler(int) {
     g_running = false;
 }
 
-int fast_system(const std::string& cmd) {
-    std::array<char, 128> buffer;
-    FILE* pipe = popen((cmd + " 2>&1").c_str(), "r");
-    if (!pipe) return -1;
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr);
-    return pclose(pipe);
-}
-
-std::string get_ipns_id_for_key(const std::string& key_name) {
-    FILE* pipe = popen("ipfs key list -l", "r");
-    if (!pipe) throw std::runtime_error("Failed to run 'ipfs key list -l'");
-    char buffer[256];
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        std::istringstream iss(buffer);
-        std::string peer_id, name;
-        iss >> peer_id >> name;
-        if (name == key_name) {
-            pclose(pipe);
-            return peer_id;
+// How long an event of the given severity may wait before it forces a push.
+int64_t flush_delay_ns(const Chain& c, uint8_t severity) {
+    switch (severity) {
+        case SEVERITY_CRITICAL: return Config::WorkerConfig::CRITICAL_FLUSH_MS * 1'000'000LL;
+        case SEVERITY_HIGH:
+            return std::min<int64_t>(Config::WorkerConfig::HIGH_FLUSH_MS * 1'000'000LL, c.controller->max_wait_ns());
+        case SEVERITY_LOW:
+            return std::max<int64_t>(Config::WorkerConfig::LOW_FLUSH_MS * 1'000'000LL, c.controller->max_wait_ns());
+        default: return c.controller->max_wait_ns();
+    }
+}
+
+void arm_flush_deadline(std::atomic<int64_t>& target, int64_t deadline_ns) {
+    int64_t current = target.load(std::memory_order_relaxed);
+    while (deadline_ns < current && !target.compare_exchange_weak(current, deadline_ns, std::memory_order_relaxed)) {}
+}
+
+int64_t next_flush_deadline(const Chain& c) {
+    int64_t next = c.unsent_deadline_ns.load(std::memory_order_relaxed);
+    for (const auto& d : c.shard_deadlines) next = std::min(next, d.ns.load(std::memory_order_relaxed));
+    return next;
+}
+
+int64_t next_flush_deadline() {
+    int64_t next = INT64_MAX;
+    for (const auto& c : g_chains) next = std::min(next, next_flush_deadline(*c));
+    return next;
+}
+
+// Adds a record to the chain's bucket. The deadline is armed after the push
+// so a flush that resets it cannot lose a record it did not collect.
+void add_pending(Chain& c, int worker, LogRecord&& rec) {
+    int64_t deadline = static_cast<int64_t>(rec.dequeued_monotonic_ns) + flush_delay_ns(c, rec.ev.severity);
+    const bool critical = rec.ev.severity == SEVERITY_CRITICAL;
+    c.bucket.push(worker, std::move(rec));
+    arm_flush_deadline(c.shard_deadlines[worker].ns, deadline);
+    if (critical) c.critical_pending.store(true, std::memory_order_relaxed);
+}
+
+// True when a chain's upload queue is full and its bucket already holds a
+// max_bytes batch. Workers then stop taking events, so the reader's memory
+// stays bounded through a daemon outage and the agents' admission control
+// sheds and counts what does not fit in their queues.
+bool uploads_backed_up() {
+    for (const auto& c : g_chains) {
+        size_t pending = c->bucket.pending() + c->unsent_count.load(std::memory_order_relaxed);
+        if (pending >= c->controller->max_events() && !c->uploader->has_capacity()) return true;
+    }
+    return false;
+}
+
+// Locks `m`, recording how long that took.
+std::unique_lock<std::mutex> lock_timed(std::mutex& m) {
+    std::unique_lock<std::mutex> lock(m, std::try_to_lock);
+    if (lock.owns_lock()) {
+        g_metrics.cid_lock_wait.observe(0);
+    } else {
+        uint64_t start_ns = monotonic_ns();
+        lock.lock();
+        g_metrics.cid_lock_wait.observe_ns(monotonic_ns() - start_ns);
+    }
+    return lock;
+}
+
+void count_shed(const AdmissionPayload& a) {
+    if (a.source > SOURCE_FILE) return;
+    auto& c = g_metrics.shed[a.source];
+    c[0].inc(a.sampled);
+    c[1].inc(a.dropped_rate);
+    c[2].inc(a.dropped_quota);
+    c[3].inc(a.dropped_full);
+}
+
+// Labels for one chain's series: as before for the single chain, with
+// chain="<name>" added otherwise.
+std::string chain_labels(const Chain& c, const std::string& labels = "") {
+    if (c.name.empty()) return labels;
+    return (labels.empty() ? "" : labels + ",") + "chain=\"" + c.name + "\"";
+}
+
+void register_metrics() {
+    auto& r = g_registry;
+    auto& m = g_metrics;
+    r.counter("rtsa_reader_events_total", "Events dequeued from the shared queues.", m.events);
+    r.counter("rtsa_reader_batches_sealed_total", "Batches encrypted and queued for upload.", m.batches_sealed);
+    r.counter("rtsa_reader_seal_failures_total", "Batches that failed to serialize or encrypt.", m.seal_failures);
+    r.counter("rtsa_reader_flush_contended_total", "Flush attempts that found another flush in progress.",
+              m.flush_contended);
+    r.counter("rtsa_reader_backpressure_waits_total",
+              "Worker passes that left the agent queues alone because uploads were backed up.",
+              m.backpressure_waits);
+
+    const char* stage_help = "Time spent per pipeline stage.";
+    r.histogram("rtsa_reader_stage_seconds", stage_help, m.queue_wait, "stage=\"queue_wait\"");
+    r.histogram("rtsa_reader_stage_seconds", stage_help, m.serialize, "stage=\"serialize\"");
+    r.histogram("rtsa_reader_stage_seconds", stage_help, m.encrypt, "stage=\"encrypt\"");
+    r.histogram("rtsa_reader_stage_seconds", stage_help, m.cid, "stage=\"cid\"");
+    r.histogram("rtsa_reader_stage_seconds", stage_help, m.cid_lock_wait, "stage=\"cid_lock_wait\"");
+    for (const auto& c : g_chains) {
+        const auto& t = c->uploader->timings();
+        r.histogram("rtsa_reader_stage_seconds", stage_help, t.add, chain_labels(*c, "stage=\"ipfs_add\""));
+        r.histogram("rtsa_reader_stage_seconds", stage_help, t.repair, chain_labels(*c, "stage=\"ipfs_repair\""));
+        r.histogram("rtsa_reader_stage_seconds", stage_help, t.publish, chain_labels(*c, "stage=\"ipns_publish\""));
+    }
+    r.histogram("rtsa_reader_stage_seconds", stage_help, m.stored, "stage=\"collect_to_stored\"");
+    r.histogram("rtsa_reader_batch_bytes", "Serialized size of sealed batches.", m.batch_bytes);
+
+    // One series per chain, registered family by family so each family's
+    // series stay together.
+    auto per_chain = [](auto&& add) {
+        for (const auto& c : g_chains) add(*c);
+    };
+    auto upload = [](const Chain& c, uint64_t IpfsUploader::Stats::*field) {
+        return [&c, field] { return static_cast<double>(c.uploader->stats().*field); };
+    };
+    per_chain([&](const Chain& c) {
+        r.counter("rtsa_reader_uploads_total", "Uploads verified against the local CID.",
+                  upload(c, &IpfsUploader::Stats::uploaded), chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        r.counter("rtsa_reader_upload_failures_total", "Failed upload attempts (retried).",
+                  upload(c, &IpfsUploader::Stats::failures), chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        r.counter("rtsa_reader_cid_mismatches_total", "Uploads whose daemon CID differed from the local one.",
+                  upload(c, &IpfsUploader::Stats::mismatches), chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        r.counter("rtsa_reader_uploads_repaired_total", "Mismatched uploads repaired by putting blocks.",
+                  upload(c, &IpfsUploader::Stats::repaired), chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        r.counter("rtsa_reader_uploads_abandoned_total", "Batches left on disk at shutdown.",
+                  upload(c, &IpfsUploader::Stats::abandoned), chain_labels(c));
+    });
+
+    per_chain([&](const Chain& c) {
+        const auto& arena = c.seal_arena.stats();
+        r.gauge("rtsa_reader_seal_arena_bytes", "Size of the block batches are sealed in.",
+                [&arena] { return static_cast<double>(arena.capacity.load(std::memory_order_relaxed)); },
+                chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        const auto& arena = c.seal_arena.stats();
+        r.gauge("rtsa_reader_seal_arena_last_allocations", "Allocations the last sealed batch made from the arena.",
+                [&arena] { return static_cast<double>(arena.last_allocations.load(std::memory_order_relaxed)); },
+                chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        const auto& arena = c.seal_arena.stats();
+        r.counter("rtsa_reader_seal_arena_heap_allocations_total",
+                  "Heap allocations by the seal arena: its block, and batches that outgrew it.",
+                  [&arena] { return static_cast<double>(arena.heap_allocations.load(std::memory_order_relaxed)); },
+                  chain_labels(c));
+    });
+
+    const char* backlog_help = "Events or batches waiting at each point of the pipeline.";
+    r.gauge("rtsa_reader_backlog", backlog_help, [] { return static_cast<double>(g_segments.backlog()); },
+            "at=\"shared_queue\"");
+    per_chain([&](const Chain& c) {
+        r.gauge("rtsa_reader_backlog", backlog_help, [&c] { return static_cast<double>(c.bucket.pending()); },
+                chain_labels(c, "at=\"bucket\""));
+        r.gauge("rtsa_reader_backlog", backlog_help,
+                [&c] { return static_cast<double>(c.unsent_count.load(std::memory_order_relaxed)); },
+                chain_labels(c, "at=\"unsent\""));
+        r.gauge("rtsa_reader_backlog", backlog_help, upload(c, &IpfsUploader::Stats::queued),
+                chain_labels(c, "at=\"upload_queue\""));
+    });
+
+    const auto& seg = g_segments.stats();
+    r.gauge("rtsa_reader_agents", "Agent queues being drained.",
+            [] { return static_cast<double>(g_segments.snapshot()->size()); });
+    r.counter("rtsa_reader_agents_attached_total", "Agent queues attached.",
+              [&seg] { return static_cast<double>(seg.attached.load(std::memory_order_relaxed)); });
+    r.counter("rtsa_reader_agents_detached_total", "Agent queues drained and detached after their agent left.",
+              [&seg] { return static_cast<double>(seg.detached.load(std::memory_order_relaxed)); });
+
+    auto batch = [](const Chain& c, auto field) {
+        return [&c, field] { return static_cast<double>(c.controller->snapshot().*field); };
+    };
+    per_chain([&](const Chain& c) {
+        r.gauge("rtsa_reader_arrival_rate", "Smoothed events/s seen by the batch controller.",
+                batch(c, &BatchController::Snapshot::arrival_rate), chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        r.gauge("rtsa_reader_push_latency_ms", "Smoothed collect-to-stored latency.",
+                batch(c, &BatchController::Snapshot::push_latency_ms), chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        r.gauge("rtsa_reader_batch_target_events", "Current batch size target.",
+                batch(c, &BatchController::Snapshot::target_events), chain_labels(c));
+    });
+    per_chain([&](const Chain& c) {
+        r.gauge("rtsa_reader_batch_max_wait_ms", "Current longest wait for a normal-severity event.",
+                batch(c, &BatchController::Snapshot::max_wait_ms), chain_labels(c));
+    });
+    if (Config::chains.enabled)
+        r.counter("rtsa_reader_manifests_published_total", "Manifests of the chain heads published.",
+                  g_manifest.published);
+
+    static const char* REASONS[] = {"sampled", "rate", "quota", "full"};
+    for (uint8_t s = SOURCE_SYSLOG; s <= SOURCE_FILE; ++s)
+        for (size_t reason = 0; reason < 4; ++reason)
+            r.counter("rtsa_agent_shed_total", "Events the agent sampled or dropped at admission.", m.shed[s][reason],
+                      std::string("source=\"") + event_source_name(s) + "\",reason=\"" + REASONS[reason] + "\"");
+}
+
+void on_upload_done(Chain& c, const UploadJob& job, bool ok) {
+    uint64_t stored_ns = monotonic_ns() - job.sealed_ns;
+    c.controller->on_push(job.events, job.bytes, stored_ns, ok, static_cast<BatchController::Trigger>(job.trigger));
+    if (!ok || job.events == 0) return;
+    g_metrics.stored.observe_ns(stored_ns);
+    auto m = c.controller->snapshot();
+    logger::info("BATCH", "{}{} events, {} bytes stored in {} ms; rate {} ev/s -> target {} events, wait {} ms",
+                 c.tag(), m.last_batch_events, m.last_batch_bytes, m.push_latency_ms, m.arrival_rate,
+                 m.target_events, m.max_wait_ms);
+}
+
+// One chain for everything, or one per configured group (by default one per
+// source). Throws on a group that cannot be used.
+void create_chains() {
+    const auto& cfg = Config::chains;
+    if (!cfg.enabled) {
+        g_chains.push_back(std::make_unique<Chain>("", Config::ipfs.ipns_key_name));
+        g_chain_by_source.fill(g_chains.front().get());
+        return;
+    }
+
+    std::vector<Config::ChainGroup> groups = cfg.groups;
+    if (groups.empty())
+        for (uint8_t s = SOURCE_SYSLOG; s <= SOURCE_FILE; ++s)
+            groups.push_back({event_source_name(s), "", {event_source_name(s)}});
+    for (const auto& g : groups) {
+        // The name becomes a directory and a metric label.
+        bool valid = !g.name.empty() && std::all_of(g.name.begin(), g.name.end(), [](char ch) {
+            return std::isalnum(static_cast<unsigned char>(ch)) || ch == '-' || ch == '_';
+        });
+        if (!valid) throw std::runtime_error("chain name '" + g.name + "' must be letters, digits, '-' or '_'");
+        for (const auto& c : g_chains)
+            if (c->name == g.name) throw std::runtime_error("chain '" + g.name + "' configured twice");
+        std::string key = g.ipns_key.empty() ? Config::ipfs.ipns_key_name + "-" + g.name : g.ipns_key;
+        Chain& chain = *g_chains.emplace_back(std::make_unique<Chain>(g.name, key));
+        for (const auto& name : g.sources) {
+            uint8_t source;
+            if (!event_source_from_string(name, source))
+                throw std::runtime_error("chain '" + g.name + "': unknown source '" + name + "'");
+            if (!g_chain_by_source[source]) g_chain_by_source[source] = &chain;
         }
     }
-    pclose(pipe);
-    throw std::runtime_error("IPNS key '" + key_name + "' not found.\nTry: ipfs key gen log-agent --type=rsa --size=2048\nipfs daemon --routing=dhtclient\n");
+    for (auto& c : g_chain_by_source)
+        if (!c) c = g_chains.front().get();
+    g_manifest.ipns_key = cfg.manifest_key.empty() ? Config::ipfs.ipns_key_name + "-manifest" : cfg.manifest_key;
+    for (uint8_t s = SOURCE_SYSLOG; s <= SOURCE_FILE; ++s)
+        logger::info("CHAIN", "{} events -> chain {} ({})", event_source_name(s), g_chain_by_source[s]->name,
+                     g_chain_by_source[s]->ipns_key);
 }
 
-std::string resolve_ipns(const std::string& ipns_id) {
-    std::string cmd = "ipfs name resolve --nocache /ipns/" + ipns_id + " --timeout=5s";
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) return "null";
-    char buffer[256];
-    std::string result;
-    while (fgets(buffer, sizeof(buffer), pipe)) result += buffer;
-    pclose(pipe);
-    if (result.rfind("/ipfs/", 0) == 0)
-        return result.substr(6);
-    return "null";
+// Resolves every chain's head, and the manifest's, in parallel: each lookup
+// may wait out the resolve timeout.
+void bootstrap_chains() {
+    auto resolve = [](const std::string& key, std::string& id, std::string& head, const std::string& tag) {
+        try {
+            id = get_ipns_id_for_key(key);
+            head = resolve_ipns(id);
+            logger::info("IPNS", "{}Bootstrapped from: {}", tag, head);
+        } catch (const std::exception& e) {
+            logger::warn("IPNS", "{}Could not bootstrap IPNS: {}", tag, e.what());
+        }
+    };
+    std::vector<std::thread> lookups;
+    for (auto& c : g_chains)
+        lookups.emplace_back([&c, &resolve] { resolve(c->ipns_key, c->ipns_id, c->resolved_head, c->tag()); });
+    std::string manifest_id;
+    if (Config::chains.enabled)
+        lookups.emplace_back([&] { resolve(g_manifest.ipns_key, manifest_id, g_manifest.prev, "[manifest] "); });
+    for (auto& t : lookups) t.join();
+    for (auto& c : g_chains) c->prev_cid = c->resolved_head;
 }
 
-void push_log_bucket_if_needed(bool force = false) {
-    std::lock_guard<std::mutex> lock(log_mutex);
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last_push_time).count();
-    if (!force && log_bucket.size() < LOG_THRESHOLD && elapsed < TIME_THRESHOLD_SECONDS)
+// Re-queues batches sealed but not uploaded by a previous run. They already
+// link back to the published head, so the chain continues from the newest.
+void recover_pending_uploads(Chain& c) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(c.upload_dir()))
+        if (entry.path().extension() == ".enc") files.push_back(entry.path());
+    std::sort(files.begin(), files.end());   // names sort in sealing order
+    for (const auto& path : files) {
+        UploadJob job;
+        job.path = path.string();
+        job.cid = cid::file_dag(cid::read_file_bytes(job.path), Config::ipfs.cid_version);
+        job.sealed_ns = monotonic_ns();
+        job.queued_ns = job.sealed_ns;
+        job.trigger = static_cast<uint8_t>(BatchController::Trigger::Force);
+        logger::warn("IPFS", "{}Recovering unsent batch {} ({})", c.tag(), job.path, job.cid.to_string());
+        c.prev_cid = job.cid.to_string();
+        c.uploader->submit(std::move(job));
+    }
+}
+
+// With chains enabled, batches a run without chains sealed but did not upload
+// are still in tmp/upload itself, which no chain reads. They link back to the
+// old single chain's head, so a chain of their own finishes them under
+// ipfs.ipns_key_name; it takes no new events and is not in the manifest.
+std::unique_ptr<Chain> make_legacy_chain() {
+    std::error_code ec;
+    bool leftovers = false;
+    for (const auto& entry : std::filesystem::directory_iterator(Config::dirs.get_tmp_path() + "/upload", ec))
+        leftovers |= entry.is_regular_file() && entry.path().extension() == ".enc";
+    if (!leftovers) return nullptr;
+    auto legacy = std::make_unique<Chain>("", Config::ipfs.ipns_key_name);
+    Chain* chain = legacy.get();
+    chain->controller = std::make_unique<BatchController>(Config::batch);
+    chain->uploader = std::make_unique<IpfsUploader>(
+        Config::ipfs.cid_version, chain->ipns_key,
+        [chain](const UploadJob& job, bool ok) { on_upload_done(*chain, job, ok); });
+    logger::warn("IPFS", "Uploading batches left from before chains were enabled under {}", chain->ipns_key);
+    recover_pending_uploads(*chain);
+    return legacy;
+}
+
+// Seals a batch of the chain when an event's severity deadline has passed or
+// the batch controller's target size is reached. Sealing links the batch to
+// its predecessor by locally computed CID and queues it for upload, so the
+// next batch never waits for the daemon; while the upload queue is full,
+// batches keep growing instead (up to uploads_backed_up()), except that a
+// due critical event is sealed regardless.
+void push_log_bucket_if_needed(Chain& c, bool force = false) {
+    size_t pending = c.bucket.pending() + c.unsent_count.load(std::memory_order_relaxed);
+    bool due = static_cast<int64_t>(monotonic_ns()) >= next_flush_deadline(c);
+    if (!force && !due && pending < c.controller->target_events())
+        return;
+    if (pending == 0) return;
+    if (!force && !c.uploader->has_capacity() && !(due && c.critical_pending.load(std::memory_order_relaxed)))
+        return;
+    if (c.flushing.exchange(true, std::memory_order_acquire)) {
+        g_metrics.flush_contended.inc();
         return;
-    if (log_bucket.empty()) return;
+    }
+
+    // A shard's deadline is cleared before its entries are taken: records
+    // published after that re-arm it themselves.
+    uint64_t collect_ns = monotonic_ns();
+    size_t collected = 0;
+    c.critical_pending.store(false, std::memory_order_relaxed);
+    for (size_t i = 0; i < c.shard_deadlines.size(); ++i) {
+        int64_t deadline = c.shard_deadlines[i].ns.exchange(INT64_MAX, std::memory_order_relaxed);
+        collected += c.bucket.collect_shard_into(i, c.unsent);
+        arm_flush_deadline(c.unsent_deadline_ns, deadline);
+    }
+    c.controller->on_collect(collected, collect_ns);
+    c.unsent_count.store(c.unsent.size(), std::memory_order_relaxed);
+    if (c.unsent.empty()) {
+        c.flushing.store(false, std::memory_order_release);
+        return;
+    }
 
-    std::vector<std::string> raw_logs;
-    for (const auto& log : log_bucket) raw_logs.push_back(log.dump());
+    // Shards are collected one after another; restore capture order. Event
+    // ids are per agent, so events from several agents are grouped by agent.
+    std::sort(c.unsent.begin(), c.unsent.end(), [](const LogRecord& a, const LogRecord& b) {
+        if (a.agent != b.agent) return std::less<const std::string*>()(a.agent, b.agent);
+        return a.ev.event_id < b.ev.event_id;
+    });
+    std::vector<uint64_t> trace_ids;
+    if (trace::enabled()) {
+        for (const auto& rec : c.unsent) {
+            if (!rec.ev.trace_id) continue;
+            trace::wait(rec.ev.trace_id, "bucket", rec.dequeued_monotonic_ns, collect_ns);
+            trace_ids.push_back(rec.ev.trace_id);
+        }
+    }
 
     std::string prev_cid;
     {
-        std::lock_guard<std::mutex> cid_lock(cid_mutex);
-        prev_cid = g_prev_cid;
+        auto cid_lock = lock_timed(c.cid_mutex);
+        prev_cid = c.prev_cid;
     }
 
-    std::string payload = format_logs_json(raw_logs, prev_cid);
+    uint64_t stage_ns = monotonic_ns();
+    write_log_batch(c.batch_buf, c.unsent, prev_cid, batch_format_from_string(Config::ipfs.batch_format),
+                    g_pattern_names, c.event_buf, c.scratch_buf);
+    const std::string& payload = c.batch_buf;
+    g_metrics.serialize.observe_ns(monotonic_ns() - stage_ns);
+    trace::batch_slice("serialize", stage_ns, monotonic_ns());
+    g_metrics.batch_bytes.observe(payload.size());
 
+    UploadJob job;
+    job.events = c.unsent.size();
+    job.bytes = payload.size();
+    job.sealed_ns = collect_ns;
+    job.trigger = static_cast<uint8_t>(force ? BatchController::Trigger::Force
+                                       : due ? BatchController::Trigger::Deadline
+                                             : BatchController::Trigger::Size);
+    bool sealed = false;
     try {
-        std::string pubkey_path = Config::encryption.public_key_path;
+        // Ciphertext and envelope come from the seal arena, reset below.
+        stage_ns = monotonic_ns();
+        std::pmr::memory_resource* arena = c.seal_arena.resource();
         std::vector<uint8_t> aes_key = generate_random_bytes(32);
-        std::vector<uint8_t> iv, tag;
-        std::vector<uint8_t> ciphertext = aes_gcm_encrypt(payload, aes_key, iv, tag);
-        std::vector<uint8_t> encrypted_key = rsa_encrypt_key(aes_key, pubkey_path);
-        std::string encrypted_file = Config::dirs.get_tmp_path() + "/log_batch.json.enc";
-        write_minimal_encrypted_json(encrypted_file, ciphertext, iv, tag, encrypted_key);
-
-        std::string cid = ipfs_add(encrypted_file);
-        std::cout << "[IPFS] Pushed CID: " << cid << "\n";
+        uint8_t iv[AES_GCM_IV_SIZE], tag[AES_GCM_TAG_SIZE];
+        std::pmr::vector<uint8_t> ciphertext(payload.size(), arena);
+        aes_gcm_encrypt_into(payload, aes_key.data(), iv, tag, ciphertext.data());
+        std::vector<uint8_t> encrypted_key = rsa_encrypt_key(aes_key, Config::encryption.public_key_path);
+        std::pmr::string envelope(arena);
+        format_encrypted_envelope(envelope, ciphertext.data(), ciphertext.size(), iv, sizeof(iv), tag, sizeof(tag),
+                                  encrypted_key.data(), encrypted_key.size());
+        char name[48];
+        snprintf(name, sizeof(name), "/batch-%020llu.enc", static_cast<unsigned long long>(realtime_ns()));
+        job.path = c.upload_dir() + name;
+        write_file_bytes(job.path, envelope);
+        g_metrics.encrypt.observe_ns(monotonic_ns() - stage_ns);
+        trace::batch_slice("encrypt", stage_ns, monotonic_ns());
+        stage_ns = monotonic_ns();
+        job.cid = cid::file_root(envelope, Config::ipfs.cid_version, arena);
+        g_metrics.cid.observe_ns(monotonic_ns() - stage_ns);
+        trace::batch_slice("cid", stage_ns, monotonic_ns());
 
         {
-            std::lock_guard<std::mutex> cid_lock(cid_mutex);
-            g_prev_cid = cid;
+            auto cid_lock = lock_timed(c.cid_mutex);
+            c.prev_cid = job.cid.to_string();
         }
+        logger::debug("IPFS", "{}Sealed {} events as {}", c.tag(), job.events, job.cid.to_string());
+        if (!trace_ids.empty()) {
+            trace::batch_slice("seal", collect_ns, monotonic_ns());
+            for (uint64_t id : trace_ids) trace::flow(id, collect_ns);
+            job.trace_ids = std::move(trace_ids);
+        }
+        job.queued_ns = monotonic_ns();
+        c.uploader->submit(std::move(job));
 
-        std::string publish_cmd =
-            "ipfs name publish --key=" + Config::ipfs.ipns_key_name +
-            " --allow-offline --ttl=" + std::to_string(Config::IPFSConfig::IPNS_TTL_SECONDS) + "s /ipfs/" + cid;
-        int ret = fast_system(publish_cmd);
-        if (ret == 0)
-            std::cout << "[IPNS] Head updated to: " << cid << "\n";
-        else
-            std::cerr << "[IPNS] Failed to update IPNS head.\n";
-
-        log_bucket.clear();
-        last_push_time = std::chrono::steady_clock::now();
+        c.unsent.clear();
+        c.unsent_count.store(0, std::memory_order_relaxed);
+        c.unsent_deadline_ns.store(INT64_MAX, std::memory_order_relaxed);
+        g_metrics.batches_sealed.inc();
+        sealed = true;
     } catch (const std::exception& e) {
-        std::cerr << "[ERROR] Push failed: " << e.what() << "\n";
+        g_metrics.seal_failures.inc();
+        logger::error("IPFS", "{}Sealing batch failed: {}", c.tag(), e.what());
+        if (std::any_of(c.unsent.begin(), c.unsent.end(),
+                        [](const LogRecord& r) { return r.ev.severity == SEVERITY_CRITICAL; }))
+            c.critical_pending.store(true, std::memory_order_relaxed);
     }
+    c.seal_arena.reset();
+    const auto& arena = c.seal_arena.stats();
+    logger::debug("BATCH", "{}Seal arena: {} allocations, {} of {} bytes", c.tag(), arena.last_allocations.load(),
+                  arena.last_bytes.load(), arena.capacity.load());
+    c.flushing.store(false, std::memory_order_release);
+
+    // A critical event that arrived while sealing must not wait for the next
+    // worker or flusher tick.
+    if (sealed && static_cast<int64_t>(monotonic_ns()) >= next_flush_deadline(c))
+        push_log_bucket_if_needed(c);
 }
 
-void worker_thread(int id, QueueType* queue) {
+// Writes {"timestamp", "chains": {name: {"ipns_key", "ipns", "head"}},
+// "prev_manifest"}, adds it and points the manifest key at it, if any chain
+// head moved since the last manifest. Unencrypted: it holds only names and
+// CIDs, all of them public anyway.
+void publish_manifest() {
+    std::vector<std::string> heads;
+    for (const auto& c : g_chains) heads.push_back(c->head());
+    if (heads == g_manifest.heads) return;
+
+    json manifest;
+    manifest["timestamp"] = current_timestamp();
+    for (size_t i = 0; i < g_chains.size(); ++i) {
+        const Chain& c = *g_chains[i];
+        manifest["chains"][c.name] = {
+            {"ipns_key", c.ipns_key},
+            {"ipns", c.ipns_id.empty() ? json(nullptr) : json(c.ipns_id)},
+            {"head", heads[i] == "null" ? json(nullptr) : json(heads[i])}
+        };
+    }
+    manifest["prev_manifest"] = g_manifest.prev == "null" ? json(nullptr) : json(g_manifest.prev);
+
+    std::string path = Config::dirs.get_tmp_path() + "/manifest.json";
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << manifest.dump(2);
+        if (!out) {
+            logger::error("IPNS", "Cannot write manifest {}", path);
+            return;
+        }
+    }
+    std::string cid = ipfs_add(path, Config::ipfs.cid_version);
+    if (cid.empty()) return;
+    if (!ipns_publish(g_manifest.ipns_key, cid)) {
+        logger::error("IPNS", "Failed to publish manifest {} under {}", cid, g_manifest.ipns_key);
+        return;
+    }
+    g_manifest.prev = cid;
+    g_manifest.heads = std::move(heads);
+    g_manifest.published.inc();
+    logger::info("IPNS", "Manifest of {} chain heads published: {}", g_chains.size(), cid);
+}
+
+// Publishes the manifest every manifest_interval_s on its own thread: adding
+// and publishing it waits on the daemon, which must not hold up the segment
+// scan.
+void manifest_publisher() {
+    trace::set_thread_name("manifest");
+    const auto interval = std::chrono::seconds(Config::chains.manifest_interval_s);
+    auto next = std::chrono::steady_clock::now() + interval;
     while (g_running) {
-        RawEvent ev{};
-        if (queue->dequeue(ev)) {
-            json log_entry = {
-                {"event_id", ev.event_id},
-                {"type", ev.type == 0 ? "SYSLOG" : ev.type == 1 ? "USB" : "SYSTEM"},
-                {"message", std::string(ev.text)},
-                {"timestamp", current_timestamp()}
-            };
-            {
-                std::lock_guard<std::mutex> lock(log_mutex);
-                log_bucket.push_back(log_entry);
-            }
-            std::cout << "[" << log_entry["type"] << "][Worker " << id << "] " << ev.text << "\n";
-            push_log_bucket_if_needed();
-        } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(Config::SharedMemoryConfig::SEGMENT_SCAN_MS));
+        if (std::chrono::steady_clock::now() < next) continue;
+        publish_manifest();
+        next = std::chrono::steady_clock::now() + interval;
+    }
+}
+
+// Takes up to `limit` events from one agent's queue.
+size_t drain_segment(int id, QueueSegments::Segment& seg, size_t limit) {
+    size_t taken = 0;
+    RawEvent ev{};
+    while (taken < limit && seg.queue->try_dequeue(ev)) {
+        ++taken;
+        if (logger::enabled<logger::Level::Debug>()) {
+            // The agent already logs every event; the reader echo is for debugging only.
+            thread_local std::string message;
+            message.clear();
+            append_event_message(message, ev);
+            logger::debug("WORKER", "[{}][Worker {}] {}", event_type_name(ev.type), id, message);
+        }
+        uint64_t now = monotonic_ns();
+        g_metrics.events.inc();
+        if (now >= ev.capture_monotonic_ns) g_metrics.queue_wait.observe_ns(now - ev.capture_monotonic_ns);
+        if (ev.type == ADMISSION_REPORT) count_shed(ev.admission);
+        Chain& chain = *g_chain_by_source[event_source(ev)];
+        add_pending(chain, id, LogRecord{ev, now, seg.agent});
+        if (ev.trace_id) {
+            trace::wait(ev.trace_id, "shared_queue", ev.capture_monotonic_ns, now);
+            trace::span(ev.trace_id, "add_pending", now, monotonic_ns());
+        }
+        push_log_bucket_if_needed(chain);
+    }
+    return taken;
+}
+
+// Segment i is worker (i % NUM_WORKERS)'s home. A worker takes a burst from
+// each of its home segments in turn and steals from the others only when all
+// of its own are empty, so one busy agent cannot starve the rest and no
+// agent waits on a particular worker. With a single queue every worker
+// but the first is stealing, as before.
+void worker_thread(int id) {
+    trace::set_thread_name("worker");
+    thread_profile::apply("worker", Config::threads.worker);
+    size_t turn = 0;
+    while (g_running) {
+        if (uploads_backed_up()) {
+            g_metrics.backpressure_waits.inc();
             std::this_thread::sleep_for(std::chrono::milliseconds(WORKER_SLEEP_MS));
+            continue;
+        }
+        auto segments = g_segments.snapshot();
+        const size_t n = segments->size();
+        size_t taken = 0;
+        for (bool steal : {false, true}) {
+            if (taken) break;
+            for (size_t k = 0; k < n; ++k) {
+                size_t i = (turn + k) % n;
+                if ((i % NUM_WORKERS == static_cast<size_t>(id)) == steal) continue;
+                taken += drain_segment(id, *(*segments)[i], Config::SharedMemoryConfig::SEGMENT_BURST);
+            }
         }
+        ++turn;
+        if (!taken) std::this_thread::sleep_for(std::chrono::milliseconds(WORKER_SLEEP_MS));
     }
 }
 
 void periodic_flusher() {
+    trace::set_thread_name("flusher");
+    thread_profile::apply("flusher", Config::threads.flusher);
     while (g_running) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(FLUSHER_SLEEP_MS));
-        push_log_bucket_if_needed();
+        // Wake early for the next severity deadline so high-severity events are
+        // not held up to a full flusher period.
+        int64_t until_deadline = next_flush_deadline() - static_cast<int64_t>(monotonic_ns());
+        int64_t sleep_ms = std::clamp<int64_t>(until_deadline / 1'000'000, 1, FLUSHER_SLEEP_MS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+        for (auto& c : g_chains) push_log_bucket_if_needed(*c);
     }
 }
 
 void ensure_directories() {
     std::filesystem::create_directories(Config::dirs.get_tmp_path());
+    for (const auto& c : g_chains) std::filesystem::create_directories(c->upload_dir());
 }
 
 int main() {
@@ -175,36 +721,89 @@ int main() {
     // Initialize configuration
     Config::initialize_config();
     Config::load_config_from_file();
+    logger::start("reader");
+    trace::init("reader", Config::trace.sample_every, Config::TraceConfig::BUFFER_RECORDS);
+    trace::set_thread_name("main");
     
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
+    try {
+        create_chains();
+    } catch (const std::exception& e) {
+        logger::error("CHAIN", "Invalid chains configuration: {}", e.what());
+        logger::stop();
+        return EXIT_FAILURE;
+    }
     ensure_directories();
+    bootstrap_chains();
 
+    // Same list the agent indexed its matches against.
     try {
-        g_ipns_id = get_ipns_id_for_key(Config::ipfs.ipns_key_name);
-        g_prev_cid = resolve_ipns(g_ipns_id);
-        std::cout << "[IPNS] Bootstrapped from: " << g_prev_cid << "\n";
+        g_pattern_names = load_patterns();
     } catch (const std::exception& e) {
-        std::cerr << "[IPNS] Could not bootstrap IPNS: " << e.what() << "\n";
+        logger::error("PATTERNS", "{}", e.what());
+        logger::stop();
+        return EXIT_FAILURE;
+    }
+    for (auto& c : g_chains) {
+        Chain* chain = c.get();
+        chain->controller = std::make_unique<BatchController>(Config::batch);
+        chain->uploader = std::make_unique<IpfsUploader>(
+            Config::ipfs.cid_version, chain->ipns_key,
+            [chain](const UploadJob& job, bool ok) { on_upload_done(*chain, job, ok); });
+        try {
+            recover_pending_uploads(*chain);
+        } catch (const std::exception& e) {
+            logger::error("IPFS", "{}Recovering unsent batches failed: {}", chain->tag(), e.what());
+        }
+    }
+    std::unique_ptr<Chain> legacy;
+    if (Config::chains.enabled) {
+        try {
+            legacy = make_legacy_chain();
+        } catch (const std::exception& e) {
+            logger::error("IPFS", "Recovering batches from before chains were enabled failed: {}", e.what());
+        }
     }
+    // Heads already named by the published manifest need no new one.
+    if (Config::chains.enabled && g_manifest.prev != "null")
+        for (const auto& c : g_chains) g_manifest.heads.push_back(c->resolved_head);
+
+    g_segments.open();
+    if (Config::threads.lock_memory) thread_profile::lock_memory();
 
-    SharedMemory<QueueType> shm(Config::shared_memory.queue_file_path, false);
-    QueueType* queue = shm.get();
+    register_metrics();
+    std::unique_ptr<metrics::Server> metrics_server;
+    if (Config::metrics.enabled) metrics_server = std::make_unique<metrics::Server>(g_registry, Config::metrics);
 
-    log_bucket.reserve(LOG_THRESHOLD * 2);
-    last_push_time = std::chrono::steady_clock::now();
 
     std::vector<std::thread> pool;
     for (int i = 0; i < NUM_WORKERS; ++i)
-        pool.emplace_back(worker_thread, i, queue);
+        pool.emplace_back(worker_thread, i);
 
     std::thread flusher(periodic_flusher);
+    std::thread manifest;
+    if (Config::chains.enabled) manifest = std::thread(manifest_publisher);
+
+    // Agents come and go under queue_dir.
+    while (g_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(Config::SharedMemoryConfig::SEGMENT_SCAN_MS));
+        g_segments.scan();
+    }
 
     for (auto& t : pool) t.join();
     flusher.join();
+    if (manifest.joinable()) manifest.join();
 
-    push_log_bucket_if_needed(true);
-    std::cout << ":checkered_flag: Reader shutdown.\n";
+    for (auto& c : g_chains) push_log_bucket_if_needed(*c, true);
+    for (auto& c : g_chains) c->uploader->stop();
+    if (legacy) legacy->uploader->stop();
+    if (Config::chains.enabled) publish_manifest();
+    metrics_server.reset();
+    std::string trace_path = trace::write_process_file(Config::trace.dir);
+    if (!trace_path.empty()) logger::info("READER", "Trace written to {}", trace_path);
+    logger::info("READER", ":checkered_flag: Reader shutdown.");
+    logger::stop();
     exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
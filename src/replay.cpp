@@ -0,0 +1,158 @@
+// Record and replay of shared-memory queue traffic.
+//
+//   replay record <file> [--duration S] [--count N]
+//       Attach to the queue as its consumer (run instead of the reader) and
+//       write every dequeued RawEvent to <file>.
+//   replay play <file> [--speed X | --max] [--restamp] [--loop N]
+//       Create the queue as its producer (run instead of the agent, before the
+//       reader) and enqueue the captured events, paced by their original
+//       capture times scaled by X (default 1), or as fast as possible.
+//   replay info <file>
+//       Print event counts per type, time span and size of a capture.
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include "shared_memory.hpp"
+#include "queue_segments.hpp"
+#include "capture_file.hpp"
+#include "event.hpp"
+#include "config.hpp"
+
+std::atomic<bool> g_running(true);
+
+void signal_handler(int) {
+    g_running = false;
+}
+
+int record(const std::string& path, int duration_s, uint64_t max_count) {
+    SharedMemory<QueueType> shm(agent_queue_path(), false);
+    QueueType* queue = shm.get();
+    CaptureWriter writer(path);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(duration_s);
+    RawEvent ev;
+    while (g_running && (duration_s <= 0 || std::chrono::steady_clock::now() < deadline) &&
+           (max_count == 0 || writer.count() < max_count)) {
+        if (queue->dequeue(ev)) writer.write(ev);
+        else std::this_thread::sleep_for(std::chrono::milliseconds(Config::WorkerConfig::WORKER_SLEEP_MS));
+    }
+    writer.flush();
+    std::cout << "Recorded " << writer.count() << " events (" << writer.bytes() << " bytes) to " << path << "\n";
+    return 0;
+}
+
+int play(const std::string& path, double speed, bool restamp, int loops) {
+    CaptureReader reader(path);
+    const std::string queue_path = agent_queue_path();
+    QueueOwnerLock queue_lock(queue_path);
+    SharedMemory<QueueType> shm(queue_path, true);
+    QueueType* queue = shm.get();
+    queue->init();
+
+    uint64_t sent = 0;
+    uint64_t max_id = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int loop = 0; loop < loops && g_running; ++loop) {
+        reader.rewind();
+        uint64_t id_offset = loop ? (max_id + 1) * loop : 0;
+        uint64_t first_ns = 0;
+        auto loop_start = std::chrono::steady_clock::now();
+
+        RawEvent ev;
+        while (g_running && reader.next(ev)) {
+            if (loop == 0) max_id = std::max(max_id, ev.event_id);
+            if (!first_ns) first_ns = ev.capture_monotonic_ns;
+
+            if (speed > 0 && ev.capture_monotonic_ns > first_ns) {
+                auto offset = std::chrono::nanoseconds(
+                    static_cast<uint64_t>((ev.capture_monotonic_ns - first_ns) / speed));
+                std::this_thread::sleep_until(loop_start + offset);
+            }
+            ev.event_id += id_offset;
+            ev.trace_id = 0;   // recorded by an agent that is not running
+            if (restamp) stamp_capture(ev);
+            while (!queue->enqueue(ev)) std::this_thread::yield();
+            ++sent;
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << sent << " events in " << secs << " s (" << (secs > 0 ? sent / secs : 0)
+              << " events/s)\n";
+    return 0;
+}
+
+int info(const std::string& path) {
+    CaptureReader reader(path);
+    constexpr size_t TYPES = 8;
+    uint64_t per_type[TYPES] = {};
+    uint64_t count = 0, bytes = sizeof(CaptureHeader), first_ns = 0, last_ns = 0;
+    RawEvent ev;
+    while (reader.next(ev)) {
+        ++per_type[std::min<size_t>(ev.type, TYPES - 1)];
+        ++count;
+        bytes += sizeof(uint16_t) + capture_wire_size(ev);
+        if (!first_ns) first_ns = ev.capture_monotonic_ns;
+        last_ns = ev.capture_monotonic_ns;
+    }
+    std::cout << path << ": " << count << " events, " << bytes << " bytes, span "
+              << (last_ns - first_ns) / 1e9 << " s\n";
+    for (uint8_t t = 0; t < TYPES; ++t)
+        if (per_type[t]) std::cout << "  " << event_type_name(t) << ": " << per_type[t] << "\n";
+    return 0;
+}
+
+void usage() {
+    std::cout << "Usage:\n"
+                 "  replay record <file> [--duration S] [--count N]\n"
+                 "  replay play <file> [--speed X | --max] [--restamp] [--loop N]\n"
+                 "  replay info <file>\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    std::string cmd = argv[1];
+    std::string path = argv[2];
+    int duration_s = 0;
+    uint64_t count = 0;
+    double speed = 1.0;
+    bool restamp = false;
+    int loops = 1;
+
+    for (int i = 3; i < argc; ++i) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--duration" && has_value) duration_s = std::stoi(argv[++i]);
+        else if (a == "--count" && has_value) count = std::stoull(argv[++i]);
+        else if (a == "--speed" && has_value) speed = std::stod(argv[++i]);
+        else if (a == "--max") speed = 0;
+        else if (a == "--restamp") restamp = true;
+        else if (a == "--loop" && has_value) loops = std::max(1, std::stoi(argv[++i]));
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    Config::initialize_config();
+    Config::load_config_from_file();
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    try {
+        if (cmd == "record") return record(path, duration_s, count);
+        if (cmd == "play") return play(path, speed, restamp, loops);
+        if (cmd == "info") return info(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    usage();
+    return 1;
+}
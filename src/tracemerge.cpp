@@ -0,0 +1,44 @@
+// Merges the trace files written by the agent and the reader into one file
+// for Perfetto (https://ui.perfetto.dev) or chrome://tracing.
+//
+//   tracemerge <out.json> [in.json...]
+//       Without inputs, merges every *.json in the configured trace directory
+//       (tmp/trace by default).
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include "trace.hpp"
+#include "config.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: tracemerge <out.json> [in.json...]\n";
+        return 1;
+    }
+    std::string out = argv[1];
+    std::vector<std::string> inputs(argv + 2, argv + argc);
+
+    if (inputs.empty()) {
+        Config::initialize_config();
+        Config::load_config_from_file();
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(Config::trace.dir, ec))
+            if (entry.path().extension() == ".json") inputs.push_back(entry.path().string());
+        std::sort(inputs.begin(), inputs.end());
+        if (inputs.empty()) {
+            std::cerr << "No trace files in " << Config::trace.dir << "\n";
+            return 1;
+        }
+    }
+
+    try {
+        trace::merge_files(out, inputs);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    std::cout << "Merged " << inputs.size() << " trace files into " << out << "\n";
+    return 0;
+}
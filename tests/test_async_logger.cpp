@@ -0,0 +1,43 @@
+// Logger record encoding: arguments that overflow the record's data area must
+// render as a placeholder rather than being decoded from stale bytes.
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "async_logger.hpp"
+#include "test_harness.hpp"
+
+using logger::detail::Record;
+using logger::detail::encode_record;
+
+template<typename... Args>
+std::string round_trip(const char* fmt, const Args&... args) {
+    Record r;
+    memset(&r, 0xAB, sizeof(r));   // stale bytes a bad decode would pick up
+    encode_record(r, fmt, args...);
+    std::string out;
+    r.format(out, r.fmt, r.data, r.arg_count);
+    return out;
+}
+
+int main() {
+    constexpr size_t DATA = sizeof(Record::data);
+
+    CHECK_EQ(round_trip("{} {} {} {}", 42, std::string("abc"), -7L, true), "42 abc -7 true");
+
+    // A string longer than the data area is cut short; what follows is dropped.
+    std::string huge(DATA * 2, 'x');
+    CHECK_EQ(round_trip("{} [{}] [{}]", huge, 5u, std::string_view("tail")),
+             std::string(DATA - sizeof(uint16_t), 'x') + " […] […]");
+
+    // A number that no longer fits stops encoding; later strings are not read
+    // even if their length prefix would fit.
+    std::string filler(DATA - sizeof(uint16_t) - 4, 'y');
+    CHECK_EQ(round_trip("{}|{}|{}", filler, uint64_t(1), std::string_view("z")), filler + "|…|…");
+
+    // Exactly full: the last argument still fits.
+    std::string exact(DATA - sizeof(uint16_t) - sizeof(uint32_t), 'q');
+    CHECK_EQ(round_trip("{}|{}", exact, uint32_t(9)), exact + "|9");
+
+    return test::finish("async_logger");
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// Minimal test harness shared by everything under tests/.
+//
+// Each test file is a standalone program: CHECK records a failure with its
+// location and keeps going, and finish() prints a summary and returns the
+// exit status.
+//
+//     CHECK(bucket.pending() == 0);
+//     CHECK_EQ(rendered, "add 046d:c52b /dev/bus/usb/001/002");
+//     return test::finish("log_bucket");
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+namespace test {
+
+inline int& failures() {
+    static int n = 0;
+    return n;
+}
+
+inline void fail(const char* file, int line, const std::string& what) {
+    ++failures();
+    fprintf(stderr, "%s:%d: FAILED: %s\n", file, line, what.c_str());
+}
+
+template<typename A, typename B>
+void check_eq(const A& a, const B& b, const char* expr, const char* file, int line) {
+    if (a == b) return;
+    std::ostringstream out;
+    out << expr << "\n    got:      " << a << "\n    expected: " << b;
+    fail(file, line, out.str());
+}
+
+inline int finish(const char* suite) {
+    if (failures()) {
+        fprintf(stderr, "[%s] %d check(s) failed\n", suite, failures());
+        return 1;
+    }
+    printf("[%s] all checks passed\n", suite);
+    return 0;
+}
+
+}  // namespace test
+
+#define CHECK(cond) \
+    do { if (!(cond)) test::fail(__FILE__, __LINE__, #cond); } while (0)
+#define CHECK_EQ(a, b) test::check_eq((a), (b), #a " == " #b, __FILE__, __LINE__)
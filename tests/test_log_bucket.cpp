@@ -0,0 +1,66 @@
+// ShardedLogBucket under a concurrent collector: every pushed entry must be
+// collected exactly once, in push order per shard.
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "log_bucket.hpp"
+#include "test_harness.hpp"
+
+struct Entry {
+    uint32_t shard;
+    uint64_t seq;
+};
+
+// `shards` workers push `per_shard` entries each while one thread collects in
+// a tight loop; a last collect picks up the tail.
+void push_while_collecting(size_t shards, uint64_t per_shard) {
+    ShardedLogBucket<Entry> bucket(shards, 100);
+    std::atomic<size_t> done(0);
+    std::vector<uint64_t> next(shards, 0);
+    uint64_t collected = 0;
+    bool in_order = true;
+
+    auto account = [&](std::vector<Entry>& out) {
+        for (const auto& e : out) {
+            in_order &= e.seq == next[e.shard];
+            next[e.shard] = e.seq + 1;
+        }
+        collected += out.size();
+        out.clear();
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < shards; ++w) {
+        workers.emplace_back([&, w] {
+            for (uint64_t i = 0; i < per_shard; ++i) bucket.push(w, Entry{static_cast<uint32_t>(w), i});
+            done.fetch_add(1);
+        });
+    }
+    std::thread collector([&] {
+        std::vector<Entry> out;
+        while (done.load() < shards) {
+            size_t taken = 0;
+            for (size_t i = 0; i < shards; ++i) taken += bucket.collect_shard_into(i, out);
+            CHECK_EQ(taken, out.size());
+            account(out);
+            if (!taken) std::this_thread::yield();
+        }
+    });
+    for (auto& t : workers) t.join();
+    collector.join();
+
+    std::vector<Entry> out;
+    bucket.collect_into(out);
+    account(out);
+
+    CHECK_EQ(collected, shards * per_shard);
+    CHECK(in_order);
+    CHECK_EQ(bucket.pending(), 0u);
+}
+
+int main() {
+    for (int run = 0; run < 3; ++run) push_while_collecting(1, 2'000'000);
+    push_while_collecting(4, 500'000);
+    return test::finish("log_bucket");
+}
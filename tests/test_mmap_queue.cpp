@@ -0,0 +1,52 @@
+// MmapQueue: FIFO order through wrap-around, full and empty detection, and
+// that release_abandoned() frees a slot whose consumer died mid-dequeue.
+#include <memory>
+#include "mmap_queue.hpp"
+#include "test_harness.hpp"
+
+constexpr size_t N = 4;
+using Queue = MmapQueue<int, N>;
+
+void wraps_in_order() {
+    auto q = std::make_unique<Queue>();
+    q->init();
+    int next_in = 0, next_out = 0, v;
+    for (int round = 0; round < 5; ++round) {
+        while (q->try_enqueue(next_in, 1)) ++next_in;
+        CHECK_EQ(q->size_approx(), N);
+        while (q->try_dequeue(v)) CHECK_EQ(v, next_out++);
+        CHECK_EQ(q->size_approx(), size_t(0));
+    }
+    CHECK_EQ(next_out, static_cast<int>(5 * N));
+    CHECK_EQ(q->release_abandoned(), size_t(0));
+}
+
+// A consumer that claimed position 0 (advanced head) and died before freeing
+// the slot leaves it unusable for the next lap.
+void abandoned_claim_is_released() {
+    auto q = std::make_unique<Queue>();
+    q->init();
+    for (int i = 0; i < static_cast<int>(N); ++i) CHECK(q->try_enqueue(i, 1));
+    q->head.fetch_add(1);   // the dead consumer's claim
+    int v;
+    for (int i = 1; i < static_cast<int>(N); ++i) {
+        CHECK(q->try_dequeue(v));
+        CHECK_EQ(v, i);
+    }
+    CHECK(!q->try_enqueue(99, 1));   // the next lap starts at the claimed slot
+
+    CHECK_EQ(q->release_abandoned(), size_t(1));
+    CHECK_EQ(q->release_abandoned(), size_t(0));
+    for (int i = 0; i < static_cast<int>(N); ++i) CHECK(q->try_enqueue(10 + i, 1));
+    for (int i = 0; i < static_cast<int>(N); ++i) {
+        CHECK(q->try_dequeue(v));
+        CHECK_EQ(v, 10 + i);
+    }
+    CHECK(!q->try_dequeue(v));
+}
+
+int main() {
+    wraps_in_order();
+    abandoned_claim_is_released();
+    return test::finish("mmap_queue");
+}
@@ -0,0 +1,49 @@
+// PatternAutomaton cache files: a file whose header disagrees with the
+// caller's pattern list must not be mapped, even if its key matches.
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "pattern_automaton.hpp"
+#include "test_harness.hpp"
+
+// Rewrites the header's pattern_count in place, leaving the key alone.
+void forge_pattern_count(const std::string& path, uint32_t count) {
+    FILE* f = fopen(path.c_str(), "r+b");
+    CHECK(f != nullptr);
+    if (!f) return;
+    fseek(f, offsetof(AutomatonHeader, pattern_count), SEEK_SET);
+    fwrite(&count, sizeof(count), 1, f);
+    fclose(f);
+}
+
+int main() {
+    const std::vector<std::string> patterns = {"error", "fail", "usb"};
+    const auto key = PatternAutomaton::key_for(patterns);
+    const uint32_t count = static_cast<uint32_t>(patterns.size());
+    const std::string path = "/tmp/test_pattern_automaton." + std::to_string(getpid()) + ".acm";
+    PatternAutomaton::build(patterns).save(path);
+
+    std::string why;
+    auto mapped = PatternAutomaton::open(path, key, count, why);
+    CHECK(mapped.has_value());
+    if (mapped) {
+        std::vector<uint32_t> ids;
+        mapped->for_each_match("usb fail", [&](uint32_t id) { ids.push_back(id); });
+        CHECK(ids == (std::vector<uint32_t>{2, 1}));
+    }
+
+    CHECK(!PatternAutomaton::open(path, key, count + 1, why));
+    CHECK_EQ(why, "patterns changed");
+
+    // A larger count in the file would let out-of-range ids through.
+    forge_pattern_count(path, 1000);
+    why.clear();
+    CHECK(!PatternAutomaton::open(path, key, count, why));
+    CHECK_EQ(why, "patterns changed");
+
+    unlink(path.c_str());
+    return test::finish("pattern_automaton");
+}
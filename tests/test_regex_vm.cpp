@@ -0,0 +1,100 @@
+// regex::Regex: which patterns the parser accepts, what search() matches, and
+// that required_literals() never rules out a line the pattern matches (the
+// PatternMatcher prefilter relies on it).
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "regex_vm.hpp"
+#include "test_harness.hpp"
+
+bool parses(const std::string& pattern) {
+    try {
+        regex::Regex re(pattern);
+        return true;
+    } catch (const std::invalid_argument&) {
+        return false;
+    }
+}
+
+bool matches(const std::string& pattern, const std::string& text) { return regex::Regex(pattern).search(text); }
+
+void parser() {
+    for (const char* ok : {"abc", "a|b|", "(a|b)*c", "(?:ab)+", "[a-z0-9_]", "[^\\d]", "[]a]", "[a-]", "a{3}",
+                           "a{2,}", "a{2,5}", "a{,3}", "a{x}", "[\\d-z]", "\\x41\\t\\.", "^a$", "a*?", "\\w\\W\\s\\S\\d\\D", ""})
+        CHECK(parses(ok));
+    for (const char* bad : {"(ab", "ab)", "*a", "a|+", "[abc", "[z-a]", "a{5,2}", "a{1001}", "\\", "\\b", "\\1",
+                            "(?=a)", "(?<n>a)", "\\xZ1"})
+        CHECK(!parses(bad));
+}
+
+void search() {
+    CHECK(matches("segfault", "kernel: app[12]: segfault at 0"));
+    CHECK(!matches("segfault", "kernel: app[12]: segv"));
+    CHECK(matches("^kernel", "kernel: x"));
+    CHECK(!matches("^kernel", " kernel: x"));
+    CHECK(matches("x$", "abx"));
+    CHECK(!matches("x$", "xab"));
+    CHECK(matches("fail(ed|ure)", "auth failure for root"));
+    CHECK(!matches("fail(ed|ure)", "auth fails"));
+    CHECK(matches("port \\d{2,4}$", "port 8080"));
+    CHECK(matches("x[abcd]{3}y", "xabcy"));
+    CHECK(!matches("x[abcd]{3}y", "xaby"));
+    CHECK(!matches("x[abcd]{3}y", "xabcdy"));
+    CHECK(matches("a.c", "abc"));
+    CHECK(!matches("a.c", "a\nc"));
+    CHECK(matches("[^a-c]", "abcd"));
+    CHECK(!matches("[^a-c]", "abcabc"));
+    CHECK(matches("(a|ab)(c|bcd)", "abcd"));
+    CHECK(matches("a{2,}", "caab"));
+    CHECK(!matches("a{2,}", "cab"));
+    CHECK(matches("", "anything"));
+    // No backtracking blow-up: linear in the line.
+    CHECK(!matches("(a*)*b", std::string(5000, 'a')));
+}
+
+// Every string over `alphabet` up to `max_len` that the pattern matches must
+// contain one of its required literals.
+void required_literals_hold(const std::string& pattern, const std::string& alphabet, size_t max_len) {
+    regex::Regex re(pattern);
+    const auto& required = re.required_literals();
+    if (required.empty()) return;
+    std::string text;
+    size_t matched = 0, missed = 0;
+    auto visit = [&](auto&& self) -> void {
+        if (re.search(text)) {
+            ++matched;
+            bool hit = std::any_of(required.begin(), required.end(),
+                                   [&](const std::string& lit) { return text.find(lit) != std::string::npos; });
+            if (!hit && missed++ == 0) test::fail(__FILE__, __LINE__, "'" + pattern + "' matches '" + text +
+                                                  "' which contains none of its required literals");
+        }
+        if (text.size() == max_len) return;
+        for (char c : alphabet) {
+            text.push_back(c);
+            self(self);
+            text.pop_back();
+        }
+    };
+    visit(visit);
+    CHECK(matched > 0);
+}
+
+void required_literals() {
+    CHECK(regex::Regex("\\d+").required_literals().empty());
+    CHECK(regex::Regex("segfault at \\d+").required_literals() == std::vector<std::string>{"segfault at "});
+    CHECK(regex::Regex("(foo|bar)baz").required_literals() ==
+          (std::vector<std::string>{"barbaz", "foobaz"}));
+
+    const std::string abcdxy = "abcdxy";
+    for (const char* p : {"x[abcd]{3}y", "x[abcd]{2}y", "[ab]{3}", "(ab){2}c", "x(a|b)?y", "(xa|yb)+c", "x[ab]{2,}y",
+                          "a[bc]d|x[ya]", "(a|b)(c|d)(x|y)", "^ab|cd$", "x.y", "(ab|cd){2}", "[abcd]{2}x[ab]{2}"})
+        required_literals_hold(p, abcdxy, 5);
+}
+
+int main() {
+    parser();
+    search();
+    required_literals();
+    return test::finish("regex_vm");
+}
@@ -0,0 +1,117 @@
+// SyslogDedup window expiry: summaries come out when each template's window
+// closes, and the next deadline is that of the oldest open window, through
+// reopens, evictions and flush_all().
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "syslog_dedup.hpp"
+#include "test_harness.hpp"
+
+using std::chrono::milliseconds;
+
+struct Harness {
+    SyslogDedup dedup;
+    SyslogDedup::Clock::time_point t0 = SyslogDedup::Clock::now();
+    std::vector<std::string> emitted;   // "<template> x<count>"
+    uint64_t offset = 0;
+
+    explicit Harness(size_t capacity) : dedup(milliseconds(100), capacity) {}
+
+    SyslogDedup::Clock::time_point at(int ms) const { return t0 + milliseconds(ms); }
+    auto emit() {
+        return [this](const SyslogDedup::Summary& s) { emitted.push_back(s.templ + " x" + std::to_string(s.count)); };
+    }
+    bool add(const std::string& line, int ms, std::vector<uint16_t> ids = {0}) {
+        return dedup.add(line, ++offset, ids.data(), ids.size(), at(ms), emit());
+    }
+    void flush(int ms) { dedup.flush_expired(at(ms), emit()); }
+    int deadline(int ms) const { return dedup.next_deadline_ms(at(ms), 1000); }
+};
+
+void windows_close_in_order() {
+    Harness h(16);
+    CHECK(h.add("alpha 1", 0));
+    CHECK(h.add("beta", 10));
+    CHECK(h.add("gamma 1", 20));
+    CHECK(!h.add("alpha 2", 30));
+    CHECK(!h.add("gamma 2", 40));
+    CHECK(!h.add("gamma 3", 50));
+    CHECK_EQ(h.deadline(50), 50);
+
+    h.flush(105);   // alpha closes with a summary and reopens at 105
+    CHECK_EQ(h.emitted.size(), size_t{1});
+    CHECK_EQ(h.emitted.back(), "alpha # x1");
+    CHECK_EQ(h.deadline(105), 5);   // beta, opened at 10
+
+    h.flush(125);   // beta closes quietly, gamma with a summary
+    CHECK_EQ(h.emitted.size(), size_t{2});
+    CHECK_EQ(h.emitted.back(), "gamma # x2");
+    CHECK_EQ(h.deadline(125), 80);   // alpha at 205; gamma reopened at 125
+
+    h.flush(300);   // nothing repeated since: both close without output
+    CHECK_EQ(h.emitted.size(), size_t{2});
+    CHECK_EQ(h.deadline(300), 1000);
+
+    // A closed template opens a new window on its next line.
+    CHECK(h.add("beta", 310));
+    CHECK_EQ(h.deadline(310), 100);
+}
+
+void eviction_unlinks_open_windows() {
+    Harness h(2);
+    CHECK(h.add("one 1", 0));
+    CHECK(!h.add("one 2", 1));
+    CHECK(h.add("two", 2));
+    CHECK(h.add("three", 3));   // evicts "one", flushing its pending repeat
+    CHECK_EQ(h.emitted.size(), size_t{1});
+    CHECK_EQ(h.emitted.back(), "one # x1");
+    CHECK_EQ(h.dedup.size(), size_t{2});
+    CHECK_EQ(h.deadline(3), 99);   // "two"
+    h.flush(200);
+    CHECK_EQ(h.emitted.size(), size_t{1});
+    CHECK_EQ(h.deadline(200), 1000);
+}
+
+void flush_all_resets() {
+    Harness h(16);
+    CHECK(h.add("x 1", 0));
+    CHECK(!h.add("x 2", 5));
+    h.dedup.flush_all(h.emit());
+    CHECK_EQ(h.emitted.back(), "x # x1");
+    CHECK_EQ(h.deadline(10), 1000);
+    CHECK(h.add("x 3", 10));
+    CHECK_EQ(h.deadline(10), 100);
+    h.flush(110);
+    CHECK_EQ(h.emitted.size(), size_t{1});
+}
+
+// Same template, other patterns: an IOC address in a routine message is its
+// own signal, not a repeat of the routine line.
+void pattern_sets_are_kept_apart() {
+    Harness h(16);
+    CHECK(h.add("conn from 10.0.0.1", 0, {3}));
+    CHECK(h.add("conn from 203.0.113.9", 1, {3, 7}));   // also hits an IOC rule
+    CHECK(h.add("conn from 198.51.100.2", 2, {7}));
+    CHECK(!h.add("conn from 10.0.0.2", 3, {3}));
+    CHECK(!h.add("conn from 203.0.113.9", 4, {7, 3}));   // same set, other order
+    CHECK_EQ(h.dedup.size(), size_t{3});
+
+    std::vector<std::vector<uint16_t>> ids;
+    h.dedup.flush_expired(h.at(200), [&](const SyslogDedup::Summary& s) {
+        CHECK_EQ(s.templ, "conn from #.#.#.#");
+        CHECK_EQ(s.count, uint64_t{1});
+        ids.push_back(s.pattern_ids);
+    });
+    std::sort(ids.begin(), ids.end());
+    CHECK(ids == (std::vector<std::vector<uint16_t>>{{3}, {3, 7}}));
+}
+
+int main() {
+    windows_close_in_order();
+    eviction_unlinks_open_windows();
+    flush_all_resets();
+    pattern_sets_are_kept_apart();
+    return test::finish("syslog_dedup");
+}
@@ -0,0 +1,37 @@
+// The agent's USB log line, rendered through the async logger's formatter.
+#include <cstdint>
+#include <string>
+#include "async_logger.hpp"
+#include "usb_device_cache.hpp"
+#include "test_harness.hpp"
+
+std::string render_usb_line(const char* action, const UsbDeviceInfo& info, bool cached, const char* devnode) {
+    std::string out;
+    describe_usb_event(
+        [&](const char* fmt, const auto&... args) {
+            logger::detail::Record r;
+            logger::detail::encode_record(r, fmt, args...);
+            r.format(out, r.fmt, r.data, r.arg_count);
+        },
+        action, info, cached, devnode);
+    return out;
+}
+
+int main() {
+    UsbDeviceInfo info;
+    info.has_ids = true;
+    info.vendor = 0x046d;
+    info.product = 0xc52b;
+    CHECK_EQ(render_usb_line("add", info, false, "/dev/bus/usb/001/002"), "add 046d:c52b /dev/bus/usb/001/002");
+    CHECK_EQ(render_usb_line("remove", info, true, "/dev/bus/usb/001/002"),
+             "remove 046d:c52b /dev/bus/usb/001/002 (cached)");
+
+    info.vendor = 0x1;
+    info.product = 0xffff;
+    CHECK_EQ(render_usb_line("bind", info, false, nullptr), "bind 0001:ffff ");
+
+    info.has_ids = false;
+    CHECK_EQ(render_usb_line("remove", info, false, "/dev/bus/usb/001/003"), "remove -:- /dev/bus/usb/001/003");
+
+    return test::finish("usb_log_line");
+}